@@ -0,0 +1,67 @@
+# File: ICP.pri
+# Brief: Sources shared by the MQTT Explorer application and its benchmarks
+# Author: Peter Urgoš (xurgos00)
+# Author: Adam Kľučiar (xkluci01)
+# Date 9.5.2021
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/alertengine.cpp \
+    $$PWD/builtindecoders.cpp \
+    $$PWD/chartwidget.cpp \
+    $$PWD/decoderregistry.cpp \
+    $$PWD/filepublisher.cpp \
+    $$PWD/historyexport.cpp \
+    $$PWD/ingestqueue.cpp \
+    $$PWD/ingestworkers.cpp \
+    $$PWD/mainwindow.cpp \
+    $$PWD/memoryreportdialog.cpp \
+    $$PWD/message.cpp \
+    $$PWD/mqtthandler.cpp \
+    $$PWD/payloadclassifier.cpp \
+    $$PWD/payloadpreview.cpp \
+    $$PWD/payloadstore.cpp \
+    $$PWD/searchindex.cpp \
+    $$PWD/simulator.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/timeseries.cpp \
+    $$PWD/topicbridge.cpp \
+    $$PWD/topicfilter.cpp \
+    $$PWD/topicfinder.cpp \
+    $$PWD/topicstatistics.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/valueinspectdialog.cpp
+
+HEADERS += \
+    $$PWD/alertengine.h \
+    $$PWD/builtindecoders.h \
+    $$PWD/chartwidget.h \
+    $$PWD/decoderregistry.h \
+    $$PWD/filepublisher.h \
+    $$PWD/historyexport.h \
+    $$PWD/ingestqueue.h \
+    $$PWD/ingestworkers.h \
+    $$PWD/mainwindow.h \
+    $$PWD/memoryreportdialog.h \
+    $$PWD/message.h \
+    $$PWD/mqtthandler.h \
+    $$PWD/payloadclassifier.h \
+    $$PWD/payloaddecoder.h \
+    $$PWD/payloadpreview.h \
+    $$PWD/payloadstore.h \
+    $$PWD/searchindex.h \
+    $$PWD/simulator.h \
+    $$PWD/snapshot.h \
+    $$PWD/timeseries.h \
+    $$PWD/topicbridge.h \
+    $$PWD/topicfilter.h \
+    $$PWD/topicfinder.h \
+    $$PWD/topicstatistics.h \
+    $$PWD/trace.h \
+    $$PWD/valueinspectdialog.h
+
+FORMS += \
+    $$PWD/mainwindow.ui \
+    $$PWD/memoryreportdialog.ui \
+    $$PWD/valueinspectdialog.ui
@@ -6,7 +6,7 @@
 
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 CONFIG += c++11
 LIBS += -lpaho-mqtt3c -lpaho-mqtt3a -lpaho-mqttpp3
@@ -16,21 +16,9 @@ LIBS += -lpaho-mqtt3c -lpaho-mqtt3a -lpaho-mqttpp3
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
-    main.cpp \
-    mainwindow.cpp \
-    mqtthandler.cpp \
-    simulator.cpp \
-    valueinspectdialog.cpp
-
-HEADERS += \
-    mainwindow.h \
-    mqtthandler.h \
-    simulator.h \
-    valueinspectdialog.h
-
-FORMS += \
-    mainwindow.ui \
-    valueinspectdialog.ui
+    main.cpp
+
+include(ICP.pri)
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,739 @@
+/**
+ * @file alertengine.cpp
+ * @brief Implementation of engine evaluating alert rules over received messages
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "alertengine.h"
+#include "timeseries.h"
+
+#include <QRegularExpression>
+#include <QSet>
+#include <algorithm>
+#include <limits>
+
+/**
+ * @brief Maximum depth of the stack of compiled conditions
+ */
+const int ALERT_STACK_SIZE = 32;
+
+/**
+ * @brief Compiler of alert conditions into instructions, operators by increasing precedence are
+ * "or", "and", "not", comparisons, "+ -", "* /" and unary minus
+ */
+class AlertCompiler
+{
+public:
+    /**
+     * @brief Compile condition of a rule
+     * @param text of the condition
+     * @param rule its code and fields are filled in
+     */
+    AlertCompiler(QString text, AlertRule &rule) : rule(rule)
+    {
+        static const QRegularExpression tokenExpression(
+                "\\s*(\\d+\\.?\\d*(?:[eE][-+]?\\d+)?|\\.\\d+|[A-Za-z_][A-Za-z0-9_.]*|<=|>=|==|!=|&&|\\|\\||[-+*/<>!()])");
+
+        int position = 0;
+        while (position < text.length())
+        {
+            auto match = tokenExpression.match(text, position, QRegularExpression::NormalMatch, QRegularExpression::AnchoredMatchOption);
+            if (!match.hasMatch())
+            {
+                if (text.mid(position).trimmed().isEmpty())
+                    break;
+
+                error = QString("Unexpected \"%1\" in condition \"%2\".").arg(text.mid(position).trimmed(), text.trimmed());
+                return;
+            }
+
+            tokens.append(match.captured(1));
+            position = match.capturedEnd();
+        }
+
+        if (tokens.isEmpty())
+        {
+            error = "Condition is empty.";
+            return;
+        }
+
+        parseOr();
+        if (error.isEmpty() && next < tokens.length())
+            error = QString("Unexpected \"%1\" in condition \"%2\".").arg(tokens.at(next), text.trimmed());
+
+        if (error.isEmpty() && depth() > ALERT_STACK_SIZE)
+            error = QString("Condition \"%1\" is too complex.").arg(text.trimmed());
+    }
+
+    /**
+     * @brief Error of the compilation
+     */
+    QString error;
+
+private:
+    AlertRule &rule;
+    QStringList tokens;
+    int next = 0;
+
+    /**
+     * @brief Check whether the next token is one of the alternatives and take it
+     * @param alternatives are tokens compared case insensitive
+     * @return the taken token or empty string
+     */
+    QString accept(QStringList alternatives)
+    {
+        if (next < tokens.length() && alternatives.contains(tokens.at(next), Qt::CaseInsensitive))
+            return tokens.at(next++).toLower();
+
+        return QString();
+    }
+
+    void append(AlertOp op)
+    {
+        AlertInstruction instruction;
+        instruction.op = op;
+        rule.code.append(instruction);
+    }
+
+    void parseOr()
+    {
+        parseAnd();
+        while (error.isEmpty() && !accept({ "or", "||" }).isEmpty())
+        {
+            parseAnd();
+            append(AlertOp::Or);
+        }
+    }
+
+    void parseAnd()
+    {
+        parseNot();
+        while (error.isEmpty() && !accept({ "and", "&&" }).isEmpty())
+        {
+            parseNot();
+            append(AlertOp::And);
+        }
+    }
+
+    void parseNot()
+    {
+        if (!accept({ "not", "!" }).isEmpty())
+        {
+            parseNot();
+            append(AlertOp::Not);
+        }
+        else
+            parseComparison();
+    }
+
+    void parseComparison()
+    {
+        parseSum();
+
+        auto op = accept({ "<", "<=", ">", ">=", "==", "!=" });
+        if (op.isEmpty() || !error.isEmpty())
+            return;
+
+        parseSum();
+        if (op == "<")
+            append(AlertOp::Less);
+        else if (op == "<=")
+            append(AlertOp::LessEqual);
+        else if (op == ">")
+            append(AlertOp::Greater);
+        else if (op == ">=")
+            append(AlertOp::GreaterEqual);
+        else if (op == "==")
+            append(AlertOp::Equal);
+        else
+            append(AlertOp::NotEqual);
+    }
+
+    void parseSum()
+    {
+        parseProduct();
+        for (auto op = accept({ "+", "-" }); !op.isEmpty() && error.isEmpty(); op = accept({ "+", "-" }))
+        {
+            parseProduct();
+            append(op == "+" ? AlertOp::Add : AlertOp::Subtract);
+        }
+    }
+
+    void parseProduct()
+    {
+        parseUnary();
+        for (auto op = accept({ "*", "/" }); !op.isEmpty() && error.isEmpty(); op = accept({ "*", "/" }))
+        {
+            parseUnary();
+            append(op == "*" ? AlertOp::Multiply : AlertOp::Divide);
+        }
+    }
+
+    void parseUnary()
+    {
+        if (!accept({ "-" }).isEmpty())
+        {
+            parseUnary();
+            append(AlertOp::Negate);
+        }
+        else
+            parsePrimary();
+    }
+
+    void parsePrimary()
+    {
+        if (!error.isEmpty())
+            return;
+
+        if (next >= tokens.length())
+        {
+            error = "Condition ends unexpectedly.";
+            return;
+        }
+
+        auto token = tokens.at(next++);
+        if (token == "(")
+        {
+            parseOr();
+            if (error.isEmpty() && accept({ ")" }).isEmpty())
+                error = "Missing \")\" in condition.";
+            return;
+        }
+
+        bool isNumber;
+        auto number = token.toDouble(&isNumber);
+        if (isNumber)
+        {
+            AlertInstruction instruction;
+            instruction.constant = number;
+            rule.code.append(instruction);
+            return;
+        }
+
+        if (token.compare("size", Qt::CaseInsensitive) == 0)
+        {
+            append(AlertOp::Size);
+            return;
+        }
+
+        // "value" is the payload as a number, "value.path" is a field of a JSON payload
+        if (token.compare("value", Qt::CaseInsensitive) == 0 || token.startsWith("value.", Qt::CaseInsensitive))
+        {
+            auto path = token.mid(6);
+            if (!rule.fields.contains(path))
+                rule.fields.append(path);
+
+            AlertInstruction instruction;
+            instruction.op = AlertOp::Field;
+            instruction.field = rule.fields.indexOf(path);
+            rule.code.append(instruction);
+            return;
+        }
+
+        error = QString("Unknown operand \"%1\", use numbers, size, value or value.field.path.").arg(token);
+    }
+
+    /**
+     * @brief Get maximum depth of the stack when the code runs
+     * @return depth
+     */
+    int depth()
+    {
+        int current = 0;
+        int maximum = 0;
+        for (auto &instruction : rule.code)
+        {
+            switch (instruction.op)
+            {
+                case AlertOp::Constant:
+                case AlertOp::Field:
+                case AlertOp::Size:
+                    current++;
+                    break;
+                case AlertOp::Negate:
+                case AlertOp::Not:
+                    break;
+                default:
+                    current--;
+                    break;
+            }
+            maximum = std::max(maximum, current);
+        }
+
+        return maximum;
+    }
+};
+
+/**
+ * @brief Parse duration such as "500ms", "10s", "5m" or "1h", plain numbers are seconds
+ * @param text of the duration
+ * @param duration in milliseconds
+ * @return true when valid
+ */
+static bool parseDuration(QString text, qint64 &duration)
+{
+    static const QRegularExpression durationExpression("^(\\d+(?:\\.\\d+)?)\\s*(ms|s|m|h)?$");
+
+    auto match = durationExpression.match(text.trimmed().toLower());
+    if (!match.hasMatch())
+        return false;
+
+    auto value = match.captured(1).toDouble();
+    auto unit = match.captured(2);
+    if (unit == "ms")
+        duration = static_cast<qint64>(value);
+    else if (unit == "m")
+        duration = static_cast<qint64>(value * 60 * 1000);
+    else if (unit == "h")
+        duration = static_cast<qint64>(value * 60 * 60 * 1000);
+    else
+        duration = static_cast<qint64>(value * 1000);
+
+    return true;
+}
+
+/**
+ * @brief Check whether a number of a condition is true, NaN (missing field) is false
+ * @param value to check
+ * @return true when not zero and not NaN
+ */
+static inline bool isTrue(double value) { return value == value && value != 0; }
+
+
+AlertEngine::AlertEngine() : ruleSet(std::make_shared<RuleSet>()) {}
+
+
+QString AlertEngine::parseRules(QString text, QList<AlertRule> &rules)
+{
+    static const QRegularExpression publishExpression("\\s+publish\\s+(\\S+)\\s*$", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression forExpression("\\s+for\\s+(\\S+)\\s*$", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression silentExpression("^\\s*silent\\s+(\\S+)\\s*$", QRegularExpression::CaseInsensitiveOption);
+
+    rules.clear();
+
+    for (auto &ruleText : text.split(";"))
+    {
+        if (ruleText.trimmed().isEmpty())
+            continue;
+
+        // Conditions may contain "==", the filter ends at the first '='
+        auto separator = ruleText.indexOf("=");
+        if (separator < 0)
+            return QString("Rule \"%1\" is not in format filter=condition.").arg(ruleText.trimmed());
+
+        AlertRule rule;
+        rule.text = ruleText.trimmed();
+
+        auto filter = ruleText.left(separator).trimmed();
+        if (!TopicFilter::isValid(filter))
+            return QString("Topic filter \"%1\" is not valid.").arg(filter);
+        rule.filter = TopicFilter(filter);
+
+        auto condition = " " + ruleText.mid(separator + 1);
+
+        auto publish = publishExpression.match(condition);
+        if (publish.hasMatch())
+        {
+            rule.publishTopic = publish.captured(1);
+            condition = condition.left(publish.capturedStart());
+        }
+
+        auto silent = silentExpression.match(condition);
+        if (silent.hasMatch())
+        {
+            rule.kind = AlertRule::Kind::Silence;
+            if (!parseDuration(silent.captured(1), rule.duration) || rule.duration <= 0)
+                return QString("Duration \"%1\" is not valid, use e.g. 500ms, 10s or 5m.").arg(silent.captured(1));
+        }
+        else
+        {
+            auto duration = forExpression.match(condition);
+            if (duration.hasMatch())
+            {
+                if (!parseDuration(duration.captured(1), rule.duration))
+                    return QString("Duration \"%1\" is not valid, use e.g. 500ms, 10s or 5m.").arg(duration.captured(1));
+                condition = condition.left(duration.capturedStart());
+            }
+
+            AlertCompiler compiler(condition, rule);
+            if (!compiler.error.isEmpty())
+                return QString("Rule \"%1\": %2").arg(rule.text, compiler.error);
+        }
+
+        rules.append(rule);
+    }
+
+    return QString();
+}
+
+
+void AlertEngine::setRules(QList<AlertRule> rules, qint64 now)
+{
+    auto set = std::make_shared<RuleSet>();
+    set->rules = rules;
+    set->nodes.append(FilterNode());
+
+    for (int i = 0; i < rules.length(); i++)
+    {
+        int node = 0;
+        for (auto &level : rules.at(i).filter.getFilter().split("/"))
+        {
+            if (level == "#")
+            {
+                set->nodes[node].hashRules.append(i);
+                node = -1;
+                break;
+            }
+
+            auto child = level == "+" ? set->nodes.at(node).plusChild : set->nodes.at(node).children.value(level, -1);
+            if (child < 0)
+            {
+                child = set->nodes.size();
+                set->nodes.append(FilterNode());
+                if (level == "+")
+                    set->nodes[node].plusChild = child;
+                else
+                    set->nodes[node].children.insert(level, child);
+            }
+            node = child;
+        }
+
+        if (node >= 0)
+            set->nodes[node].rules.append(i);
+    }
+
+    // Topics without wildcards can be silent from the start, before any message arrived
+    QVector<QHash<QString, RuleState>> newStates(rules.length());
+    for (int i = 0; i < rules.length(); i++)
+    {
+        auto &rule = rules.at(i);
+        auto filter = rule.filter.getFilter();
+        if (rule.kind != AlertRule::Kind::Silence || filter.contains("+") || filter.contains("#"))
+            continue;
+
+        RuleState state;
+        state.topic = filter;
+        state.lastSeen = now;
+        newStates[i].insert(stateKey(QString(), filter), state);
+    }
+
+    QMutexLocker locker(&mutex);
+    ruleSet = set;
+    states = newStates;
+    rulesOfTopic.clear();
+    activeCount = 0;
+}
+
+
+void AlertEngine::evaluate(const QString &connection, const QString &topic, const QStringList &topicLevels,
+                           const std::string &payload, qint64 timestamp)
+{
+    std::shared_ptr<const RuleSet> set;
+    QVector<int> matched;
+
+    {
+        QMutexLocker locker(&mutex);
+        if (ruleSet->rules.isEmpty())
+            return;
+
+        set = ruleSet;
+        auto found = rulesOfTopic.constFind(topic);
+        if (found != rulesOfTopic.constEnd())
+            matched = found.value();
+        else
+        {
+            // Wildcards don't match topics starting with '$' on the first level
+            if (!topicLevels.isEmpty() && topicLevels.first().startsWith("$"))
+            {
+                auto &root = set->nodes.first();
+                auto child = root.children.value(topicLevels.first(), -1);
+                if (child >= 0)
+                    collectRules(*set, child, topicLevels, 1, matched);
+            }
+            else
+                collectRules(*set, 0, topicLevels, 0, matched);
+
+            rulesOfTopic.insert(topic, matched);
+        }
+    }
+
+    if (matched.isEmpty())
+        return;
+
+    // Fields are found once per message for all rules, JSON is parsed only when a rule reads its fields
+    QHash<QString, double> fieldValues;
+    QJsonDocument document;
+    bool parsed = false;
+    QVector<bool> results(matched.size());
+
+    for (int i = 0; i < matched.size(); i++)
+    {
+        auto &rule = set->rules.at(matched.at(i));
+        if (rule.kind != AlertRule::Kind::Condition)
+            continue;
+
+        QVector<double> fields(rule.fields.size());
+        for (int j = 0; j < rule.fields.size(); j++)
+        {
+            auto &path = rule.fields.at(j);
+            auto found = fieldValues.constFind(path);
+            if (found != fieldValues.constEnd())
+            {
+                fields[j] = found.value();
+                continue;
+            }
+
+            double value = std::numeric_limits<double>::quiet_NaN();
+            if (path.isEmpty())
+                NumericExtractor::parseNumber(payload, value);
+            else
+            {
+                if (!parsed)
+                {
+                    document = QJsonDocument::fromJson(QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length())));
+                    parsed = true;
+                }
+
+                if (document.isNull() || !NumericExtractor::findField(document, path, value))
+                    value = std::numeric_limits<double>::quiet_NaN();
+            }
+
+            fieldValues.insert(path, value);
+            fields[j] = value;
+        }
+
+        results[i] = run(rule, fields, static_cast<double>(payload.length()));
+    }
+
+    QMutexLocker locker(&mutex);
+
+    // Rules were replaced while the conditions were evaluated
+    if (ruleSet != set)
+        return;
+
+    auto key = stateKey(connection, topic);
+
+    for (int i = 0; i < matched.size(); i++)
+    {
+        auto index = matched.at(i);
+        auto &rule = set->rules.at(index);
+        auto &topicStates = states[index];
+
+        // Topics silent from the start belong to the first connection they are received on
+        if (!topicStates.contains(key))
+        {
+            auto initial = topicStates.find(stateKey(QString(), topic));
+            if (initial != topicStates.end())
+            {
+                topicStates.insert(key, initial.value());
+                topicStates.remove(stateKey(QString(), topic));
+            }
+        }
+
+        auto &state = topicStates[key];
+        state.connection = connection;
+        state.topic = topic;
+        state.lastSeen = timestamp;
+
+        if (rule.kind == AlertRule::Kind::Silence)
+        {
+            if (state.active)
+                change(rule, state, timestamp, false);
+            continue;
+        }
+
+        if (!results.at(i))
+        {
+            state.since = -1;
+            if (state.active)
+                change(rule, state, timestamp, false);
+            continue;
+        }
+
+        if (state.since < 0)
+            state.since = timestamp;
+
+        if (!state.active && timestamp - state.since >= rule.duration)
+            change(rule, state, timestamp, true);
+    }
+}
+
+
+void AlertEngine::tick(qint64 now)
+{
+    QMutexLocker locker(&mutex);
+
+    for (int i = 0; i < states.size(); i++)
+    {
+        auto &rule = ruleSet->rules.at(i);
+        if (rule.duration <= 0)
+            continue;
+
+        for (auto &state : states[i])
+        {
+            if (state.active)
+                continue;
+
+            if (rule.kind == AlertRule::Kind::Silence && now - state.lastSeen >= rule.duration)
+                change(rule, state, now, true);
+            else if (rule.kind == AlertRule::Kind::Condition && state.since >= 0 && now - state.since >= rule.duration)
+                change(rule, state, now, true);
+        }
+    }
+}
+
+
+void AlertEngine::removeSubtrees(const QList<QPair<QString, QString>> &subtrees)
+{
+    QHash<QString, QSet<QString>> removed;
+    QSet<QString> removedTopics;
+    for (auto &subtree : subtrees)
+    {
+        removed[subtree.first].insert(subtree.second);
+        removedTopics.insert(subtree.second);
+    }
+
+    QMutexLocker locker(&mutex);
+
+    for (auto &topicStates : states)
+    {
+        for (auto it = topicStates.begin(); it != topicStates.end();)
+        {
+            auto &state = it.value();
+            if (!TopicFilter::isInSubtree(state.topic, removed.value(state.connection)))
+            {
+                ++it;
+                continue;
+            }
+
+            if (state.active)
+                activeCount--;
+            it = topicStates.erase(it);
+        }
+    }
+
+    // Matching rules don't depend on the connection, the topic is looked up again if another connection still has it
+    for (auto it = rulesOfTopic.begin(); it != rulesOfTopic.end();)
+    {
+        if (TopicFilter::isInSubtree(it.key(), removedTopics))
+            it = rulesOfTopic.erase(it);
+        else
+            ++it;
+    }
+}
+
+
+QList<Alert> AlertEngine::takeAlerts()
+{
+    QMutexLocker locker(&mutex);
+
+    QList<Alert> taken;
+    taken.swap(alerts);
+    return taken;
+}
+
+
+int AlertEngine::getActiveCount()
+{
+    QMutexLocker locker(&mutex);
+    return activeCount;
+}
+
+
+void AlertEngine::collectRules(const RuleSet &set, int node, const QStringList &topicLevels, int depth, QVector<int> &rules)
+{
+    auto &current = set.nodes.at(node);
+
+    // '#' matches the remaining levels, including none
+    rules += current.hashRules;
+
+    if (depth == topicLevels.size())
+    {
+        rules += current.rules;
+        return;
+    }
+
+    auto child = current.children.value(topicLevels.at(depth), -1);
+    if (child >= 0)
+        collectRules(set, child, topicLevels, depth + 1, rules);
+
+    if (current.plusChild >= 0)
+        collectRules(set, current.plusChild, topicLevels, depth + 1, rules);
+}
+
+
+QString AlertEngine::stateKey(const QString &connection, const QString &topic)
+{
+    return connection + '\n' + topic;
+}
+
+
+bool AlertEngine::run(const AlertRule &rule, const QVector<double> &fields, double size)
+{
+    double stack[ALERT_STACK_SIZE];
+    int top = 0;
+
+    for (auto &instruction : rule.code)
+    {
+        switch (instruction.op)
+        {
+            case AlertOp::Constant:
+                stack[top++] = instruction.constant;
+                break;
+            case AlertOp::Field:
+                stack[top++] = fields.at(instruction.field);
+                break;
+            case AlertOp::Size:
+                stack[top++] = size;
+                break;
+            case AlertOp::Negate:
+                stack[top - 1] = -stack[top - 1];
+                break;
+            case AlertOp::Not:
+                stack[top - 1] = isTrue(stack[top - 1]) ? 0 : 1;
+                break;
+            default:
+            {
+                auto right = stack[--top];
+                auto &left = stack[top - 1];
+
+                switch (instruction.op)
+                {
+                    case AlertOp::Add: left = left + right; break;
+                    case AlertOp::Subtract: left = left - right; break;
+                    case AlertOp::Multiply: left = left * right; break;
+                    case AlertOp::Divide: left = left / right; break;
+                    case AlertOp::Less: left = left < right; break;
+                    case AlertOp::LessEqual: left = left <= right; break;
+                    case AlertOp::Greater: left = left > right; break;
+                    case AlertOp::GreaterEqual: left = left >= right; break;
+                    case AlertOp::Equal: left = left == right; break;
+                    case AlertOp::NotEqual: left = left == left && right == right && left != right; break;
+                    case AlertOp::And: left = isTrue(left) && isTrue(right); break;
+                    case AlertOp::Or: left = isTrue(left) || isTrue(right); break;
+                    default: break;
+                }
+                break;
+            }
+        }
+    }
+
+    return top == 1 && isTrue(stack[0]);
+}
+
+
+void AlertEngine::change(const AlertRule &rule, RuleState &state, qint64 timestamp, bool raised)
+{
+    state.active = raised;
+    activeCount += raised ? 1 : -1;
+
+    Alert alert;
+    alert.rule = rule.text;
+    alert.connection = state.connection;
+    alert.topic = state.topic;
+    alert.timestamp = timestamp;
+    alert.raised = raised;
+    alert.publishTopic = rule.publishTopic;
+    alerts.append(alert);
+}
@@ -0,0 +1,310 @@
+/**
+ * @file alertengine.h
+ * @brief Header file for engine evaluating alert rules over received messages
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef ALERTENGINE_H
+#define ALERTENGINE_H
+
+#include "topicfilter.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Operation of compiled alert conditions, conditions run on a stack of numbers
+ */
+enum class AlertOp : quint8
+{
+    Constant,       ///< Push constant
+    Field,          ///< Push field of the payload, NaN when the message has none
+    Size,           ///< Push length of the payload
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Negate,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Equal,
+    NotEqual,
+    And,
+    Or,
+    Not
+};
+
+/**
+ * @brief Instruction of a compiled alert condition
+ */
+struct AlertInstruction
+{
+    AlertOp op = AlertOp::Constant;
+
+    /**
+     * @brief Index of the field of the rule, used by Field
+     */
+    int field = 0;
+
+    /**
+     * @brief Value, used by Constant
+     */
+    double constant = 0;
+};
+
+/**
+ * @brief Compiled alert rule
+ */
+struct AlertRule
+{
+    enum class Kind
+    {
+        Condition,  ///< Raised when the condition holds (for the duration)
+        Silence     ///< Raised when no message arrives for the duration
+    };
+
+    /**
+     * @brief Rule as it was written
+     */
+    QString text;
+
+    TopicFilter filter;
+    Kind kind = Kind::Condition;
+
+    /**
+     * @brief Compiled condition, used by Condition
+     */
+    QVector<AlertInstruction> code;
+
+    /**
+     * @brief Fields the condition reads, empty path is the whole payload as a number
+     */
+    QStringList fields;
+
+    /**
+     * @brief How long the condition has to hold or the topic has to be silent in milliseconds
+     */
+    qint64 duration = 0;
+
+    /**
+     * @brief Topic alerts are published to, empty when they are only shown
+     */
+    QString publishTopic;
+};
+
+/**
+ * @brief Alert raised or cleared by a rule
+ */
+struct Alert
+{
+    /**
+     * @brief Rule as it was written
+     */
+    QString rule;
+
+    /**
+     * @brief Connection of the last message of the topic, empty when none was received
+     */
+    QString connection;
+
+    QString topic;
+
+    /**
+     * @brief Time of the change in milliseconds since epoch
+     */
+    qint64 timestamp = 0;
+
+    /**
+     * @brief True when the alert was raised, false when it was cleared
+     */
+    bool raised = true;
+
+    /**
+     * @brief Topic the alert is published to, empty when it is only shown
+     */
+    QString publishTopic;
+};
+
+class AlertEngine
+{
+public:
+    /**
+     * @brief Engine evaluating alert rules, rules are compiled once and matched through an index of their topic filters
+     */
+    AlertEngine();
+
+    /**
+     * @brief Parse and compile rules in format "filter=condition [for duration] [publish topic]; filter=silent duration",
+     * conditions compare numbers, e.g. "value > 80", "value.sensors.0.temperature >= 30 and size < 100"
+     * @param text of the rules
+     * @param rules compiled rules
+     * @return empty string on success, otherwise description of the error
+     */
+    static QString parseRules(QString text, QList<AlertRule> &rules);
+
+    /**
+     * @brief Replace rules, alerts of the previous rules are forgotten
+     * @param rules compiled rules
+     * @param now in milliseconds since epoch, silence of topics without wildcards is measured from it
+     */
+    void setRules(QList<AlertRule> rules, qint64 now);
+
+    /**
+     * @brief Evaluate rules matching the topic of a message, called on ingest worker threads
+     * @param connection the message was received on
+     * @param topic of the message
+     * @param topicLevels are levels of the topic
+     * @param payload of the message
+     * @param timestamp of the message in milliseconds since epoch
+     */
+    void evaluate(const QString &connection, const QString &topic, const QStringList &topicLevels, const std::string &payload, qint64 timestamp);
+
+    /**
+     * @brief Raise alerts of conditions that held and topics that were silent long enough
+     * @param now in milliseconds since epoch
+     */
+    void tick(qint64 now);
+
+    /**
+     * @brief Forget states of topics that were removed from the tree, their raised alerts are no longer counted
+     * @param subtrees are pairs of connection and topic, topics below them are removed as well
+     */
+    void removeSubtrees(const QList<QPair<QString, QString>> &subtrees);
+
+    /**
+     * @brief Take alerts raised or cleared since the last call
+     * @return alerts in order they happened
+     */
+    QList<Alert> takeAlerts();
+
+    /**
+     * @brief Get number of raised alerts
+     * @return number of alerts
+     */
+    int getActiveCount();
+
+private:
+    /**
+     * @brief Node of the index of topic filters, one per filter level
+     */
+    struct FilterNode
+    {
+        QHash<QString, int> children;
+        int plusChild = -1;
+
+        /**
+         * @brief Rules whose filter ends here
+         */
+        QVector<int> rules;
+
+        /**
+         * @brief Rules whose filter continues with '#'
+         */
+        QVector<int> hashRules;
+    };
+
+    /**
+     * @brief Rules with their index, shared with evaluations running while rules are replaced
+     */
+    struct RuleSet
+    {
+        QList<AlertRule> rules;
+        QVector<FilterNode> nodes;
+    };
+
+    /**
+     * @brief State of a rule for one topic
+     */
+    struct RuleState
+    {
+        QString connection;
+        QString topic;
+
+        /**
+         * @brief Time since the condition holds, -1 when it doesn't
+         */
+        qint64 since = -1;
+
+        /**
+         * @brief Time of the last message
+         */
+        qint64 lastSeen = 0;
+
+        bool active = false;
+    };
+
+    std::shared_ptr<const RuleSet> ruleSet;
+
+    /**
+     * @brief Rules matching topics seen so far, so the index is searched once per topic
+     */
+    QHash<QString, QVector<int>> rulesOfTopic;
+
+    /**
+     * @brief States of rules by rule index and key of the topic, see stateKey
+     */
+    QVector<QHash<QString, RuleState>> states;
+
+    /**
+     * @brief Alerts not taken yet
+     */
+    QList<Alert> alerts;
+
+    /**
+     * @brief Number of raised alerts
+     */
+    int activeCount = 0;
+
+    /**
+     * @brief Protects all members, conditions are evaluated outside of it
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Collect rules whose filter matches a topic
+     * @param set of rules
+     * @param node of the index
+     * @param topicLevels are levels of the topic
+     * @param depth is the level matched at the node
+     * @param rules matching rules
+     */
+    static void collectRules(const RuleSet &set, int node, const QStringList &topicLevels, int depth, QVector<int> &rules);
+
+    /**
+     * @brief Run compiled condition
+     * @param rule to run
+     * @param fields are values of the rule's fields
+     * @param size of the payload
+     * @return true when the condition holds
+     */
+    static bool run(const AlertRule &rule, const QVector<double> &fields, double size);
+
+    /**
+     * @brief Get key of the state of a topic, the same topic on two connections has separate states
+     * @param connection of the topic, empty for topics silent from the start
+     * @param topic of the state
+     * @return key
+     */
+    static QString stateKey(const QString &connection, const QString &topic);
+
+    /**
+     * @brief Raise or clear alert of a rule, mutex has to be locked
+     * @param rule that changed
+     * @param state of the rule
+     * @param timestamp of the change
+     * @param raised is true when raised, false when cleared
+     */
+    void change(const AlertRule &rule, RuleState &state, qint64 timestamp, bool raised);
+};
+
+#endif // ALERTENGINE_H
@@ -0,0 +1,19 @@
+# File: benchmark.pro
+# Brief: Headless benchmark of the explorer's message ingest path
+# Author: Peter Urgoš (xurgos00)
+# Date 9.5.2021
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+LIBS += -lpaho-mqtt3c -lpaho-mqtt3a -lpaho-mqttpp3
+
+TARGET = ingest_benchmark
+
+SOURCES += \
+    ingestbenchmark.cpp
+
+include(../ICP.pri)
@@ -0,0 +1,226 @@
+/**
+ * @file ingestbenchmark.cpp
+ * @brief Headless end-to-end benchmark of the explorer's message ingest path
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "mainwindow.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// The broker is stood in for in-process: messages are built the same way the Paho client builds
+// them and handed to the explorer's callback, so the benchmark needs neither a broker nor network.
+
+class LoadGenerator
+{
+public:
+    /**
+     * @brief Generator of synthetic telemetry spread over a tree of device topics
+     * @param topicCount is number of distinct topics messages are published to
+     * @param payloadSize is approximate size of each payload in bytes
+     */
+    LoadGenerator(int topicCount, int payloadSize)
+    {
+        for (int i = 0; i < topicCount; i++)
+        {
+            topics.push_back("site/" + std::to_string(i % 8) + "/device/" + std::to_string(i) + "/telemetry");
+        }
+
+        // Pre-build a pool of messages so that generating them is not part of the measurement
+        for (int i = 0; i < topicCount * 4; i++)
+        {
+            std::string payload = "{\"seq\":" + std::to_string(i) + ",\"value\":" + std::to_string((i * 37) % 1000 / 10.0) + ",\"pad\":\"";
+            if (payloadSize > static_cast<int>(payload.length()) + 2)
+                payload.append(payloadSize - payload.length() - 2, 'x');
+            payload.append("\"}");
+
+            pool.push_back(mqtt::make_message(topics[i % topicCount], payload));
+        }
+    }
+
+    /**
+     * @brief Get next message to deliver
+     * @return message
+     */
+    mqtt::const_message_ptr next()
+    {
+        auto message = pool[position];
+        position = (position + 1) % pool.size();
+        return message;
+    }
+
+private:
+    /**
+     * @brief Topics messages are published to
+     */
+    std::vector<std::string> topics;
+
+    /**
+     * @brief Messages that are delivered in round robin
+     */
+    std::vector<mqtt::const_message_ptr> pool;
+
+    /**
+     * @brief Position of the next message in the pool
+     */
+    size_t position = 0;
+};
+
+
+/**
+ * @brief Get percentile of sorted samples
+ * @param samples sorted in ascending order
+ * @param percentile in range 0 to 100
+ * @return value of the percentile
+ */
+static double percentile(const std::vector<double> &samples, double percentile)
+{
+    if (samples.empty())
+        return 0;
+
+    auto index = static_cast<size_t>(percentile / 100.0 * (samples.size() - 1));
+    return samples[index];
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Run headless unless the platform is chosen explicitly
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ingest_benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures throughput, callback cost and arrival-to-tree latency of the explorer ingest path (callback -> ingest workers -> ingest queue -> UI model).");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("messages", "Number of measured messages.", "count", "20000"));
+    parser.addOption(QCommandLineOption("warmup", "Number of messages delivered before measuring.", "count", "1000"));
+    parser.addOption(QCommandLineOption("topics", "Number of distinct topics.", "count", "500"));
+    parser.addOption(QCommandLineOption("payload-size", "Approximate payload size in bytes.", "bytes", "64"));
+    parser.addOption(QCommandLineOption("workers", "Number of ingest worker threads, 0 for one per core.", "count", "0"));
+    parser.addOption(QCommandLineOption("policies", "Ingest policies, e.g. \"site/+/device/#=latest\".", "rules", ""));
+    parser.process(app);
+
+    int messageCount = std::max(1, parser.value("messages").toInt());
+    int warmupCount = std::max(0, parser.value("warmup").toInt());
+    int topicCount = std::max(1, parser.value("topics").toInt());
+    int payloadSize = std::max(0, parser.value("payload-size").toInt());
+    int workerCount = std::max(0, parser.value("workers").toInt());
+
+    QList<QPair<TopicFilter, IngestPolicy>> rules;
+    auto error = IngestQueue::parseRules(parser.value("policies"), rules);
+    if (!error.isEmpty())
+    {
+        std::fprintf(stderr, "%s\n", error.toLocal8Bit().constData());
+        return 1;
+    }
+
+    MainWindow window;
+    if (workerCount > 0)
+        window.setIngestThreadCount(workerCount);
+
+    // The client is never connected, it only satisfies the callback's interface
+    mqtt::async_client client("127.0.0.1:1883", "ICP_ingest_benchmark");
+    mqtt::connect_options connOpts;
+    callback cb(client, connOpts, &window);
+    mqtt::callback &broker = cb;
+
+    LoadGenerator generator(topicCount, payloadSize);
+
+    // Messages are processed on the GUI thread in batches, the benchmark drains the queue itself instead of waiting for the timer
+    auto drain = [&]()
+    {
+        app.processEvents();
+        while (window.getQueuedMessageCount() > 0)
+            window.drainIngestQueue();
+    };
+
+    for (int i = 0; i < warmupCount; i++)
+    {
+        broker.message_arrived(generator.next());
+        if (i % 256 == 0)
+            drain();
+    }
+    drain();
+
+    // Policies are applied only to measured messages, so warmup fills the tree with every topic
+    window.setIngestPolicies(rules);
+
+    // Cost of the callback alone, the Paho thread is blocked for this long
+    std::vector<double> latencies;
+    latencies.reserve(messageCount);
+    size_t bytes = 0;
+
+    // Time from arrival until the message is in the tree, includes waiting in the queues for the next drain
+    QVector<qint64> insertLatencies;
+    insertLatencies.reserve(messageCount);
+    window.setInsertLatencies(&insertLatencies);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messageCount; i++)
+    {
+        auto message = generator.next();
+        bytes += message->get_payload_ref().size();
+
+        auto deliveryStart = std::chrono::steady_clock::now();
+        broker.message_arrived(message);
+        auto deliveryEnd = std::chrono::steady_clock::now();
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(deliveryEnd - deliveryStart).count());
+
+        // Let the UI process queued messages like it would between deliveries
+        if (i % 256 == 0)
+            drain();
+    }
+    drain();
+    auto end = std::chrono::steady_clock::now();
+    window.setInsertLatencies(nullptr);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::sort(latencies.begin(), latencies.end());
+
+    // Messages conflated or sampled out by policies never reach the tree and have no latency
+    std::vector<double> inserted;
+    inserted.reserve(insertLatencies.size());
+    for (auto latency : insertLatencies)
+        inserted.push_back(latency / 1000.0);
+    std::sort(inserted.begin(), inserted.end());
+
+    std::printf("messages:   %d (%d topics, %d B payload, %d workers)\n", messageCount, topicCount, payloadSize, window.getIngestThreadCount());
+    std::printf("elapsed:    %.3f s\n", seconds);
+    std::printf("throughput: %.0f msg/s, %.2f MB/s\n", messageCount / seconds, bytes / seconds / 1e6);
+    std::printf("callback:   p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+                percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99), latencies.back());
+    std::printf("in tree:    p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us (%zu messages inserted)\n",
+                percentile(inserted, 50), percentile(inserted, 90), percentile(inserted, 99),
+                inserted.empty() ? 0.0 : inserted.back(), inserted.size());
+
+    for (auto &statistics : window.getIngestStatistics())
+    {
+        if (statistics.received == 0)
+            continue;
+
+        std::printf("policy:     %s (%s): %llu received, %llu processed, %llu conflated, %llu sampled out, %llu dropped\n",
+                    statistics.filter.isEmpty() ? "other topics" : statistics.filter.toLocal8Bit().constData(),
+                    statistics.policy.toLocal8Bit().constData(),
+                    static_cast<unsigned long long>(statistics.received), static_cast<unsigned long long>(statistics.processed),
+                    static_cast<unsigned long long>(statistics.conflated), static_cast<unsigned long long>(statistics.sampledOut),
+                    static_cast<unsigned long long>(statistics.droppedOldest));
+    }
+
+    auto store = PayloadStore::global().getStatistics();
+    std::printf("payloads:   %d unique, %llu deduplicated (%.2f MB saved)\n",
+                store.uniquePayloads, static_cast<unsigned long long>(store.deduplicated), store.deduplicatedBytes / 1e6);
+    std::printf("cold:       %llu payloads, %.2f MB -> %.2f MB\n",
+                static_cast<unsigned long long>(store.compressedPayloads), store.compressedInputBytes / 1e6, store.compressedOutputBytes / 1e6);
+
+    return 0;
+}
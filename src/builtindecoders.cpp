@@ -0,0 +1,557 @@
+/**
+ * @file builtindecoders.cpp
+ * @brief Implementation of payload decoders built into the application
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "builtindecoders.h"
+#include "payloadclassifier.h"
+
+#include <QBuffer>
+#include <QCborValue>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Number of bytes inspected when sniffing text
+ */
+const size_t SNIFF_LENGTH = 4096;
+
+/**
+ * @brief Maximum nesting of MessagePack containers
+ */
+const int MESSAGEPACK_MAX_DEPTH = 64;
+
+
+/**
+ * @brief Check whether data is valid UTF-8 without NUL characters, a sequence cut at the end is accepted
+ * @param data to check
+ * @param length of data
+ * @return true when valid, otherwise false
+ */
+static bool isTextUtf8(const unsigned char *data, size_t length)
+{
+    size_t i = 0;
+    while (i < length)
+    {
+        auto c = data[i];
+        if (c == 0)
+            return false;
+
+        size_t continuation;
+        if (c < 0x80)
+            continuation = 0;
+        else if ((c & 0xe0) == 0xc0 && c >= 0xc2)
+            continuation = 1;
+        else if ((c & 0xf0) == 0xe0)
+            continuation = 2;
+        else if ((c & 0xf8) == 0xf0 && c <= 0xf4)
+            continuation = 3;
+        else
+            return false;
+
+        for (size_t j = 1; j <= continuation; j++)
+        {
+            if (i + j >= length)
+                return true;
+            if ((data[i + j] & 0xc0) != 0x80)
+                return false;
+        }
+
+        i += continuation + 1;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Get first non-whitespace character of the payload
+ * @param payload to look at
+ * @param fromEnd is true to look from the end of the payload
+ * @return the character or 0 when the payload is blank
+ */
+static char firstNonSpace(const std::string &payload, bool fromEnd)
+{
+    for (size_t i = 0; i < payload.length(); i++)
+    {
+        char c = fromEnd ? payload[payload.length() - 1 - i] : payload[i];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            return c;
+    }
+
+    return 0;
+}
+
+QString TextDecoder::getName() const { return "Text"; }
+
+
+bool TextDecoder::accepts(const std::string &payload) const
+{
+    return isTextUtf8(reinterpret_cast<const unsigned char *>(payload.data()), std::min(payload.length(), SNIFF_LENGTH));
+}
+
+
+DecodedPayload TextDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+    result.ok = true;
+
+    // Huge payloads would take seconds to show, the inspector pages through the rest
+    auto length = std::min(payload.length(), DECODE_TEXT_BYTES);
+    result.text = QString::fromUtf8(payload.data(), static_cast<int>(length));
+    if (length < payload.length())
+        result.text.append(QString("\n\n... %1 more bytes, page through the raw payload to see them").arg(payload.length() - length));
+
+    return result;
+}
+
+
+QString JsonDecoder::getName() const { return "JSON"; }
+
+
+bool JsonDecoder::accepts(const std::string &payload) const
+{
+    auto first = firstNonSpace(payload, false);
+    auto last = firstNonSpace(payload, true);
+
+    return (first == '{' && last == '}') || (first == '[' && last == ']');
+}
+
+
+DecodedPayload JsonDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+
+    QJsonParseError error;
+    auto document = QJsonDocument::fromJson(QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length())), &error);
+
+    if (document.isNull())
+    {
+        result.text = QString("Invalid JSON at offset %1: %2").arg(error.offset).arg(error.errorString());
+        return result;
+    }
+
+    result.ok = true;
+    result.text = QString::fromUtf8(document.toJson(QJsonDocument::Indented));
+    return result;
+}
+
+QString HexDecoder::getName() const { return "Hex"; }
+
+
+bool HexDecoder::accepts(const std::string &) const { return true; }
+
+
+DecodedPayload HexDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+    result.ok = true;
+
+    auto length = std::min(payload.length(), DECODE_TEXT_BYTES);
+    result.text = dump(payload.data(), length, 0);
+    if (length < payload.length())
+        result.text.append(QString("\n... %1 more bytes, page through the raw payload to see them").arg(payload.length() - length));
+
+    return result;
+}
+
+
+QString HexDecoder::dump(const char *data, size_t length, size_t offset)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    // 8 offset digits, 2 spaces, 16 * 3 hex, space, 16 printable, newline
+    std::string dump;
+    dump.reserve((length / 16 + 1) * 76);
+
+    for (size_t line = 0; line < length; line += 16)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            dump.push_back(digits[((offset + line) >> shift) & 0xf]);
+        dump.append("  ");
+
+        for (size_t i = line; i < line + 16; i++)
+        {
+            if (i < length)
+            {
+                auto c = static_cast<unsigned char>(data[i]);
+                dump.push_back(digits[c >> 4]);
+                dump.push_back(digits[c & 0xf]);
+                dump.push_back(' ');
+            }
+            else
+            {
+                dump.append("   ");
+            }
+        }
+
+        dump.push_back(' ');
+        for (size_t i = line; i < line + 16 && i < length; i++)
+        {
+            auto c = static_cast<unsigned char>(data[i]);
+            dump.push_back(c >= 0x20 && c < 0x7f ? static_cast<char>(c) : '.');
+        }
+        dump.push_back('\n');
+    }
+
+    return QString::fromLatin1(dump.data(), static_cast<int>(dump.length()));
+}
+
+QString ImageDecoder::getName() const { return "Image"; }
+
+
+bool ImageDecoder::accepts(const std::string &payload) const { return PayloadClassifier::imageFormat(payload) != nullptr; }
+
+
+DecodedPayload ImageDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+
+    // QImage (unlike QPixmap) can be used outside of the GUI thread
+    QSize original;
+    result.image = read(payload, QSize(IMAGE_PREVIEW_SIZE, IMAGE_PREVIEW_SIZE), &original);
+    if (result.image.isNull())
+    {
+        result.text = "Message can not be shown as an image.";
+        return result;
+    }
+
+    result.ok = true;
+    result.text = QString("Image %1 x %2, %3 bytes").arg(original.width()).arg(original.height()).arg(payload.length());
+
+    if (result.image.size() != original)
+    {
+        result.text.append(QString(", preview %1 x %2").arg(result.image.width()).arg(result.image.height()));
+        result.image.setText("OriginalSize", QString("%1x%2").arg(original.width()).arg(original.height()));
+    }
+
+    return result;
+}
+
+
+QImage ImageDecoder::read(const std::string &payload, QSize maximum, QSize *original)
+{
+    auto data = QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length()));
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer);
+
+    // JPEG decodes straight to the smaller size, which is much faster than scaling afterwards
+    auto size = reader.size();
+    bool downscale = maximum.isValid() && size.isValid() && (size.width() > maximum.width() || size.height() > maximum.height());
+    if (downscale && reader.supportsOption(QImageIOHandler::ScaledSize))
+    {
+        reader.setScaledSize(size.scaled(maximum, Qt::KeepAspectRatio));
+        downscale = false;
+    }
+
+    auto image = reader.read();
+    if (downscale && !image.isNull())
+        image = image.scaled(maximum, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+    if (original != nullptr)
+        *original = size.isValid() ? size : image.size();
+
+    return image;
+}
+
+QString CborDecoder::getName() const { return "CBOR"; }
+
+
+bool CborDecoder::accepts(const std::string &payload) const
+{
+    // Tag 55799 (self-described CBOR)
+    return payload.compare(0, 3, "\xd9\xd9\xf7", 3) == 0;
+}
+
+
+DecodedPayload CborDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+
+    QCborParserError error;
+    auto value = QCborValue::fromCbor(QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length())), &error);
+
+    if (error.error != QCborError::NoError)
+    {
+        result.text = QString("Invalid CBOR at offset %1: %2").arg(error.offset).arg(error.errorString());
+        return result;
+    }
+
+    result.ok = true;
+    result.text = value.toDiagnosticNotation(QCborValue::LineWrapped);
+    return result;
+}
+
+/**
+ * @brief Read big endian unsigned integer
+ * @param data to read from, moved past the integer
+ * @param end of data
+ * @param size of the integer in bytes
+ * @param value is the read integer
+ * @return false when data is too short
+ */
+static bool readUnsigned(const unsigned char *&data, const unsigned char *end, int size, quint64 &value)
+{
+    if (end - data < size)
+        return false;
+
+    value = 0;
+    for (int i = 0; i < size; i++)
+        value = (value << 8) | *data++;
+
+    return true;
+}
+
+
+/**
+ * @brief Convert one MessagePack value to JSON-like text
+ * @param data to read from, moved past the value
+ * @param end of data
+ * @param out is text the value is appended to
+ * @param depth of nesting, used for indentation
+ * @return false when data is not valid MessagePack
+ */
+static bool messagePackToText(const unsigned char *&data, const unsigned char *end, QString &out, int depth)
+{
+    if (data >= end || depth > MESSAGEPACK_MAX_DEPTH)
+        return false;
+
+    auto type = *data++;
+    quint64 length = 0;
+    bool isMap = false;
+
+    // Scalars
+    if (type <= 0x7f)
+    {
+        out.append(QString::number(type));
+        return true;
+    }
+    if (type >= 0xe0)
+    {
+        out.append(QString::number(static_cast<qint8>(type)));
+        return true;
+    }
+    if ((type >= 0xa0 && type <= 0xbf) || (type >= 0xd9 && type <= 0xdb))
+    {
+        if (type <= 0xbf)
+            length = type & 0x1f;
+        else if (!readUnsigned(data, end, 1 << (type - 0xd9), length))
+            return false;
+
+        if (static_cast<quint64>(end - data) < length)
+            return false;
+
+        auto text = QString::fromUtf8(reinterpret_cast<const char *>(data), static_cast<int>(length));
+        out.append("\"").append(text.replace("\\", "\\\\").replace("\"", "\\\"")).append("\"");
+        data += length;
+        return true;
+    }
+
+    switch (type)
+    {
+        case 0xc0:
+            out.append("null");
+            return true;
+        case 0xc2:
+            out.append("false");
+            return true;
+        case 0xc3:
+            out.append("true");
+            return true;
+        case 0xc4:
+        case 0xc5:
+        case 0xc6:
+        {
+            if (!readUnsigned(data, end, 1 << (type - 0xc4), length) || static_cast<quint64>(end - data) < length)
+                return false;
+
+            out.append("<binary ").append(QString::number(length)).append(" bytes>");
+            data += length;
+            return true;
+        }
+        case 0xc7:
+        case 0xc8:
+        case 0xc9:
+        case 0xd4:
+        case 0xd5:
+        case 0xd6:
+        case 0xd7:
+        case 0xd8:
+        {
+            if (type <= 0xc9 && !readUnsigned(data, end, 1 << (type - 0xc7), length))
+                return false;
+            if (type >= 0xd4)
+                length = 1ull << (type - 0xd4);
+
+            // Extension type byte and data
+            if (static_cast<quint64>(end - data) < length + 1)
+                return false;
+
+            out.append("<extension ").append(QString::number(static_cast<qint8>(*data))).append(", ").append(QString::number(length)).append(" bytes>");
+            data += length + 1;
+            return true;
+        }
+        case 0xca:
+        {
+            quint64 bits;
+            if (!readUnsigned(data, end, 4, bits))
+                return false;
+
+            quint32 bits32 = static_cast<quint32>(bits);
+            float value;
+            std::memcpy(&value, &bits32, sizeof(value));
+            out.append(QString::number(value));
+            return true;
+        }
+        case 0xcb:
+        {
+            quint64 bits;
+            if (!readUnsigned(data, end, 8, bits))
+                return false;
+
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            out.append(QString::number(value, 'g', 17));
+            return true;
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+        {
+            quint64 value;
+            if (!readUnsigned(data, end, 1 << (type - 0xcc), value))
+                return false;
+
+            out.append(QString::number(value));
+            return true;
+        }
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+        {
+            int size = 1 << (type - 0xd0);
+            quint64 value;
+            if (!readUnsigned(data, end, size, value))
+                return false;
+
+            // Sign extend
+            if (size < 8 && (value & (1ull << (size * 8 - 1))))
+                value |= ~0ull << (size * 8);
+
+            out.append(QString::number(static_cast<qint64>(value)));
+            return true;
+        }
+        case 0xdc:
+        case 0xdd:
+            if (!readUnsigned(data, end, type == 0xdc ? 2 : 4, length))
+                return false;
+            break;
+        case 0xde:
+        case 0xdf:
+            if (!readUnsigned(data, end, type == 0xde ? 2 : 4, length))
+                return false;
+            isMap = true;
+            break;
+        default:
+            if (type >= 0x80 && type <= 0x8f)
+            {
+                length = type & 0x0f;
+                isMap = true;
+                break;
+            }
+            if (type >= 0x90 && type <= 0x9f)
+            {
+                length = type & 0x0f;
+                break;
+            }
+
+            // 0xc1 is never used
+            return false;
+    }
+
+    // Containers, every element takes at least a byte
+    if (static_cast<quint64>(end - data) < length * (isMap ? 2 : 1))
+        return false;
+
+    auto indent = QString(2 * (depth + 1), ' ');
+    out.append(isMap ? "{" : "[");
+
+    for (quint64 i = 0; i < length; i++)
+    {
+        out.append(i == 0 ? "\n" : ",\n").append(indent);
+
+        if (isMap)
+        {
+            if (!messagePackToText(data, end, out, depth + 1))
+                return false;
+            out.append(": ");
+        }
+
+        if (!messagePackToText(data, end, out, depth + 1))
+            return false;
+    }
+
+    if (length > 0)
+        out.append("\n").append(QString(2 * depth, ' '));
+    out.append(isMap ? "}" : "]");
+
+    return true;
+}
+
+
+QString MessagePackDecoder::getName() const { return "MessagePack"; }
+
+
+bool MessagePackDecoder::accepts(const std::string &payload) const
+{
+    if (payload.empty())
+        return false;
+
+    auto type = static_cast<unsigned char>(payload[0]);
+    if (!((type >= 0x80 && type <= 0x8f) || type == 0xde || type == 0xdf))
+        return false;
+
+    QString text;
+    auto data = reinterpret_cast<const unsigned char *>(payload.data());
+    auto end = data + payload.length();
+
+    return messagePackToText(data, end, text, 0) && data == end;
+}
+
+
+DecodedPayload MessagePackDecoder::decode(const std::string &payload) const
+{
+    DecodedPayload result;
+    result.decoder = getName();
+
+    auto data = reinterpret_cast<const unsigned char *>(payload.data());
+    auto begin = data;
+    auto end = data + payload.length();
+
+    QString text;
+    if (!messagePackToText(data, end, text, 0))
+    {
+        result.text = QString("Invalid MessagePack at offset %1").arg(data - begin);
+        return result;
+    }
+
+    result.ok = true;
+    result.text = text;
+    if (data != end)
+        result.text.append(QString("\n\n%1 trailing bytes").arg(end - data));
+
+    return result;
+}
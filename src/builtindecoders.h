@@ -0,0 +1,136 @@
+/**
+ * @file builtindecoders.h
+ * @brief Header file for payload decoders built into the application
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef BUILTINDECODERS_H
+#define BUILTINDECODERS_H
+
+#include "payloaddecoder.h"
+
+#include <QSize>
+
+/**
+ * @brief Number of bytes of a payload decoded by text and hex decoders, the rest is paged by the inspector
+ */
+const size_t DECODE_TEXT_BYTES = 1024 * 1024;
+
+/**
+ * @brief Maximum width and height of images produced by the image decoder, larger images are downscaled
+ */
+const int IMAGE_PREVIEW_SIZE = 2048;
+
+class TextDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts payloads that start with valid UTF-8 without NUL characters
+     */
+    bool accepts(const std::string &payload) const override;
+    DecodedPayload decode(const std::string &payload) const override;
+};
+
+class JsonDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts payloads enclosed in braces or brackets
+     */
+    bool accepts(const std::string &payload) const override;
+
+    /**
+     * @brief Pretty-print JSON document
+     */
+    DecodedPayload decode(const std::string &payload) const override;
+};
+
+class HexDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts any payload, used as the last resort
+     */
+    bool accepts(const std::string &payload) const override;
+
+    /**
+     * @brief Hex dump with offsets and printable characters
+     */
+    DecodedPayload decode(const std::string &payload) const override;
+
+    /**
+     * @brief Hex dump part of a payload
+     * @param data to dump
+     * @param length of the data
+     * @param offset of the data in the payload, shown at the beginning of lines
+     * @return lines of 16 bytes
+     */
+    static QString dump(const char *data, size_t length, size_t offset);
+};
+
+class ImageDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts payloads starting with PNG, JPEG, GIF, BMP or WebP magic bytes
+     */
+    bool accepts(const std::string &payload) const override;
+
+    /**
+     * @brief Decode image downscaled to fit IMAGE_PREVIEW_SIZE, so large images are shown quickly, downscaled images
+     * have text "OriginalSize" set to the full resolution (e.g. "8000x6000")
+     */
+    DecodedPayload decode(const std::string &payload) const override;
+
+    /**
+     * @brief Decode image, formats that support it are downscaled while decoding
+     * @param payload to decode
+     * @param maximum width and height, invalid size for full resolution
+     * @param original is set to the full resolution when it is not nullptr
+     * @return image, null when the payload isn't an image
+     */
+    static QImage read(const std::string &payload, QSize maximum, QSize *original = nullptr);
+};
+
+class CborDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts payloads starting with the self-described CBOR tag, other CBOR has to be selected by a rule
+     */
+    bool accepts(const std::string &payload) const override;
+
+    /**
+     * @brief Show CBOR in diagnostic notation
+     */
+    DecodedPayload decode(const std::string &payload) const override;
+};
+
+class MessagePackDecoder : public PayloadDecoder
+{
+public:
+    QString getName() const override;
+
+    /**
+     * @brief Accepts payloads that start with a map and parse as exactly one MessagePack value
+     */
+    bool accepts(const std::string &payload) const override;
+
+    /**
+     * @brief Show MessagePack in JSON-like notation
+     */
+    DecodedPayload decode(const std::string &payload) const override;
+};
+
+#endif // BUILTINDECODERS_H
@@ -0,0 +1,394 @@
+/**
+ * @file chartwidget.cpp
+ * @brief Implementation of line chart of a numeric time series
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "chartwidget.h"
+
+#include <QPainter>
+#include <QPolygonF>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Shortest time axis in milliseconds, so that a few samples aren't stretched over the whole chart
+ */
+const qint64 CHART_MIN_SPAN = 1000;
+
+
+ChartWidget::ChartWidget(QString field, QWidget *parent) : QWidget(parent), field(field)
+{
+    setMinimumSize(160, 100);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+
+    // The whole widget is painted by the chart
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+
+QString ChartWidget::getField() { return field; }
+
+
+void ChartWidget::setDecimation(Decimation decimation)
+{
+    this->decimation = decimation;
+    invalidated = true;
+    update();
+}
+
+
+void ChartWidget::setSeries(const TimeSeries *series)
+{
+    if (series != this->series)
+    {
+        this->series = series;
+        invalidated = true;
+        update();
+        return;
+    }
+
+    if (series == nullptr)
+        return;
+
+    // Nothing is painted when no sample arrived since the last paint
+    auto size = series->size();
+    if (size == decimatedSize && (size == 0 || series->getTimestamps().last() == decimatedLast))
+        return;
+
+    update();
+}
+
+
+void ChartWidget::paintEvent(QPaintEvent *event)
+{
+    decimate();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    auto plot = plotArea();
+    painter.setPen(palette().mid().color());
+    painter.drawRect(plot.adjusted(0, 0, -1, -1));
+
+    // Range of values
+    bool empty = true;
+    double yMin = 0;
+    double yMax = 0;
+    double lastValue = 0;
+
+    if (decimation == Decimation::MinMax)
+    {
+        for (auto &column : columns)
+        {
+            if (column.count == 0)
+                continue;
+
+            yMin = empty ? column.min : std::min(yMin, column.min);
+            yMax = empty ? column.max : std::max(yMax, column.max);
+            lastValue = column.last;
+            empty = false;
+        }
+    }
+    else
+    {
+        for (auto &point : lttbPoints)
+        {
+            yMin = empty ? point.y() : std::min(yMin, point.y());
+            yMax = empty ? point.y() : std::max(yMax, point.y());
+            lastValue = point.y();
+            empty = false;
+        }
+    }
+
+    painter.setPen(palette().text().color());
+    if (empty)
+    {
+        painter.drawText(plot, Qt::AlignCenter, "No numeric data");
+        return;
+    }
+
+    if (yMax == yMin)
+    {
+        auto margin = std::max(std::abs(yMin) * 0.05, 1.0);
+        yMin -= margin;
+        yMax += margin;
+    }
+
+    auto mapY = [&plot, yMin, yMax](double value)
+    {
+        return plot.bottom() - (value - yMin) / (yMax - yMin) * (plot.height() - 1);
+    };
+
+    QPolygonF line;
+    if (decimation == Decimation::MinMax)
+    {
+        line.reserve(columns.size() * 4);
+        for (int i = 0; i < columns.size(); i++)
+        {
+            auto &column = columns.at(i);
+            if (column.count == 0)
+                continue;
+
+            // Vertical stroke covering the column keeps spikes visible however many samples fall into it
+            double x = plot.left() + i + 0.5;
+            line.append(QPointF(x, mapY(column.first)));
+            line.append(QPointF(x, mapY(column.min)));
+            line.append(QPointF(x, mapY(column.max)));
+            line.append(QPointF(x, mapY(column.last)));
+        }
+    }
+    else
+    {
+        double span = axisEnd - axisStart;
+        line.reserve(lttbPoints.size());
+        for (auto &point : lttbPoints)
+            line.append(QPointF(plot.left() + point.x() / span * (plot.width() - 1), mapY(point.y())));
+    }
+
+    painter.setPen(QPen(palette().highlight().color(), 1));
+    painter.drawPolyline(line);
+
+    // Labels in the margins above and below the plot
+    painter.setPen(palette().text().color());
+    auto top = QRect(plot.left(), 0, plot.width(), plot.top());
+    auto bottom = QRect(plot.left(), plot.bottom() + 1, plot.width(), height() - plot.bottom() - 1);
+
+    painter.drawText(top, Qt::AlignLeft | Qt::AlignVCenter, QString::number(yMax, 'g', 6));
+    painter.drawText(bottom, Qt::AlignLeft | Qt::AlignVCenter, QString::number(yMin, 'g', 6));
+    painter.drawText(top, Qt::AlignRight | Qt::AlignVCenter, QString("%1 (%2 samples)").arg(QString::number(lastValue, 'g', 6)).arg(decimatedSize));
+}
+
+
+void ChartWidget::resizeEvent(QResizeEvent *event)
+{
+    invalidated = true;
+    QWidget::resizeEvent(event);
+}
+
+
+QRect ChartWidget::plotArea()
+{
+    auto margin = fontMetrics().height() + 2;
+    return rect().adjusted(2, margin, -2, -margin);
+}
+
+
+void ChartWidget::decimate()
+{
+    auto size = series != nullptr ? series->size() : 0;
+    auto width = plotArea().width();
+
+    if (size == 0 || width <= 0)
+    {
+        columns.clear();
+        lttbPoints.clear();
+        lttbSelected.clear();
+        decimatedSize = 0;
+        invalidated = false;
+        return;
+    }
+
+    auto &timestamps = series->getTimestamps();
+    auto first = timestamps.first();
+    auto last = timestamps.last();
+
+    if (!invalidated && size == decimatedSize && last == decimatedLast)
+        return;
+
+    // Samples dropped from the front, or a new sample past the end of the axis, move every column
+    bool full = invalidated || first != decimatedFirst || last > axisEnd || size < decimatedSize;
+    if (full)
+    {
+        auto span = std::max(last - first, CHART_MIN_SPAN);
+        axisStart = first;
+        axisEnd = first + span + span / 4;
+    }
+
+    if (decimation == Decimation::MinMax)
+    {
+        if (full || columns.size() != width)
+        {
+            columns.fill(Column(), width);
+            decimateMinMax(0);
+        }
+        else
+        {
+            // Only the column the previous last sample fell into and the ones after it can change
+            auto column = static_cast<int>((decimatedLast - axisStart) * width / (axisEnd - axisStart));
+            decimateMinMax(std::min(std::max(column, 0), width - 1));
+        }
+    }
+    else
+    {
+        // Two buckets per pixel column, the first and the last sample are kept besides them
+        auto buckets = 2 * width;
+        if (size <= buckets + 2)
+        {
+            lttbSelected.clear();
+            lttbPoints.clear();
+            for (int i = 0; i < size; i++)
+                lttbPoints.append(QPointF(timestamps.at(i) - axisStart, series->getValues().at(i)));
+        }
+        else if (full || lttbSelected.size() != buckets)
+        {
+            lttbSelected.fill(-1, buckets);
+            decimateLttb(0);
+        }
+        else
+        {
+            // Selection in a bucket depends on the next bucket with samples, so the last selection before the previous last sample changes too
+            auto bucket = static_cast<int>((decimatedLast - axisStart) * buckets / (axisEnd - axisStart));
+            bucket = std::min(std::max(bucket, 0), buckets - 1) - 1;
+            while (bucket > 0 && lttbSelected.at(bucket) < 0)
+                bucket--;
+
+            decimateLttb(std::max(bucket, 0));
+        }
+    }
+
+    decimatedSize = size;
+    decimatedFirst = first;
+    decimatedLast = last;
+    invalidated = false;
+}
+
+
+void ChartWidget::decimateMinMax(int fromColumn)
+{
+    auto &values = series->getValues();
+    auto size = series->size();
+    auto width = columns.size();
+    auto span = axisEnd - axisStart;
+
+    for (int i = fromColumn; i < width; i++)
+    {
+        auto begin = series->indexOf(axisStart + span * i / width);
+        auto end = i == width - 1 ? size : series->indexOf(axisStart + span * (i + 1) / width);
+
+        Column column;
+        if (end > begin)
+        {
+            // Statistics use per-block summaries, so a column costs about the same for any number of samples
+            auto statistics = series->statistics(begin, end);
+            column.count = statistics.count;
+            column.first = values.at(begin);
+            column.last = values.at(end - 1);
+            column.min = statistics.min;
+            column.max = statistics.max;
+        }
+        columns[i] = column;
+
+        if (end >= size)
+        {
+            std::fill(columns.begin() + i + 1, columns.end(), Column());
+            break;
+        }
+    }
+}
+
+
+void ChartWidget::decimateLttb(int fromBucket)
+{
+    auto &timestamps = series->getTimestamps();
+    auto &values = series->getValues();
+    auto size = series->size();
+    auto buckets = lttbSelected.size();
+    auto span = axisEnd - axisStart;
+
+    // The triangles start at the sample selected before the first recomputed bucket
+    int selected = 0;
+    for (int i = fromBucket - 1; i >= 0; i--)
+    {
+        if (lttbSelected.at(i) >= 0)
+        {
+            selected = lttbSelected.at(i);
+            break;
+        }
+    }
+
+    for (int bucket = fromBucket; bucket < buckets; bucket++)
+    {
+        int begin;
+        int end;
+        bucketRange(bucket, buckets, begin, end);
+
+        // The first and the last sample are not part of any bucket
+        begin = std::max(begin, 1);
+        end = std::min(end, size - 1);
+
+        if (begin >= size - 1)
+        {
+            std::fill(lttbSelected.begin() + bucket, lttbSelected.end(), -1);
+            break;
+        }
+
+        if (begin >= end)
+        {
+            lttbSelected[bucket] = -1;
+            continue;
+        }
+
+        // Third vertex of the triangles is the average of the next bucket with samples, or the last sample
+        double averageX = timestamps.at(size - 1) - axisStart;
+        double averageY = values.at(size - 1);
+        if (end < size - 1)
+        {
+            int nextBegin;
+            int nextEnd;
+            auto next = std::min(std::max(static_cast<int>((timestamps.at(end) - axisStart) * buckets / span), bucket + 1), buckets - 1);
+            bucketRange(next, buckets, nextBegin, nextEnd);
+
+            // Bucket computed from the time can be one off due to rounding of the bucket bounds
+            while (nextEnd <= end && next < buckets - 1)
+                bucketRange(++next, buckets, nextBegin, nextEnd);
+
+            nextBegin = std::max(nextBegin, end);
+            nextEnd = std::min(nextEnd, size - 1);
+
+            if (nextEnd > nextBegin)
+            {
+                // Values are averaged from the block summaries, the time from the ends of the bucket
+                averageX = (timestamps.at(nextBegin) + timestamps.at(nextEnd - 1)) / 2.0 - axisStart;
+                averageY = series->statistics(nextBegin, nextEnd).average;
+            }
+        }
+
+        // Sample of the current bucket forming the largest triangle with the previously selected one
+        double ax = timestamps.at(selected) - axisStart;
+        double ay = values.at(selected);
+        double maxArea = -1;
+        int maxIndex = begin;
+
+        for (int i = begin; i < end; i++)
+        {
+            auto area = std::abs((ax - averageX) * (values.at(i) - ay) - (ax - (timestamps.at(i) - axisStart)) * (averageY - ay));
+            if (area > maxArea)
+            {
+                maxArea = area;
+                maxIndex = i;
+            }
+        }
+
+        lttbSelected[bucket] = maxIndex;
+        selected = maxIndex;
+    }
+
+    lttbPoints.clear();
+    lttbPoints.append(QPointF(timestamps.at(0) - axisStart, values.at(0)));
+    for (auto index : lttbSelected)
+    {
+        if (index >= 0)
+            lttbPoints.append(QPointF(timestamps.at(index) - axisStart, values.at(index)));
+    }
+    lttbPoints.append(QPointF(timestamps.at(size - 1) - axisStart, values.at(size - 1)));
+}
+
+
+void ChartWidget::bucketRange(int bucket, int buckets, int &begin, int &end)
+{
+    auto span = axisEnd - axisStart;
+    begin = series->indexOf(axisStart + span * bucket / buckets);
+    end = bucket == buckets - 1 ? series->size() : series->indexOf(axisStart + span * (bucket + 1) / buckets);
+}
@@ -0,0 +1,171 @@
+/**
+ * @file chartwidget.h
+ * @brief Header file for line chart of a numeric time series
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef CHARTWIDGET_H
+#define CHARTWIDGET_H
+
+#include "timeseries.h"
+
+#include <QPointF>
+#include <QVector>
+#include <QWidget>
+
+/**
+ * @brief Number of samples kept by series shown in a chart
+ */
+const int CHART_SERIES_CAPACITY = 1 << 20;
+
+class ChartWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief How samples are reduced to the width of the chart
+     */
+    enum class Decimation
+    {
+        MinMax, ///< Minimum and maximum of every pixel column, updated incrementally
+        Lttb    ///< Largest-triangle-three-buckets over time buckets, updated incrementally
+    };
+
+    /**
+     * @brief Line chart of a numeric time series
+     * @param field is path of the JSON field the chart shows, empty for plain number payloads
+     * @param parent widget
+     */
+    explicit ChartWidget(QString field, QWidget *parent = nullptr);
+
+    /**
+     * @brief Get field shown by the chart
+     * @return field path
+     */
+    QString getField();
+
+    /**
+     * @brief Set how samples are reduced to the width of the chart
+     * @param decimation method
+     */
+    void setDecimation(Decimation decimation);
+
+    /**
+     * @brief Set series to show, called periodically, repaints only when the series changed
+     * @param series to show or nullptr when there is none
+     */
+    void setSeries(const TimeSeries *series);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    /**
+     * @brief Summary of samples falling into one pixel column
+     */
+    struct Column
+    {
+        int count = 0;
+        double first = 0;
+        double last = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    /**
+     * @brief Field shown by the chart
+     */
+    QString field;
+
+    /**
+     * @brief Decimation method
+     */
+    Decimation decimation = Decimation::MinMax;
+
+    /**
+     * @brief Shown series, owned by the topic
+     */
+    const TimeSeries *series = nullptr;
+
+    /**
+     * @brief Pixel columns for min/max decimation
+     */
+    QVector<Column> columns;
+
+    /**
+     * @brief Points (milliseconds from axis start, value) selected by LTTB
+     */
+    QVector<QPointF> lttbPoints;
+
+    /**
+     * @brief Index of the sample selected in every LTTB bucket, -1 for empty buckets
+     */
+    QVector<int> lttbSelected;
+
+    /**
+     * @brief Start of the time axis in milliseconds since epoch
+     */
+    qint64 axisStart = 0;
+
+    /**
+     * @brief End of the time axis, with headroom so that new samples don't rescale the axis every time
+     */
+    qint64 axisEnd = 0;
+
+    /**
+     * @brief Number of samples when the chart was last decimated
+     */
+    int decimatedSize = 0;
+
+    /**
+     * @brief Time of the first sample when the chart was last decimated
+     */
+    qint64 decimatedFirst = 0;
+
+    /**
+     * @brief Time of the last sample when the chart was last decimated
+     */
+    qint64 decimatedLast = 0;
+
+    /**
+     * @brief True when everything has to be decimated again (new series, resize, method change)
+     */
+    bool invalidated = true;
+
+    /**
+     * @brief Get area of the widget the line is drawn to
+     * @return plot area
+     */
+    QRect plotArea();
+
+    /**
+     * @brief Decimate samples added since the last paint, or all samples when invalidated
+     */
+    void decimate();
+
+    /**
+     * @brief Recompute min/max of pixel columns starting with a column
+     * @param fromColumn is the first recomputed column
+     */
+    void decimateMinMax(int fromColumn);
+
+    /**
+     * @brief Select points by largest-triangle-three-buckets, buckets split the time axis like columns
+     * @param fromBucket is the first bucket selected again, earlier selections are kept
+     */
+    void decimateLttb(int fromBucket);
+
+    /**
+     * @brief Get range of samples in a time bucket of the axis
+     * @param bucket index
+     * @param buckets is number of buckets
+     * @param begin is index of the first sample
+     * @param end is index after the last sample
+     */
+    void bucketRange(int bucket, int buckets, int &begin, int &end);
+};
+
+#endif // CHARTWIDGET_H
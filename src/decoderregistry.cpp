@@ -0,0 +1,260 @@
+/**
+ * @file decoderregistry.cpp
+ * @brief Implementation of registry of payload decoders
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "decoderregistry.h"
+#include "builtindecoders.h"
+
+#include <QDir>
+#include <QPluginLoader>
+#include <QtConcurrent>
+
+/**
+ * @brief Maximum size of cached decoded payloads in bytes
+ */
+const int DECODER_CACHE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * @brief Number of threads decoding payloads
+ */
+const int DECODER_THREADS = 2;
+
+
+DecoderRegistry::DecoderRegistry()
+{
+    cache.setMaxCost(DECODER_CACHE_SIZE);
+    pool.setMaxThreadCount(DECODER_THREADS);
+
+    // Specific formats first, hex dump accepts anything so it has to be the last one
+    decoders.append(new ImageDecoder());
+    decoders.append(new CborDecoder());
+    decoders.append(new MessagePackDecoder());
+    decoders.append(new JsonDecoder());
+    decoders.append(new TextDecoder());
+    decoders.append(new HexDecoder());
+}
+
+
+DecoderRegistry::~DecoderRegistry()
+{
+    pool.waitForDone();
+
+    // Instances of plugins belong to their plugin loaders
+    for (auto decoder : decoders)
+    {
+        if (!pluginDecoders.contains(decoder))
+            delete decoder;
+    }
+}
+
+
+void DecoderRegistry::addDecoder(PayloadDecoder *decoder)
+{
+    QMutexLocker locker(&mutex);
+    decoders.prepend(decoder);
+}
+
+
+int DecoderRegistry::loadPlugins(QString directory, QStringList &errors)
+{
+    QDir dir(directory);
+    if (!dir.exists())
+    {
+        errors.append(QString("Directory %1 does not exist.").arg(directory));
+        return 0;
+    }
+
+    int loaded = 0;
+    for (auto &fileName : dir.entryList(QDir::Files))
+    {
+        auto path = dir.absoluteFilePath(fileName);
+        if (!QLibrary::isLibrary(path))
+            continue;
+
+        // Plugins stay loaded for the lifetime of the application, the instance is owned by the loader
+        QPluginLoader loader(path);
+        auto instance = loader.instance();
+        if (instance == nullptr)
+        {
+            errors.append(QString("%1: %2").arg(fileName, loader.errorString()));
+            continue;
+        }
+
+        auto decoder = qobject_cast<PayloadDecoder *>(instance);
+        if (decoder == nullptr)
+        {
+            errors.append(QString("%1: not a payload decoder").arg(fileName));
+            continue;
+        }
+
+        QMutexLocker locker(&mutex);
+        if (findDecoder(decoder->getName()) != nullptr)
+        {
+            errors.append(QString("%1: decoder %2 is already registered").arg(fileName, decoder->getName()));
+            continue;
+        }
+
+        decoders.prepend(decoder);
+        pluginDecoders.append(decoder);
+        loaded++;
+    }
+
+    return loaded;
+}
+
+
+QStringList DecoderRegistry::getDecoderNames()
+{
+    QMutexLocker locker(&mutex);
+
+    QStringList names;
+    for (auto decoder : decoders)
+        names.append(decoder->getName());
+
+    return names;
+}
+
+
+void DecoderRegistry::setRules(QList<QPair<TopicFilter, QString>> rules)
+{
+    QMutexLocker locker(&mutex);
+    this->rules = rules;
+}
+
+
+QString DecoderRegistry::parseRules(QString text, QList<QPair<TopicFilter, QString>> &rules)
+{
+    rules.clear();
+
+    for (auto &rule : text.split(";"))
+    {
+        if (rule.trimmed().isEmpty())
+            continue;
+
+        auto parts = rule.split("=");
+        if (parts.length() != 2)
+            return QString("Rule \"%1\" is not in format filter=Decoder.").arg(rule.trimmed());
+
+        auto filter = parts[0].trimmed();
+        auto decoder = parts[1].trimmed();
+
+        if (!TopicFilter::isValid(filter))
+            return QString("Topic filter \"%1\" is not valid.").arg(filter);
+
+        {
+            QMutexLocker locker(&mutex);
+            if (findDecoder(decoder) == nullptr)
+                return QString("Decoder \"%1\" does not exist.").arg(decoder);
+        }
+
+        rules.append(qMakePair(TopicFilter(filter), decoder));
+    }
+
+    return QString();
+}
+
+
+QString DecoderRegistry::selectDecoder(QString topic, const std::string &payload, PayloadKind kind)
+{
+    QMutexLocker locker(&mutex);
+
+    auto topicLevels = topic.split("/");
+    for (auto &rule : rules)
+    {
+        if (rule.first.matches(topicLevels))
+            return rule.second;
+    }
+
+    // Plugins know formats the classifier doesn't, text payloads may still be e.g. CSV for a plugin
+    for (auto decoder : pluginDecoders)
+    {
+        if (decoder->accepts(payload))
+            return decoder->getName();
+    }
+
+    switch (kind)
+    {
+        case PayloadKind::Image:
+            return ImageDecoder().getName();
+        case PayloadKind::Json:
+            return JsonDecoder().getName();
+        case PayloadKind::Empty:
+        case PayloadKind::Number:
+        case PayloadKind::Text:
+            return TextDecoder().getName();
+        default:
+            break;
+    }
+
+    // Binary payloads are sniffed by the remaining decoders, CBOR and MessagePack are binary
+    for (auto decoder : decoders)
+    {
+        if (!pluginDecoders.contains(decoder) && decoder->accepts(payload))
+            return decoder->getName();
+    }
+
+    return decoders.last()->getName();
+}
+
+
+QFuture<DecodedPayload> DecoderRegistry::decode(quint64 messageId, QString topic, std::shared_ptr<const std::string> payload, QString decoderName,
+                                                PayloadKind kind)
+{
+    return QtConcurrent::run(&pool, [this, messageId, topic, payload, decoderName, kind]() -> DecodedPayload
+    {
+        // Sniffing reads only the beginning of the payload but still happens off the GUI thread
+        auto name = decoderName.isEmpty() ? selectDecoder(topic, *payload, kind) : decoderName;
+        auto key = QString("%1/%2").arg(messageId).arg(name);
+
+        PayloadDecoder *decoder;
+        {
+            QMutexLocker locker(&mutex);
+
+            auto cached = cache.object(key);
+            if (cached != nullptr)
+                return *cached;
+
+            decoder = findDecoder(name);
+        }
+
+        DecodedPayload result;
+        if (decoder == nullptr)
+        {
+            result.decoder = name;
+            result.text = QString("Decoder %1 does not exist.").arg(name);
+            return result;
+        }
+
+        result = decoder->decode(*payload);
+
+        // Text is stored in UTF-16
+        auto cost = result.text.size() * 2 + static_cast<int>(result.image.sizeInBytes());
+
+        QMutexLocker locker(&mutex);
+        cache.insert(key, new DecodedPayload(result), cost);
+
+        return result;
+    });
+}
+
+
+QFuture<QImage> DecoderRegistry::decodeImage(std::shared_ptr<const std::string> payload)
+{
+    // Full images are too big for the cache, they are decoded again every time
+    return QtConcurrent::run(&pool, [payload]() { return ImageDecoder::read(*payload, QSize()); });
+}
+
+
+PayloadDecoder *DecoderRegistry::findDecoder(QString name)
+{
+    for (auto decoder : decoders)
+    {
+        if (decoder->getName() == name)
+            return decoder;
+    }
+
+    return nullptr;
+}
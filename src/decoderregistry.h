@@ -0,0 +1,135 @@
+/**
+ * @file decoderregistry.h
+ * @brief Header file for registry of payload decoders
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef DECODERREGISTRY_H
+#define DECODERREGISTRY_H
+
+#include "payloadclassifier.h"
+#include "payloaddecoder.h"
+#include "topicfilter.h"
+
+#include <QCache>
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QThreadPool>
+#include <memory>
+
+class DecoderRegistry
+{
+public:
+    /**
+     * @brief Registry of payload decoders, decodes payloads on its own thread pool and caches the results
+     */
+    DecoderRegistry();
+    ~DecoderRegistry();
+
+    /**
+     * @brief Add decoder, decoders added later are sniffed before the built-in ones
+     * @param decoder to add, ownership is taken over
+     */
+    void addDecoder(PayloadDecoder *decoder);
+
+    /**
+     * @brief Load decoder plugins implementing PayloadDecoder interface from a directory
+     * @param directory to load plugins from
+     * @param errors are descriptions of plugins that could not be loaded
+     * @return number of loaded decoders
+     */
+    int loadPlugins(QString directory, QStringList &errors);
+
+    /**
+     * @brief Get names of all decoders
+     * @return names in order of sniffing
+     */
+    QStringList getDecoderNames();
+
+    /**
+     * @brief Set rules choosing decoder by topic, rules take precedence over sniffing
+     * @param rules are pairs of topic filter and decoder name, the first matching rule is used
+     */
+    void setRules(QList<QPair<TopicFilter, QString>> rules);
+
+    /**
+     * @brief Parse rules in format "filter=Decoder; filter=Decoder"
+     * @param text to parse
+     * @param rules are the parsed rules
+     * @return empty string on success, otherwise description of the error
+     */
+    QString parseRules(QString text, QList<QPair<TopicFilter, QString>> &rules);
+
+    /**
+     * @brief Select decoder for a payload by rules and then by sniffing, built-in decoders are chosen by the kind of the
+     * payload when it is known, decoder plugins are always sniffed
+     * @param topic of the message
+     * @param payload of the message
+     * @param kind of the payload, Unknown to sniff all decoders
+     * @return name of the decoder
+     */
+    QString selectDecoder(QString topic, const std::string &payload, PayloadKind kind = PayloadKind::Unknown);
+
+    /**
+     * @brief Decode payload on a worker thread, results are cached by message and decoder
+     * @param messageId is unique identifier of the message
+     * @param topic of the message, used by rules
+     * @param payload of the message, kept alive until decoding is done
+     * @param decoderName is the decoder to use, empty for automatic selection
+     * @param kind of the payload, used by automatic selection
+     * @return future with the decoded payload
+     */
+    QFuture<DecodedPayload> decode(quint64 messageId, QString topic, std::shared_ptr<const std::string> payload, QString decoderName = QString(),
+                                   PayloadKind kind = PayloadKind::Unknown);
+
+    /**
+     * @brief Decode image at full resolution on a worker thread, used after its downscaled preview was shown
+     * @param payload of the message, kept alive until decoding is done
+     * @return future with the image, null when the payload isn't an image
+     */
+    QFuture<QImage> decodeImage(std::shared_ptr<const std::string> payload);
+
+private:
+    /**
+     * @brief Decoders in order of sniffing, owned by the registry
+     */
+    QList<PayloadDecoder *> decoders;
+
+    /**
+     * @brief Decoders loaded from plugins, not deleted by the registry
+     */
+    QList<PayloadDecoder *> pluginDecoders;
+
+    /**
+     * @brief Rules choosing decoder by topic
+     */
+    QList<QPair<TopicFilter, QString>> rules;
+
+    /**
+     * @brief Decoded payloads keyed by "<message id>/<decoder>", cost is approximate size in bytes
+     */
+    QCache<QString, DecodedPayload> cache;
+
+    /**
+     * @brief Protects decoders, rules and cache
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Threads decoding runs on, separate from the global pool used by file publishing
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Find decoder by name, mutex has to be locked
+     * @param name of the decoder
+     * @return decoder or nullptr when not found
+     */
+    PayloadDecoder *findDecoder(QString name);
+};
+
+#endif // DECODERREGISTRY_H
@@ -0,0 +1,167 @@
+/**
+ * @file filepublisher.cpp
+ * @brief Implementation of file publisher
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "filepublisher.h"
+
+#include <QtConcurrent/QtConcurrent>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+// Files are published in chunks as "<topic>/chunks/<index>" with raw data, followed by a manifest
+// on "<topic>" ({"name", "size", "chunkSize", "chunks"}) once every chunk was handed to the client.
+
+/**
+ * @brief Maximum number of messages waiting in the handler while publishing files
+ */
+const int MAX_PENDING_MESSAGES = 16;
+
+
+FilePublisher::FilePublisher(MqttHandler *mqttHandler, QObject *parent)
+    : QObject(parent), mqttHandler(mqttHandler), running(false) {}
+
+
+FilePublisher::~FilePublisher()
+{
+    stop();
+}
+
+
+void FilePublisher::run(QString topic, QString path, int qos, bool retained, qint64 chunkSize)
+{
+    if (running)
+        return;
+
+    running = true;
+
+    worker = QtConcurrent::run(this, &FilePublisher::_run, topic, path, qos, retained, chunkSize);
+}
+
+
+void FilePublisher::stop()
+{
+    running = false;
+    worker.waitForFinished();
+}
+
+
+MqttHandler *FilePublisher::getMqttHandler() { return mqttHandler; }
+
+
+bool FilePublisher::isRunning() { return running; }
+
+
+void FilePublisher::_run(QString topic, QString path, int qos, bool retained, qint64 chunkSize)
+{
+    // Collect files first so that progress can be reported against the total size
+    QList<QPair<QString, QString>> files;
+    qint64 bytesTotal = 0;
+
+    QFileInfo pathInfo(path);
+    if (pathInfo.isDir())
+    {
+        QDir root(path);
+        QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            auto filePath = it.next();
+            files.append(qMakePair(QString(topic).append("/").append(root.relativeFilePath(filePath)), filePath));
+            bytesTotal += it.fileInfo().size();
+        }
+    }
+    else
+    {
+        files.append(qMakePair(topic, path));
+        bytesTotal = pathInfo.size();
+    }
+
+    QString error;
+    qint64 bytesPublished = 0;
+    emit progress(bytesPublished, bytesTotal);
+
+    for (int i = 0; i < files.length() && running; i++)
+    {
+        error = publishFile(files.at(i).first, files.at(i).second, qos, retained, chunkSize, bytesPublished, bytesTotal);
+        if (!error.isEmpty())
+            break;
+    }
+
+    if (error.isEmpty() && !running)
+        error = "Publishing was stopped.";
+
+    running = false;
+    emit finished(error);
+}
+
+
+QString FilePublisher::publishFile(QString topic, QString filePath, int qos, bool retained, qint64 chunkSize, qint64 &bytesPublished, qint64 bytesTotal)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString("File '").append(filePath).append("' could not be opened: ").append(file.errorString());
+
+    // Empty files can't be mapped, their empty payload is still published, retained it clears the retained message
+    auto size = file.size();
+    if (size == 0)
+    {
+        if (waitForRoom())
+            mqttHandler->publishMessage(topic, std::string(), qos, retained);
+        return QString();
+    }
+
+    // The mapping is handed to the client directly, the data is copied only into the client's message
+    auto data = reinterpret_cast<const char *>(file.map(0, size));
+    if (data == nullptr)
+        return QString("File '").append(filePath).append("' could not be mapped: ").append(file.errorString());
+
+    if (chunkSize <= 0 || size <= chunkSize)
+    {
+        if (!waitForRoom())
+            return QString();
+
+        mqttHandler->publishMessage(topic, data, size, qos, retained);
+        bytesPublished += size;
+        emit progress(bytesPublished, bytesTotal);
+        return QString();
+    }
+
+    qint64 chunks = (size + chunkSize - 1) / chunkSize;
+    for (qint64 index = 0; index < chunks; index++)
+    {
+        if (!waitForRoom())
+            return QString();
+
+        auto offset = index * chunkSize;
+        auto length = std::min(chunkSize, size - offset);
+        auto chunkTopic = QString(topic).append("/chunks/").append(QString::number(index));
+
+        mqttHandler->publishMessage(chunkTopic, data + offset, length, qos, retained);
+        bytesPublished += length;
+        emit progress(bytesPublished, bytesTotal);
+    }
+
+    auto manifest = QString("{\"name\":\"%1\",\"size\":%2,\"chunkSize\":%3,\"chunks\":%4}")
+            .arg(QFileInfo(filePath).fileName().replace("\\", "\\\\").replace("\"", "\\\""))
+            .arg(size).arg(chunkSize).arg(chunks);
+
+    if (waitForRoom())
+        mqttHandler->publishMessage(topic, manifest.toStdString(), qos, retained);
+
+    return QString();
+}
+
+
+bool FilePublisher::waitForRoom()
+{
+    while (running)
+    {
+        if (mqttHandler->waitForPendingBelow(MAX_PENDING_MESSAGES, std::chrono::milliseconds(100)))
+            return true;
+    }
+
+    return false;
+}
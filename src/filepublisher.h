@@ -0,0 +1,112 @@
+/**
+ * @file filepublisher.h
+ * @brief Header file for file publisher class
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef FILEPUBLISHER_H
+#define FILEPUBLISHER_H
+
+#include "mqtthandler.h"
+
+#include <QFuture>
+#include <QObject>
+#include <atomic>
+
+class FilePublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Publishes files and directories on a worker thread
+     * @param mqttHandler used for publishing
+     * @param parent object
+     */
+    FilePublisher(MqttHandler *mqttHandler, QObject *parent = nullptr);
+    ~FilePublisher();
+
+    /**
+     * @brief Start publishing a file, or every file in a directory to a subtopic named by its relative path
+     * @param topic to publish to
+     * @param path to a file or directory
+     * @param qos is quality of service of published messages
+     * @param retained is true when the broker should retain published messages
+     * @param chunkSize is size of chunk messages in bytes, 0 publishes every file as a single message
+     */
+    void run(QString topic, QString path, int qos, bool retained, qint64 chunkSize);
+
+    /**
+     * @brief Stop publishing and wait until the worker finishes
+     */
+    void stop();
+
+    /**
+     * @brief Get MQTT handler used for publishing
+     * @return MQTT handler
+     */
+    MqttHandler *getMqttHandler();
+
+    /**
+     * @brief Get status of file publisher
+     * @return true when publishing is in progress, otherwise false
+     */
+    bool isRunning();
+
+signals:
+    /**
+     * @brief Emitted when part of the data was handed to the client
+     * @param bytesPublished so far
+     * @param bytesTotal to publish
+     */
+    void progress(qint64 bytesPublished, qint64 bytesTotal);
+
+    /**
+     * @brief Emitted when publishing ends
+     * @param error description, empty on success
+     */
+    void finished(QString error);
+
+private:
+    /**
+     * @brief MQTT handler used for publishing
+     */
+    MqttHandler *mqttHandler;
+
+    /**
+     * @brief Worker publishing the files
+     */
+    QFuture<void> worker;
+
+    /**
+     * @brief Status of file publisher (is running or not)
+     */
+    std::atomic<bool> running;
+
+    /**
+     * @brief Publishing logic
+     */
+    void _run(QString topic, QString path, int qos, bool retained, qint64 chunkSize);
+
+    /**
+     * @brief Publish single file through a memory mapping
+     * @param topic to publish to
+     * @param filePath of the file
+     * @param qos is quality of service of published messages
+     * @param retained is true when the broker should retain published messages
+     * @param chunkSize is size of chunk messages in bytes, 0 publishes the file as a single message
+     * @param bytesPublished is increased by the size of published data
+     * @param bytesTotal to publish
+     * @return error description, empty on success
+     */
+    QString publishFile(QString topic, QString filePath, int qos, bool retained, qint64 chunkSize, qint64 &bytesPublished, qint64 bytesTotal);
+
+    /**
+     * @brief Block until the handler has room for another message, keeps memory bounded
+     * @return false when publishing was stopped in the meantime
+     */
+    bool waitForRoom();
+};
+
+#endif // FILEPUBLISHER_H
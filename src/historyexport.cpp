@@ -0,0 +1,421 @@
+/**
+ * @file historyexport.cpp
+ * @brief Implementation of streaming export of captured history to CSV and columnar files
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "historyexport.h"
+#include "trace.h"
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * @brief Magic bytes at the beginning of columnar export files
+ */
+static const char EXPORT_MAGIC[8] = { 'I', 'C', 'P', 'C', 'O', 'L', 'S', '1' };
+
+/**
+ * @brief Value of byteOrder in the header
+ */
+const quint32 EXPORT_BYTE_ORDER = 0x01020304;
+
+/**
+ * @brief Version of the columnar format
+ */
+const quint32 EXPORT_VERSION = 1;
+
+/**
+ * @brief Size of CSV text buffered before it is written
+ */
+const int EXPORT_BUFFER_BYTES = 1024 * 1024;
+
+/**
+ * @brief Maximum number of rows of a row group
+ */
+const int EXPORT_GROUP_ROWS = 65536;
+
+/**
+ * @brief Size of payloads after which a row group is written even when it has fewer rows
+ */
+const int EXPORT_GROUP_BYTES = 8 * 1024 * 1024;
+
+
+/**
+ * @brief Append CSV field, quoted when it contains separators, quotes or line breaks
+ * @param buffer to append to
+ * @param field to append
+ */
+static void appendCsvField(QByteArray &buffer, const QByteArray &field)
+{
+    bool quote = false;
+    for (auto c : field)
+    {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r')
+        {
+            quote = true;
+            break;
+        }
+    }
+
+    if (!quote)
+    {
+        buffer.append(field);
+        return;
+    }
+
+    buffer.append('"');
+    for (auto c : field)
+    {
+        if (c == '"')
+            buffer.append('"');
+        buffer.append(c);
+    }
+    buffer.append('"');
+}
+
+
+/**
+ * @brief Append zero bytes so the length of the data is a multiple of 8
+ * @param data to pad
+ */
+static void pad(QByteArray &data)
+{
+    while (data.size() % 8 != 0)
+        data.append('\0');
+}
+
+
+/**
+ * @brief Append raw bytes of a vector
+ * @param data to append to
+ * @param values to append
+ */
+template<typename T>
+static void appendColumn(QByteArray &data, const QVector<T> &values)
+{
+    data.append(reinterpret_cast<const char *>(values.constData()), values.size() * static_cast<int>(sizeof(T)));
+    pad(data);
+}
+
+
+/**
+ * @brief Writer of rows to one of the export formats
+ */
+class ExportWriter
+{
+public:
+    ExportWriter(QSaveFile &file) : file(file) {}
+    virtual ~ExportWriter() {}
+
+    /**
+     * @brief Write everything before the first row
+     * @param content of the rows
+     * @param topics are names of topics
+     * @param fields are names of fields
+     */
+    virtual void begin(ExportContent content, const QStringList &topics, const QStringList &fields) = 0;
+
+    /**
+     * @brief Add row with a payload
+     */
+    virtual void addPayload(qint64 timestamp, int topic, const std::string &payload, bool text) = 0;
+
+    /**
+     * @brief Add row with a field value
+     */
+    virtual void addValue(qint64 timestamp, int topic, int field, double value) = 0;
+
+    /**
+     * @brief Write rows that are still buffered
+     */
+    virtual void finish() = 0;
+
+protected:
+    QSaveFile &file;
+};
+
+
+class CsvWriter : public ExportWriter
+{
+public:
+    CsvWriter(QSaveFile &file) : ExportWriter(file) {}
+
+    void begin(ExportContent content, const QStringList &topics, const QStringList &fields) override
+    {
+        for (auto &topic : topics)
+            topicNames.append(topic.toUtf8());
+        for (auto &field : fields)
+            fieldNames.append(field.toUtf8());
+
+        if (content == ExportContent::Payloads)
+            buffer.append("timestamp,topic,encoding,payload\n");
+        else
+            buffer.append("timestamp,topic,field,value\n");
+    }
+
+    void addPayload(qint64 timestamp, int topic, const std::string &payload, bool text) override
+    {
+        buffer.append(QByteArray::number(timestamp)).append(',');
+        appendCsvField(buffer, topicNames.at(topic));
+
+        // Binary payloads would break the file, they are written in base64
+        QByteArray data = QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length()));
+        if (text)
+        {
+            buffer.append(",text,");
+            appendCsvField(buffer, data);
+        }
+        else
+        {
+            buffer.append(",base64,");
+            buffer.append(data.toBase64());
+        }
+        buffer.append('\n');
+
+        flush(false);
+    }
+
+    void addValue(qint64 timestamp, int topic, int field, double value) override
+    {
+        buffer.append(QByteArray::number(timestamp)).append(',');
+        appendCsvField(buffer, topicNames.at(topic));
+        buffer.append(',');
+        appendCsvField(buffer, fieldNames.at(field));
+        buffer.append(',').append(QByteArray::number(value, 'g', 17)).append('\n');
+
+        flush(false);
+    }
+
+    void finish() override { flush(true); }
+
+private:
+    QList<QByteArray> topicNames;
+    QList<QByteArray> fieldNames;
+    QByteArray buffer;
+
+    void flush(bool force)
+    {
+        if (!force && buffer.size() < EXPORT_BUFFER_BYTES)
+            return;
+
+        file.write(buffer);
+        buffer.clear();
+    }
+};
+
+
+class ColumnarWriter : public ExportWriter
+{
+public:
+    ColumnarWriter(QSaveFile &file) : ExportWriter(file) {}
+
+    void begin(ExportContent content, const QStringList &topics, const QStringList &fields) override
+    {
+        ExportHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+        header.byteOrder = EXPORT_BYTE_ORDER;
+        header.version = EXPORT_VERSION;
+        header.content = static_cast<quint32>(content);
+        header.topicCount = static_cast<quint32>(topics.length());
+        header.fieldCount = static_cast<quint32>(fields.length());
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        QByteArray names;
+        for (auto &name : topics + fields)
+        {
+            auto utf8 = name.toUtf8();
+            auto length = static_cast<quint32>(utf8.size());
+            names.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            names.append(utf8);
+        }
+        pad(names);
+        file.write(names);
+
+        offsets.append(0);
+    }
+
+    void addPayload(qint64 timestamp, int topic, const std::string &payload, bool) override
+    {
+        timestamps.append(timestamp);
+        topics.append(static_cast<quint32>(topic));
+        payloads.append(payload.data(), static_cast<int>(payload.length()));
+        offsets.append(static_cast<quint64>(payloads.size()));
+
+        if (timestamps.size() >= EXPORT_GROUP_ROWS || payloads.size() >= EXPORT_GROUP_BYTES)
+            writeGroup();
+    }
+
+    void addValue(qint64 timestamp, int topic, int field, double value) override
+    {
+        timestamps.append(timestamp);
+        topics.append(static_cast<quint32>(topic));
+        fields.append(static_cast<quint32>(field));
+        values.append(value);
+
+        if (timestamps.size() >= EXPORT_GROUP_ROWS)
+            writeGroup();
+    }
+
+    void finish() override { writeGroup(); }
+
+private:
+    QVector<qint64> timestamps;
+    QVector<quint32> topics;
+    QVector<quint64> offsets;
+    QByteArray payloads;
+    QVector<quint32> fields;
+    QVector<double> values;
+
+    void writeGroup()
+    {
+        if (timestamps.isEmpty())
+            return;
+
+        QByteArray columns;
+        appendColumn(columns, timestamps);
+        appendColumn(columns, topics);
+        if (values.isEmpty())
+        {
+            appendColumn(columns, offsets);
+            columns.append(payloads);
+            pad(columns);
+        }
+        else
+        {
+            appendColumn(columns, fields);
+            appendColumn(columns, values);
+        }
+
+        ExportGroupHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.rowCount = static_cast<quint32>(timestamps.size());
+        header.length = static_cast<quint64>(columns.size());
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(columns);
+
+        timestamps.clear();
+        topics.clear();
+        payloads.clear();
+        fields.clear();
+        values.clear();
+        offsets.clear();
+        offsets.append(0);
+    }
+};
+
+
+HistoryExport::HistoryExport(ExportContent content) : content(content) {}
+
+
+ExportContent HistoryExport::getContent() const { return content; }
+
+
+void HistoryExport::addMessages(QString topic, QVector<qint64> timestamps, QVector<std::shared_ptr<PayloadHandle>> payloads, QVector<bool> texts)
+{
+    if (timestamps.isEmpty())
+        return;
+
+    Stream stream;
+    stream.topic = indexOf(topics, topicIndices, topic);
+    stream.timestamps = timestamps;
+    stream.payloads = payloads;
+    stream.texts = texts;
+
+    rowCount += timestamps.size();
+    streams.append(stream);
+}
+
+
+void HistoryExport::addSamples(QString topic, QString field, QVector<qint64> timestamps, QVector<double> values)
+{
+    if (timestamps.isEmpty())
+        return;
+
+    Stream stream;
+    stream.topic = indexOf(topics, topicIndices, topic);
+    stream.field = indexOf(fields, fieldIndices, field);
+    stream.timestamps = timestamps;
+    stream.values = values;
+
+    rowCount += timestamps.size();
+    streams.append(stream);
+}
+
+
+qint64 HistoryExport::getRowCount() const { return rowCount; }
+
+
+QString HistoryExport::save(QString path, ExportFormat format, QAtomicInteger<qint64> *written) const
+{
+    TRACE_SCOPE("export write");
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return file.errorString();
+
+    std::unique_ptr<ExportWriter> writer;
+    if (format == ExportFormat::Csv)
+        writer.reset(new CsvWriter(file));
+    else
+        writer.reset(new ColumnarWriter(file));
+
+    writer->begin(content, topics, content == ExportContent::Fields ? fields : QStringList());
+
+    // Every stream is ordered by time, so rows are merged from the heads of the streams
+    typedef QPair<qint64, int> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    QVector<int> positions(streams.length(), 0);
+
+    for (int i = 0; i < streams.length(); i++)
+        heads.push(qMakePair(streams.at(i).timestamps.first(), i));
+
+    qint64 rows = 0;
+    while (!heads.empty())
+    {
+        auto index = heads.top().second;
+        heads.pop();
+
+        auto &stream = streams.at(index);
+        auto position = positions[index]++;
+
+        if (content == ExportContent::Payloads)
+            writer->addPayload(stream.timestamps.at(position), stream.topic, *stream.payloads.at(position)->get(), stream.texts.at(position));
+        else
+            writer->addValue(stream.timestamps.at(position), stream.topic, stream.field, stream.values.at(position));
+
+        if (position + 1 < stream.timestamps.size())
+            heads.push(qMakePair(stream.timestamps.at(position + 1), index));
+
+        if (++rows % 4096 == 0 && written != nullptr)
+            written->store(rows);
+    }
+
+    writer->finish();
+    if (written != nullptr)
+        written->store(rows);
+
+    if (!file.commit())
+        return file.errorString();
+
+    return QString();
+}
+
+
+int HistoryExport::indexOf(QStringList &names, QHash<QString, int> &indices, const QString &name)
+{
+    auto found = indices.constFind(name);
+    if (found != indices.constEnd())
+        return found.value();
+
+    indices.insert(name, names.length());
+    names.append(name);
+
+    return names.length() - 1;
+}
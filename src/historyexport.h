@@ -0,0 +1,160 @@
+/**
+ * @file historyexport.h
+ * @brief Header file for streaming export of captured history to CSV and columnar files
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef HISTORYEXPORT_H
+#define HISTORYEXPORT_H
+
+#include "payloadstore.h"
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+
+// Columnar file layout: header, topic names, field names and row groups until the end of the file. Names are
+// a 32 bit length followed by UTF-8 bytes. Every row group starts with ExportGroupHeader and holds columns of its
+// rows one after another, each padded to 8 bytes:
+//   payloads: int64 timestamps[rows], uint32 topics[rows], uint64 offsets[rows + 1], payload bytes
+//   fields:   int64 timestamps[rows], uint32 topics[rows], uint32 fields[rows], float64 values[rows]
+// Numbers are in the byte order of the machine that wrote the file, given by byteOrder. Rows are ordered by time.
+
+/**
+ * @brief Header of a columnar export file
+ */
+struct ExportHeader
+{
+    char magic[8];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 content;
+    quint32 topicCount;
+    quint32 fieldCount;
+    quint32 reserved;
+};
+
+/**
+ * @brief Header of a row group of a columnar export file
+ */
+struct ExportGroupHeader
+{
+    quint32 rowCount;
+    quint32 reserved;
+
+    /**
+     * @brief Length of the columns following the header
+     */
+    quint64 length;
+};
+
+/**
+ * @brief What rows of an export hold
+ */
+enum class ExportContent : quint32
+{
+    Payloads,   ///< Timestamp, topic and payload of every message in history
+    Fields      ///< Timestamp, topic, field and value of every numeric sample
+};
+
+/**
+ * @brief Format of an export file
+ */
+enum class ExportFormat
+{
+    Csv,
+    Columnar
+};
+
+class HistoryExport
+{
+public:
+    /**
+     * @brief History collected from the topics tree, written to a file in the background with bounded memory,
+     * payloads are shared with the history instead of being copied
+     * @param content of the rows
+     */
+    HistoryExport(ExportContent content);
+
+    /**
+     * @brief Get content of the rows
+     * @return content
+     */
+    ExportContent getContent() const;
+
+    /**
+     * @brief Add messages of a topic, used for payload exports
+     * @param topic is the full topic including connection
+     * @param timestamps of the messages, oldest first
+     * @param payloads of the messages
+     * @param texts tell for every message whether its payload was classified as text, others are written in base64 to CSV
+     */
+    void addMessages(QString topic, QVector<qint64> timestamps, QVector<std::shared_ptr<PayloadHandle>> payloads, QVector<bool> texts);
+
+    /**
+     * @brief Add samples of a field of a topic, used for field exports
+     * @param topic is the full topic including connection
+     * @param field is path of the JSON field, empty for plain number payloads
+     * @param timestamps of the samples, oldest first
+     * @param values of the samples
+     */
+    void addSamples(QString topic, QString field, QVector<qint64> timestamps, QVector<double> values);
+
+    /**
+     * @brief Get number of rows
+     * @return number of rows
+     */
+    qint64 getRowCount() const;
+
+    /**
+     * @brief Write rows of all topics merged by time, runs on a background thread
+     * @param path of the file, replaced once it is written completely
+     * @param format of the file
+     * @param written is set to number of rows written so far, used to show progress
+     * @return empty string on success, otherwise description of the error
+     */
+    QString save(QString path, ExportFormat format, QAtomicInteger<qint64> *written) const;
+
+private:
+    /**
+     * @brief Rows of one topic (payloads) or one field of a topic (fields), oldest first
+     */
+    struct Stream
+    {
+        int topic = 0;
+        int field = 0;
+        QVector<qint64> timestamps;
+        QVector<std::shared_ptr<PayloadHandle>> payloads;
+        QVector<bool> texts;
+        QVector<double> values;
+    };
+
+    ExportContent content;
+    QStringList topics;
+    QStringList fields;
+
+    /**
+     * @brief Indices of topics and fields by name
+     */
+    QHash<QString, int> topicIndices;
+    QHash<QString, int> fieldIndices;
+
+    QList<Stream> streams;
+    qint64 rowCount = 0;
+
+    /**
+     * @brief Get index of a name, the name is added when missing
+     * @param names in order of their indices
+     * @param indices of the names
+     * @param name to find
+     * @return index
+     */
+    static int indexOf(QStringList &names, QHash<QString, int> &indices, const QString &name);
+};
+
+#endif // HISTORYEXPORT_H
@@ -0,0 +1,354 @@
+/**
+ * @file ingestqueue.cpp
+ * @brief Implementation of queue of received messages applying per-topic ingest policies
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "ingestqueue.h"
+#include "trace.h"
+
+#include <QSet>
+
+/**
+ * @brief Number of messages taken from a lane before the next lane gets its turn
+ */
+const int LANE_QUANTUM = 32;
+
+
+QString IngestPolicy::describe() const
+{
+    switch (kind)
+    {
+        case Kind::KeepAll:
+            return "all";
+        case Kind::Latest:
+            return "latest";
+        case Kind::Every:
+            return QString("every:%1").arg(parameter);
+        case Kind::Interval:
+            return QString("interval:%1").arg(parameter);
+        case Kind::DropOldest:
+            return QString("drop-oldest:%1").arg(parameter);
+    }
+
+    return QString();
+}
+
+
+IngestQueue::IngestQueue()
+{
+    setRules(QList<QPair<TopicFilter, IngestPolicy>>());
+}
+
+
+IngestQueue::~IngestQueue()
+{
+    for (auto &lane : lanes)
+    {
+        for (auto &queued : lane.queue)
+            delete queued.message;
+        for (auto &queued : lane.latest)
+            delete queued.message;
+    }
+}
+
+
+QString IngestQueue::parseRules(QString text, QList<QPair<TopicFilter, IngestPolicy>> &rules)
+{
+    rules.clear();
+
+    for (auto &rule : text.split(";"))
+    {
+        if (rule.trimmed().isEmpty())
+            continue;
+
+        auto parts = rule.split("=");
+        if (parts.length() != 2)
+            return QString("Rule \"%1\" is not in format filter=policy.").arg(rule.trimmed());
+
+        auto filter = parts[0].trimmed();
+        if (!TopicFilter::isValid(filter))
+            return QString("Topic filter \"%1\" is not valid.").arg(filter);
+
+        auto policyParts = parts[1].trimmed().split(":");
+        auto name = policyParts[0].trimmed().toLower();
+
+        IngestPolicy policy;
+        if (name == "all")
+            policy.kind = IngestPolicy::Kind::KeepAll;
+        else if (name == "latest")
+            policy.kind = IngestPolicy::Kind::Latest;
+        else if (name == "every")
+            policy.kind = IngestPolicy::Kind::Every;
+        else if (name == "interval")
+            policy.kind = IngestPolicy::Kind::Interval;
+        else if (name == "drop-oldest")
+            policy.kind = IngestPolicy::Kind::DropOldest;
+        else
+            return QString("Policy \"%1\" is not known, use all, latest, every:N, interval:T or drop-oldest:N.").arg(parts[1].trimmed());
+
+        bool needsParameter = policy.kind == IngestPolicy::Kind::Every || policy.kind == IngestPolicy::Kind::Interval
+                || policy.kind == IngestPolicy::Kind::DropOldest;
+        if (needsParameter != (policyParts.length() == 2) || policyParts.length() > 2)
+            return QString("Policy \"%1\" has wrong number of parameters.").arg(parts[1].trimmed());
+
+        if (needsParameter)
+        {
+            bool ok;
+            policy.parameter = policyParts[1].trimmed().toInt(&ok);
+            if (!ok || policy.parameter <= 0)
+                return QString("Parameter of policy \"%1\" has to be a positive number.").arg(parts[1].trimmed());
+        }
+
+        rules.append(qMakePair(TopicFilter(filter), policy));
+    }
+
+    return QString();
+}
+
+
+void IngestQueue::setRules(QList<QPair<TopicFilter, IngestPolicy>> rules)
+{
+    QVector<Lane> newLanes;
+    for (auto &rule : rules)
+    {
+        Lane lane;
+        lane.filter = rule.first;
+        lane.policy = rule.second;
+        lane.statistics.filter = rule.first.getFilter();
+        lane.statistics.policy = rule.second.describe();
+        newLanes.append(lane);
+    }
+
+    Lane fallback;
+    fallback.statistics.policy = fallback.policy.describe();
+    newLanes.append(fallback);
+
+    QMutexLocker locker(&mutex);
+
+    // Messages queued under the old rules are processed, the order within every topic stays the same
+    auto &kept = newLanes.last();
+    for (auto &lane : lanes)
+    {
+        while (lane.statistics.pending > 0)
+        {
+            kept.queue.enqueue(pop(lane));
+            kept.statistics.pending++;
+            pendingCount++;
+        }
+    }
+
+    lanes = newLanes;
+    laneOfTopic.clear();
+    nextLane = 0;
+}
+
+
+void IngestQueue::enqueue(const QueuedMessage &queued)
+{
+    QMutexLocker locker(&mutex);
+    add(queued);
+}
+
+
+void IngestQueue::enqueue(const QList<QueuedMessage> &batch)
+{
+    TRACE_SCOPE("ingest policies");
+
+    QMutexLocker locker(&mutex);
+    for (auto &queued : batch)
+        add(queued);
+}
+
+
+void IngestQueue::add(const QueuedMessage &queued)
+{
+    auto message = queued.message;
+    auto &lane = lanes[findLane(queued.topic)];
+    lane.statistics.received++;
+
+    TopicKey key(queued.connection, queued.topic);
+    switch (lane.policy.kind)
+    {
+        case IngestPolicy::Kind::KeepAll:
+            break;
+
+        case IngestPolicy::Kind::Latest:
+        {
+            auto found = lane.latest.find(key);
+            if (found != lane.latest.end())
+            {
+                delete found.value().message;
+                found.value() = queued;
+                lane.statistics.conflated++;
+                return;
+            }
+
+            lane.latest.insert(key, queued);
+            lane.order.enqueue(key);
+            lane.statistics.pending++;
+            pendingCount++;
+            return;
+        }
+
+        case IngestPolicy::Kind::Every:
+        {
+            auto &count = lane.sampling[key];
+            if (count++ % lane.policy.parameter != 0)
+            {
+                delete message;
+                lane.statistics.sampledOut++;
+                return;
+            }
+            break;
+        }
+
+        case IngestPolicy::Kind::Interval:
+        {
+            auto found = lane.sampling.find(key);
+            if (found != lane.sampling.end() && message->getTimestamp() - found.value() < lane.policy.parameter)
+            {
+                delete message;
+                lane.statistics.sampledOut++;
+                return;
+            }
+
+            lane.sampling.insert(key, message->getTimestamp());
+            break;
+        }
+
+        case IngestPolicy::Kind::DropOldest:
+        {
+            if (lane.queue.size() >= lane.policy.parameter)
+            {
+                delete lane.queue.dequeue().message;
+                lane.statistics.droppedOldest++;
+                lane.statistics.pending--;
+                pendingCount--;
+            }
+            break;
+        }
+    }
+
+    lane.queue.enqueue(queued);
+    lane.statistics.pending++;
+    pendingCount++;
+}
+
+
+QList<QueuedMessage> IngestQueue::take(int count)
+{
+    QList<QueuedMessage> taken;
+
+    QMutexLocker locker(&mutex);
+
+    while (taken.size() < count && pendingCount > 0)
+    {
+        auto &lane = lanes[nextLane];
+        for (int i = 0; i < LANE_QUANTUM && taken.size() < count && lane.statistics.pending > 0; i++)
+        {
+            taken.append(pop(lane));
+            lane.statistics.processed++;
+        }
+
+        nextLane = (nextLane + 1) % lanes.size();
+    }
+
+    return taken;
+}
+
+
+void IngestQueue::removeSubtrees(const QList<QPair<QString, QString>> &subtrees)
+{
+    QHash<QString, QSet<QString>> removed;
+    QSet<QString> removedTopics;
+    for (auto &subtree : subtrees)
+    {
+        removed[subtree.first].insert(subtree.second);
+        removedTopics.insert(subtree.second);
+    }
+
+    QMutexLocker locker(&mutex);
+
+    for (auto &lane : lanes)
+    {
+        for (auto it = lane.sampling.begin(); it != lane.sampling.end();)
+        {
+            auto &key = it.key();
+            if (TopicFilter::isInSubtree(key.second, removed.value(key.first)))
+                it = lane.sampling.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // Lanes don't depend on the connection, the topic is matched again if another connection still has it
+    for (auto it = laneOfTopic.begin(); it != laneOfTopic.end();)
+    {
+        if (TopicFilter::isInSubtree(it.key(), removedTopics))
+            it = laneOfTopic.erase(it);
+        else
+            ++it;
+    }
+}
+
+
+int IngestQueue::size()
+{
+    QMutexLocker locker(&mutex);
+    return pendingCount;
+}
+
+
+QList<IngestStatistics> IngestQueue::getStatistics()
+{
+    QList<IngestStatistics> result;
+
+    QMutexLocker locker(&mutex);
+    for (auto &lane : lanes)
+        result.append(lane.statistics);
+
+    return result;
+}
+
+
+int IngestQueue::findLane(const QString &topic)
+{
+    auto found = laneOfTopic.constFind(topic);
+    if (found != laneOfTopic.constEnd())
+        return found.value();
+
+    int index = lanes.size() - 1;
+    auto levels = topic.split("/");
+    for (int i = 0; i < lanes.size() - 1; i++)
+    {
+        if (lanes.at(i).filter.matches(levels))
+        {
+            index = i;
+            break;
+        }
+    }
+
+    laneOfTopic.insert(topic, index);
+    return index;
+}
+
+
+QueuedMessage IngestQueue::pop(Lane &lane)
+{
+    QueuedMessage queued;
+
+    if (lane.policy.kind == IngestPolicy::Kind::Latest)
+    {
+        auto key = lane.order.dequeue();
+        queued = lane.latest.take(key);
+    }
+    else
+        queued = lane.queue.dequeue();
+
+    lane.statistics.pending--;
+    pendingCount--;
+
+    return queued;
+}
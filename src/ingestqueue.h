@@ -0,0 +1,254 @@
+/**
+ * @file ingestqueue.h
+ * @brief Header file for queue of received messages applying per-topic ingest policies
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef INGESTQUEUE_H
+#define INGESTQUEUE_H
+
+#include "message.h"
+#include "topicfilter.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QQueue>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief What happens to messages of a topic before they are processed
+ */
+struct IngestPolicy
+{
+    enum class Kind
+    {
+        KeepAll,    ///< Every message is processed
+        Latest,     ///< Only the latest queued message of a topic is processed
+        Every,      ///< Every Nth message of a topic is processed
+        Interval,   ///< At most one message of a topic per T milliseconds is processed
+        DropOldest  ///< At most N messages are queued, the oldest are dropped
+    };
+
+    Kind kind = Kind::KeepAll;
+
+    /**
+     * @brief N for Every and DropOldest, T for Interval
+     */
+    int parameter = 0;
+
+    /**
+     * @brief Get the policy in the form it is written in rules
+     * @return policy, e.g. "every:10"
+     */
+    QString describe() const;
+};
+
+/**
+ * @brief Message waiting to be processed
+ */
+struct QueuedMessage
+{
+    QString connection;
+    QString topic;
+    Message *message = nullptr;
+
+    /**
+     * @brief Time the message was received in nanoseconds of the trace clock
+     */
+    qint64 arrived = 0;
+
+    /**
+     * @brief Levels of the topic, filled in when the message is prepared
+     */
+    QStringList topicPath;
+
+    /**
+     * @brief Numeric values extracted from the payload when the message is prepared
+     */
+    QList<QPair<QString, double>> samples;
+};
+
+/**
+ * @brief Counters of one policy
+ */
+struct IngestStatistics
+{
+    /**
+     * @brief Topic filter of the rule, empty for topics no rule matches
+     */
+    QString filter;
+
+    /**
+     * @brief Policy of the rule
+     */
+    QString policy;
+
+    quint64 received = 0;
+    quint64 processed = 0;
+
+    /**
+     * @brief Messages replaced by a newer message of the same topic
+     */
+    quint64 conflated = 0;
+
+    /**
+     * @brief Messages skipped by sampling
+     */
+    quint64 sampledOut = 0;
+
+    /**
+     * @brief Messages dropped because the queue was full
+     */
+    quint64 droppedOldest = 0;
+
+    /**
+     * @brief Messages waiting to be processed
+     */
+    int pending = 0;
+};
+
+class IngestQueue
+{
+public:
+    /**
+     * @brief Queue between the MQTT client threads and the GUI thread, policies are applied when messages are queued
+     */
+    IngestQueue();
+    ~IngestQueue();
+
+    /**
+     * @brief Parse policy rules in format "filter=policy;filter=policy", policies are all, latest, every:N, interval:T and drop-oldest:N
+     * @param text of the rules
+     * @param rules parsed rules
+     * @return empty string on success, otherwise description of the error
+     */
+    static QString parseRules(QString text, QList<QPair<TopicFilter, IngestPolicy>> &rules);
+
+    /**
+     * @brief Set policy rules, the first matching rule applies and topics no rule matches keep all messages
+     * @param rules to apply
+     */
+    void setRules(QList<QPair<TopicFilter, IngestPolicy>> rules);
+
+    /**
+     * @brief Queue message or drop it according to the policy of its topic, the queue takes ownership of the message
+     * @param queued message with its connection and topic
+     */
+    void enqueue(const QueuedMessage &queued);
+
+    /**
+     * @brief Queue messages under one lock, policies are applied to every message
+     * @param batch of messages in order of arrival within each topic
+     */
+    void enqueue(const QList<QueuedMessage> &batch);
+
+    /**
+     * @brief Take messages to process, policies take turns so a flooded policy doesn't delay the others
+     * @param count is maximum number of messages
+     * @return messages in order of arrival within each topic, ownership is passed to the caller
+     */
+    QList<QueuedMessage> take(int count);
+
+    /**
+     * @brief Forget sampling state and lanes of topics that were removed from the tree, queued messages are kept
+     * @param subtrees are pairs of connection and topic, topics below them are removed as well
+     */
+    void removeSubtrees(const QList<QPair<QString, QString>> &subtrees);
+
+    /**
+     * @brief Get number of messages waiting to be processed
+     * @return number of messages
+     */
+    int size();
+
+    /**
+     * @brief Get counters of all policies
+     * @return counters, topics no rule matches last
+     */
+    QList<IngestStatistics> getStatistics();
+
+private:
+    /**
+     * @brief Topic of a connection
+     */
+    typedef QPair<QString, QString> TopicKey;
+
+    /**
+     * @brief Messages of topics matching one rule
+     */
+    struct Lane
+    {
+        TopicFilter filter;
+        IngestPolicy policy;
+
+        /**
+         * @brief Queued messages, not used by Latest
+         */
+        QQueue<QueuedMessage> queue;
+
+        /**
+         * @brief Latest message of every queued topic and order of the topics, used by Latest
+         */
+        QHash<TopicKey, QueuedMessage> latest;
+        QQueue<TopicKey> order;
+
+        /**
+         * @brief Number of messages (Every) or time of the last processed message (Interval) of topics
+         */
+        QHash<TopicKey, qint64> sampling;
+
+        IngestStatistics statistics;
+    };
+
+    /**
+     * @brief Lanes of rules in order, the last one is for topics no rule matches
+     */
+    QVector<Lane> lanes;
+
+    /**
+     * @brief Lane of topics seen so far, so rules are matched once per topic
+     */
+    QHash<QString, int> laneOfTopic;
+
+    /**
+     * @brief Lane that is taken from first next time
+     */
+    int nextLane = 0;
+
+    /**
+     * @brief Number of queued messages in all lanes
+     */
+    int pendingCount = 0;
+
+    /**
+     * @brief Protects all members
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Find lane of a topic, mutex has to be locked
+     * @param topic to look up
+     * @return index of the lane
+     */
+    int findLane(const QString &topic);
+
+    /**
+     * @brief Queue message or drop it according to the policy of its topic, mutex has to be locked
+     * @param queued message
+     */
+    void add(const QueuedMessage &queued);
+
+    /**
+     * @brief Take the oldest message of a lane, mutex has to be locked
+     * @param lane that is not empty
+     * @return message
+     */
+    QueuedMessage pop(Lane &lane);
+};
+
+#endif // INGESTQUEUE_H
@@ -0,0 +1,130 @@
+/**
+ * @file ingestworkers.cpp
+ * @brief Implementation of pool of threads preparing received messages, sharded by topic
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "ingestworkers.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+
+/**
+ * @brief Number of messages a thread prepares before delivering them
+ */
+const int WORKER_BATCH_MESSAGES = 256;
+
+
+IngestWorkers::IngestWorkers(std::function<void(QueuedMessage &)> prepare, std::function<void(const QList<QueuedMessage> &)> deliver,
+                             int threadCount)
+    : prepare(prepare), deliver(deliver)
+{
+    QWriteLocker locker(&shardsLock);
+    start(threadCount);
+}
+
+
+IngestWorkers::~IngestWorkers()
+{
+    QWriteLocker locker(&shardsLock);
+    stop();
+}
+
+
+void IngestWorkers::submit(const QueuedMessage &queued)
+{
+    QReadLocker locker(&shardsLock);
+
+    auto hash = qHash(queued.topic, qHash(queued.connection));
+    auto shard = shards.at(static_cast<int>(hash % static_cast<uint>(shards.size())));
+
+    pending.fetchAndAddRelaxed(1);
+
+    QMutexLocker shardLocker(&shard->mutex);
+    shard->queue.enqueue(queued);
+
+    // The thread only waits when its queue is empty
+    if (shard->queue.size() == 1)
+        shard->wake.wakeOne();
+}
+
+
+void IngestWorkers::setThreadCount(int threadCount)
+{
+    QWriteLocker locker(&shardsLock);
+    if (std::max(1, threadCount) == shards.size())
+        return;
+
+    stop();
+    start(threadCount);
+}
+
+
+int IngestWorkers::getThreadCount()
+{
+    QReadLocker locker(&shardsLock);
+    return shards.size();
+}
+
+
+int IngestWorkers::size() { return pending.load(); }
+
+
+void IngestWorkers::start(int threadCount)
+{
+    threadCount = std::max(1, threadCount);
+    pool.setMaxThreadCount(threadCount);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        auto shard = new Shard;
+        shards.append(shard);
+        QtConcurrent::run(&pool, [this, shard]() { run(shard); });
+    }
+}
+
+
+void IngestWorkers::stop()
+{
+    for (auto shard : shards)
+    {
+        QMutexLocker locker(&shard->mutex);
+        shard->stopping = true;
+        shard->wake.wakeOne();
+    }
+
+    pool.waitForDone();
+
+    qDeleteAll(shards);
+    shards.clear();
+}
+
+
+void IngestWorkers::run(Shard *shard)
+{
+    QList<QueuedMessage> batch;
+
+    forever
+    {
+        {
+            QMutexLocker locker(&shard->mutex);
+            while (shard->queue.isEmpty() && !shard->stopping)
+                shard->wake.wait(&shard->mutex);
+
+            if (shard->queue.isEmpty())
+                return;
+
+            while (!shard->queue.isEmpty() && batch.size() < WORKER_BATCH_MESSAGES)
+                batch.append(shard->queue.dequeue());
+        }
+
+        for (auto &queued : batch)
+            prepare(queued);
+
+        // Delivering a whole batch takes the lock of the ingest queue once
+        deliver(batch);
+        pending.fetchAndSubRelaxed(batch.size());
+        batch.clear();
+    }
+}
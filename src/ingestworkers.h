@@ -0,0 +1,123 @@
+/**
+ * @file ingestworkers.h
+ * @brief Header file for pool of threads preparing received messages, sharded by topic
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef INGESTWORKERS_H
+#define INGESTWORKERS_H
+
+#include "ingestqueue.h"
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
+
+class IngestWorkers
+{
+public:
+    /**
+     * @brief Pool of threads between the MQTT client threads and the ingest queue. Every topic belongs to one shard
+     * and every shard to one thread, so messages of a topic are prepared and delivered in order of arrival while
+     * different topics are prepared in parallel.
+     * @param prepare is called on a worker thread for every message, has to be thread safe
+     * @param deliver is called on a worker thread with prepared messages, it takes ownership of them
+     * @param threadCount is number of threads (shards)
+     */
+    IngestWorkers(std::function<void(QueuedMessage &)> prepare, std::function<void(const QList<QueuedMessage> &)> deliver,
+                  int threadCount);
+
+    /**
+     * @brief Deliver messages that were submitted and stop the threads
+     */
+    ~IngestWorkers();
+
+    /**
+     * @brief Queue message for preparation, called on the MQTT client threads
+     * @param queued message with its connection and topic, ownership is taken over
+     */
+    void submit(const QueuedMessage &queued);
+
+    /**
+     * @brief Change number of threads, submitted messages are delivered first so no topic is reordered
+     * @param threadCount is number of threads (shards)
+     */
+    void setThreadCount(int threadCount);
+
+    /**
+     * @brief Get number of threads
+     * @return number of threads
+     */
+    int getThreadCount();
+
+    /**
+     * @brief Get number of messages submitted but not delivered yet
+     * @return number of messages
+     */
+    int size();
+
+private:
+    /**
+     * @brief Messages of topics handled by one thread
+     */
+    struct Shard
+    {
+        QMutex mutex;
+        QWaitCondition wake;
+        QQueue<QueuedMessage> queue;
+
+        /**
+         * @brief Set when the thread should stop once the queue is empty
+         */
+        bool stopping = false;
+    };
+
+    std::function<void(QueuedMessage &)> prepare;
+    std::function<void(const QList<QueuedMessage> &)> deliver;
+
+    /**
+     * @brief Shards, topics are assigned by hash
+     */
+    QVector<Shard *> shards;
+
+    /**
+     * @brief Protects shards while their number is changed, submitting only reads them
+     */
+    QReadWriteLock shardsLock;
+
+    /**
+     * @brief Runs one thread per shard
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Number of messages submitted but not delivered yet
+     */
+    QAtomicInt pending;
+
+    /**
+     * @brief Create shards and start their threads, shardsLock has to be locked for writing
+     * @param threadCount is number of shards
+     */
+    void start(int threadCount);
+
+    /**
+     * @brief Deliver messages of all shards, stop their threads and delete them, shardsLock has to be locked for writing
+     */
+    void stop();
+
+    /**
+     * @brief Prepare and deliver messages of a shard until it is stopped
+     * @param shard of the thread
+     */
+    void run(Shard *shard);
+};
+
+#endif // INGESTWORKERS_H
@@ -8,11 +8,19 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QDir>
+#include <QStandardPaths>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     MainWindow w;
+
+    // Topics tree of the previous run is shown right away and kept up to date live
+    auto dataDirectory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDirectory);
+    w.enableSnapshots(QString(dataDirectory).append("/snapshot.icp"));
+
     w.show();
     return a.exec();
 }
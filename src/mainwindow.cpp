@@ -8,43 +8,427 @@
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include <fstream>
+#include <algorithm>
 #include <limits>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMessageBox>
 #include <QtWidgets>
 #include <QSizePolicy>
-#include <QThread>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QRegularExpression>
 #include <QUrl>
+#include <QtConcurrent>
+
+/**
+ * @brief Number of newest messages of a topic whose payloads are never compressed
+ */
+const int HOT_MESSAGES = 4;
+
+/**
+ * @brief Number of payloads handed to the payload store at once to be compressed together
+ */
+const int COLD_BLOCK_MESSAGES = 16;
+
+/**
+ * @brief Interval of writing snapshots of the topics tree in milliseconds
+ */
+const int SNAPSHOT_INTERVAL = 60 * 1000;
+
+/**
+ * @brief Interval of processing queued messages in milliseconds
+ */
+const int INGEST_INTERVAL = 16;
+
+/**
+ * @brief Time one batch of queued messages may take in milliseconds, the rest waits for the next interval
+ */
+const int INGEST_BATCH_TIME = 8;
+
+/**
+ * @brief Number of messages taken from the queue at once
+ */
+const int INGEST_BATCH_MESSAGES = 256;
+
+/**
+ * @brief Interval of sweeps of expired topics in milliseconds
+ */
+const int EXPIRY_SWEEP_INTERVAL = 250;
+
+/**
+ * @brief Number of topics whose children one sweep checks
+ */
+const int EXPIRY_SWEEP_TOPICS = 4096;
+
+/**
+ * @brief Interval of checking alerts in milliseconds
+ */
+const int ALERT_INTERVAL = 250;
+
+/**
+ * @brief Number of alerts kept in the list, the oldest are removed
+ */
+const int ALERT_LIST_ITEMS = 500;
+
+
+/**
+ * @brief Get memory a message holds in the history of a topic
+ * @param message in the history
+ * @return memory of the message
+ */
+static TopicMemory messageMemory(Message *message)
+{
+    TopicMemory memory;
+    memory.payloadBytes = static_cast<qint64>(message->getPayloadLength());
+    memory.historyEntries = 1;
+    memory.overheadBytes = static_cast<qint64>(message->getOverhead() + sizeof(Message *));
+
+    return memory;
+}
+
+
+Topic::Topic(QString topic) : topic(topic)
+{
+    memory.overheadBytes = static_cast<qint64>(sizeof(Topic) + sizeof(Topic *) + topic.size() * sizeof(QChar));
+    subtreeMemory = memory;
+}
+
+
+Topic::Topic(const TopicSnapshot *snapshot, int index) : topic(snapshot->getName(index))
+{
+    auto &node = snapshot->getNode(index);
+
+    // Rollups of the whole subtree come from the snapshot, its topics are created later
+    statistics.messageCount = node.messageCount;
+    statistics.lastSeen = node.lastTimestamp;
+    subtreeStatistics.messageCount = snapshot->getSubtreeMessageCount(index);
+    subtreeStatistics.lastSeen = snapshot->getSubtreeLastTimestamp(index);
+
+    memory.overheadBytes = static_cast<qint64>(sizeof(Topic) + sizeof(Topic *) + topic.size() * sizeof(QChar));
+    if (node.hasPayload)
+    {
+        messages.append(new Message(snapshot->getPayload(index), node.lastTimestamp));
+        memory += messageMemory(messages.last());
+    }
+    subtreeMemory = memory;
+
+    if (node.childCount > 0)
+    {
+        this->snapshot = snapshot;
+        snapshotIndex = index;
+    }
+}
 
-Topic::Topic(QString topic) : topic(topic) {}
+
+Topic::~Topic()
+{
+    qDeleteAll(messages);
+    qDeleteAll(children);
+}
 
 
 QString Topic::getTopic() { return topic; }
 
 
-void Topic::addMessage(std::string message, int maxCount)
+void Topic::addMessage(Message *message, int maxCount)
 {
-    messages.append(new std::string(message));
+    auto timestamp = message->getTimestamp();
+    auto payloadSize = message->getPayloadLength();
+
+    statistics.add(timestamp, payloadSize);
+    for (auto topic = this; topic != nullptr; topic = topic->parent)
+        topic->subtreeStatistics.add(timestamp, payloadSize);
+
+    messages.append(message);
+    accountMemory(messageMemory(message));
 
     if (messages.length() > maxCount)
-        messages.removeFirst();
+        deleteOldestMessage();
+
+    // Payloads past the newest few are handed to the store once there are enough of them for a block
+    QList<Message *> cold;
+    for (int i = messages.length() - HOT_MESSAGES - 1; i >= 0; i--)
+    {
+        if (messages.at(i)->getPayloadHandle()->isSettled())
+            break;
+
+        cold.prepend(messages.at(i));
+    }
+
+    if (cold.length() < COLD_BLOCK_MESSAGES)
+        return;
+
+    // Images and other binary payloads are mostly compressed already, they stay hot
+    QList<std::shared_ptr<PayloadHandle>> compressible;
+    for (auto message : cold)
+    {
+        auto kind = message->getPayloadClass().kind;
+        if (kind == PayloadKind::Image || kind == PayloadKind::Binary)
+            PayloadStore::global().keepHot(message->getPayloadHandle());
+        else
+            compressible.append(message->getPayloadHandle());
+    }
+
+    PayloadStore::global().compressLater(compressible);
 }
 
 
-QList<std::string *> &Topic::getMessages(int maxCount)
+QList<Message *> &Topic::getMessages(int maxCount)
 {
     while (messages.length() > maxCount)
-        messages.removeFirst();
+        deleteOldestMessage();
 
     return messages;
 };
 
 
-void Topic::addChild(Topic *topic) { children.append(topic); }
+quint64 Topic::getMessageCount() { return statistics.messageCount; }
+
+
+const TopicStatistics &Topic::getStatistics() { return statistics; }
+
+
+const TopicStatistics &Topic::getSubtreeStatistics() { return subtreeStatistics; }
+
+
+const TopicMemory &Topic::getMemory() { return memory; }
+
+
+const TopicMemory &Topic::getSubtreeMemory() { return subtreeMemory; }
+
+
+bool Topic::hasMessage(quint64 messageId)
+{
+    for (int i = 0; i < messages.length(); i++)
+    {
+        if (messages.at(i)->getId() == messageId)
+            return true;
+    }
+
+    return false;
+}
+
+
+void Topic::addSample(QString field, qint64 timestamp, double value)
+{
+    auto &fieldSeries = series[field];
+
+    TopicMemory delta;
+    delta.seriesBytes = -static_cast<qint64>(fieldSeries.memoryUsage());
+    fieldSeries.append(timestamp, value);
+    delta.seriesBytes += static_cast<qint64>(fieldSeries.memoryUsage());
+
+    if (delta.seriesBytes != 0)
+        accountMemory(delta);
+}
+
+
+TimeSeries *Topic::getSeries(QString field)
+{
+    auto found = series.find(field);
+    if (found == series.end())
+        return nullptr;
+
+    return &found.value();
+}
+
+
+void Topic::setSeriesCapacity(QString field, int capacity)
+{
+    auto found = series.find(field);
+    if (found == series.end())
+        return;
+
+    TopicMemory delta;
+    delta.seriesBytes = -static_cast<qint64>(found.value().memoryUsage());
+    found.value().setCapacity(capacity);
+    delta.seriesBytes += static_cast<qint64>(found.value().memoryUsage());
+
+    if (delta.seriesBytes != 0)
+        accountMemory(delta);
+}
+
+
+QStringList Topic::getSeriesFields() { return series.keys(); }
+
+
+void Topic::addChild(Topic *topic)
+{
+    topic->parent = this;
+    children.append(topic);
+
+    for (auto ancestor = this; ancestor != nullptr; ancestor = ancestor->parent)
+        ancestor->subtreeMemory += topic->subtreeMemory;
+}
+
+
+QList<Topic *> &Topic::getChildren()
+{
+    materialize();
+    return children;
+}
+
+
+bool Topic::hasChildren() { return snapshot != nullptr || !children.isEmpty(); }
+
+
+QStringList Topic::getPath()
+{
+    QStringList path;
+    for (auto topic = this; topic != nullptr; topic = topic->parent)
+        path.prepend(topic->topic);
+
+    return path;
+}
+
+
+void Topic::sweepChildren(qint64 cutoff, QList<Topic *> &stale, QList<Topic *> &live)
+{
+    // Last seen time of a subtree is its newest message, so a subtree older than the cutoff has no live topic in it
+    for (int i = 0; i < children.length();)
+    {
+        if (children.at(i)->subtreeStatistics.lastSeen < cutoff)
+        {
+            for (auto ancestor = this; ancestor != nullptr; ancestor = ancestor->parent)
+            {
+                ancestor->subtreeMemory -= children.at(i)->subtreeMemory;
+                ancestor->subtreeStatistics.remove(children.at(i)->subtreeStatistics);
+            }
+
+            stale.append(children.takeAt(i));
+        }
+        else
+            live.append(children.at(i++));
+    }
+}
+
+
+void Topic::setTreeItem(QTreeWidgetItem *item) { treeItem = item; }
+
+
+QTreeWidgetItem *Topic::getTreeItem() { return treeItem; }
+
+
+double Topic::reportMemory(QString path, QList<MemoryReportEntry> &entries)
+{
+    MemoryReportEntry entry;
+    entry.path = path.isEmpty() ? topic : path + "/" + topic;
+    entry.own = memory;
+    entry.subtree = subtreeMemory;
+
+    // Payloads are deduplicated and compressed in the background, so only their handles know what they take now
+    double stored = 0;
+    for (auto message : messages)
+        stored += message->getPayloadHandle()->storedBytes();
+
+    auto index = entries.length();
+    entries.append(entry);
+
+    // Children still in the snapshot hold no memory
+    for (auto child : children)
+        stored += child->reportMemory(entry.path, entries);
+
+    entries[index].subtreeStoredPayloadBytes = static_cast<qint64>(stored);
+    return stored;
+}
+
+
+void Topic::exportHistory(QString path, HistoryExport &history)
+{
+    auto topicPath = path.isEmpty() ? topic : path + "/" + topic;
+
+    if (history.getContent() == ExportContent::Payloads)
+    {
+        QVector<qint64> timestamps;
+        QVector<std::shared_ptr<PayloadHandle>> payloads;
+        QVector<bool> texts;
+        timestamps.reserve(messages.length());
+        payloads.reserve(messages.length());
+        texts.reserve(messages.length());
+
+        for (auto message : messages)
+        {
+            timestamps.append(message->getTimestamp());
+            payloads.append(message->getPayloadHandle());
+            texts.append(message->getPayloadClass().isText());
+        }
+
+        history.addMessages(topicPath, timestamps, payloads, texts);
+    }
+    else
+    {
+        // Columns of the series are shared until the series changes
+        for (auto it = series.constBegin(); it != series.constEnd(); ++it)
+            history.addSamples(topicPath, it.key(), it.value().getTimestamps(), it.value().getValues());
+    }
+
+    for (auto child : children)
+        child->exportHistory(topicPath, history);
+
+    // Topics still in the snapshot only have their last payload and no series, so they are read from it directly
+    if (snapshot != nullptr && history.getContent() == ExportContent::Payloads)
+    {
+        auto &node = snapshot->getNode(snapshotIndex);
+        for (quint32 i = 0; i < node.childCount; i++)
+            exportSnapshot(snapshot, static_cast<int>(node.firstChild + i), topicPath, history);
+    }
+}
+
+
+void Topic::exportSnapshot(const TopicSnapshot *snapshot, int index, QString path, HistoryExport &history)
+{
+    auto &node = snapshot->getNode(index);
+    auto topicPath = path + "/" + snapshot->getName(index);
+
+    if (node.hasPayload)
+    {
+        // Not interned, the payload only lives until the export is written
+        auto payload = std::make_shared<const std::string>(snapshot->getPayload(index));
+        auto text = PayloadClassifier::classify(*payload).isText();
+
+        history.addMessages(topicPath, QVector<qint64>{node.lastTimestamp},
+                            QVector<std::shared_ptr<PayloadHandle>>{std::make_shared<PayloadHandle>(payload)}, QVector<bool>{text});
+    }
+
+    for (quint32 i = 0; i < node.childCount; i++)
+        exportSnapshot(snapshot, static_cast<int>(node.firstChild + i), topicPath, history);
+}
+
+
+void Topic::accountMemory(const TopicMemory &delta)
+{
+    memory += delta;
+    for (auto topic = this; topic != nullptr; topic = topic->parent)
+        topic->subtreeMemory += delta;
+}
 
 
-QList<Topic *> &Topic::getChildren() { return children; }
+void Topic::deleteOldestMessage()
+{
+    auto message = messages.takeFirst();
+
+    TopicMemory delta;
+    delta -= messageMemory(message);
+    accountMemory(delta);
+
+    delete message;
+}
+
+
+void Topic::materialize()
+{
+    if (snapshot == nullptr)
+        return;
+
+    auto &node = snapshot->getNode(snapshotIndex);
+    for (quint32 i = 0; i < node.childCount; i++)
+        addChild(new Topic(snapshot, static_cast<int>(node.firstChild + i)));
+
+    snapshot = nullptr;
+}
 
 
 Topic * Topic::findTopic(QStringList path)
@@ -61,6 +445,8 @@ Topic * Topic::findTopic(QStringList path)
     if (path[0] != this->topic)
         return nullptr;
 
+    materialize();
+
     path.removeFirst();
     for (int i = 0; i < children.length(); i++)
     {
@@ -74,15 +460,18 @@ Topic * Topic::findTopic(QStringList path)
 }
 
 
-Topic * Topic::addTopic(Topic *topic)
+Topic * Topic::addTopic(QStringList path)
 {
-    auto path = topic->topic.split("/");
+    if (path.length() == 0 || path[0] != this->topic)
+        return nullptr;
 
     path.removeFirst();
 
     auto currentNode = this;
     for (int i = 0; i < path.length(); i++)
     {
+        currentNode->materialize();
+
         bool found = false;
         for (int j = 0; j < currentNode->children.length(); j++)
         {
@@ -111,67 +500,462 @@ void Topic::exportToDisk(QDir directory)
     if (!directory.exists())
         directory.mkdir(directory.path());
 
-    QDir newDir(directory.path().append("/").append(topic));
+    // Connection roots may contain characters that are not allowed in directory names
+    auto directoryName = QString(topic).replace(QRegularExpression("[/\\\\:*?\"<>|]"), "_");
+    QDir newDir(directory.path().append("/").append(directoryName));
     if (!newDir.exists())
         newDir.mkdir(newDir.path());
 
     if (messages.length() > 0)
     {
-        auto lastMessage = messages.last();
+        auto lastPayload = messages.last()->getSharedPayload();
+        auto &lastMessage = *lastPayload;
 
         auto payloadPath = newDir.path();
 
-        // Figure out file type, only PNG and JPG is supported, everything else is just data in TXT
-        QPixmap dummyPixmap;
-        QByteArray data(lastMessage->data(), lastMessage->length());
-
-        if (dummyPixmap.loadFromData(data, "PNG"))
-            payloadPath.append("/payload.png");
-        else if (dummyPixmap.loadFromData(data, "JPG"))
-            payloadPath.append("/payload.jpg");
+        // File type comes from the class of the payload, everything that is not an image is just data in TXT
+        auto format = messages.last()->getPayloadClass().imageFormat;
+        if (format != nullptr)
+            payloadPath.append("/payload.").append(QString(format).toLower());
         else
             payloadPath.append("/payload.txt");
 
         // Write payload
         QFile payloadFile(payloadPath);
         payloadFile.open(QIODevice::WriteOnly);
-        payloadFile.write(lastMessage->data(), lastMessage->length());
+        payloadFile.write(lastMessage.data(), lastMessage.length());
         payloadFile.close();
     }
 
+    materialize();
     for (int i = 0; i < children.length(); i++)
     {
         children.at(i)->exportToDisk(newDir);
     }
 }
 
+
+void Topic::writeSnapshot(QList<Topic *> roots, SnapshotBuilder &builder)
+{
+    // Topic that was created, or a topic still in the previous snapshot
+    struct Source
+    {
+        Topic *topic;
+        const TopicSnapshot *snapshot;
+        int index;
+    };
+
+    // Index of a topic in the queue is its index in the new snapshot
+    QVector<Source> queue;
+    auto add = [&](Source source, int parent)
+    {
+        if (source.topic != nullptr)
+        {
+            auto topic = source.topic;
+
+            // Only the handle is taken, the payload is read when the file is written in the background
+            std::shared_ptr<PayloadHandle> payload;
+            qint64 timestamp = 0;
+            if (!topic->messages.isEmpty())
+            {
+                payload = topic->messages.last()->getPayloadHandle();
+                timestamp = topic->messages.last()->getTimestamp();
+            }
+
+            builder.addNode(topic->topic, parent, topic->statistics.messageCount, timestamp, payload);
+        }
+        else
+            builder.addNode(source.snapshot->getName(source.index), parent, source.snapshot, source.index);
+
+        queue.append(source);
+    };
+
+    for (int i = 0; i < roots.length(); i++)
+        add(Source{roots.at(i), nullptr, -1}, -1);
+
+    for (int i = 0; i < queue.size(); i++)
+    {
+        auto source = queue.at(i);
+        auto firstChild = builder.getNodeCount();
+
+        if (source.topic != nullptr && source.topic->snapshot == nullptr)
+        {
+            for (auto child : source.topic->children)
+                add(Source{child, nullptr, -1}, i);
+        }
+        else
+        {
+            // Subtrees nobody looked at are copied without creating their topics
+            auto snapshot = source.topic != nullptr ? source.topic->snapshot : source.snapshot;
+            auto index = source.topic != nullptr ? source.topic->snapshotIndex : source.index;
+
+            auto &node = snapshot->getNode(index);
+            for (quint32 j = 0; j < node.childCount; j++)
+                add(Source{nullptr, snapshot, static_cast<int>(node.firstChild + j)}, i);
+        }
+
+        builder.setChildren(i, firstChild, builder.getNodeCount() - firstChild);
+    }
+}
+
+
+TopicTreeItem::TopicTreeItem(QTreeWidget *view, Topic *topic) : QTreeWidgetItem(view), topic(topic)
+{
+    topic->setTreeItem(this);
+    setText(NameColumn, topic->getTopic());
+    if (topic->hasChildren())
+        setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+}
+
+
+TopicTreeItem::TopicTreeItem(QTreeWidgetItem *parent, Topic *topic) : QTreeWidgetItem(parent), topic(topic)
+{
+    topic->setTreeItem(this);
+    setText(NameColumn, topic->getTopic());
+
+    // Topic restored from the snapshot may have children that get their items once it is expanded
+    if (topic->hasChildren())
+        setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+}
+
+
+TopicTreeItem::~TopicTreeItem() { topic->setTreeItem(nullptr); }
+
+
+Topic *TopicTreeItem::getTopic() { return topic; }
+
+
+void TopicTreeItem::refresh(qint64 now)
+{
+    auto &statistics = topic->getSubtreeStatistics();
+    auto rate = statistics.getRate(now);
+
+    setColumn(MessagesColumn, QString::number(statistics.messageCount), statistics.messageCount);
+    setColumn(RateColumn, rate > 0 ? QString::number(rate, 'f', rate < 10 ? 2 : 0) : QString(), rate);
+
+    if (statistics.payloadCount > 0)
+    {
+        setColumn(PayloadMinColumn, QString::number(statistics.payloadMin), statistics.payloadMin);
+        setColumn(PayloadAverageColumn, QString::number(statistics.getPayloadAverage(), 'f', 0), statistics.getPayloadAverage());
+        setColumn(PayloadMaxColumn, QString::number(statistics.payloadMax), statistics.payloadMax);
+    }
+
+    if (statistics.lastSeen > 0)
+        setColumn(LastSeenColumn, QDateTime::fromMSecsSinceEpoch(statistics.lastSeen).toString("HH:mm:ss"), statistics.lastSeen);
+}
+
+
+bool TopicTreeItem::operator<(const QTreeWidgetItem &other) const
+{
+    auto column = treeWidget() != nullptr ? treeWidget()->sortColumn() : NameColumn;
+    if (column == NameColumn)
+        return QTreeWidgetItem::operator<(other);
+
+    return data(column, Qt::UserRole).toDouble() < other.data(column, Qt::UserRole).toDouble();
+}
+
+
+void TopicTreeItem::setColumn(int column, QString text, double key)
+{
+    // Unchanged data doesn't make the view sort again
+    setText(column, text);
+    setData(column, Qt::UserRole, key);
+}
+
 //-------------//
 // Main Window //
 //-------------//
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
-    , ui(new Ui::MainWindow), topicsTree()
+    , ui(new Ui::MainWindow)
+    , ingestWorkers([this](QueuedMessage &queued) { prepareMessage(queued); },
+                    [this](const QList<QueuedMessage> &batch) { ingestQueue.enqueue(batch); },
+                    QThread::idealThreadCount())
+    , topicsTree()
 {
     ui->setupUi(this);
 
     // Set validator for number of messages stored text field
     ui->numberOfMessagesTextField->setValidator(new QIntValidator(0, 100, this));
+
+    // Periodically show state of the publish pipeline
+    auto publishStatisticsTimer = new QTimer(this);
+    connect(publishStatisticsTimer, &QTimer::timeout, this, &MainWindow::refreshPublishStatistics);
+    connect(publishStatisticsTimer, &QTimer::timeout, this, &MainWindow::refreshIngestStatistics);
+    connect(publishStatisticsTimer, &QTimer::timeout, this, &MainWindow::refreshBridgeStatistics);
+    connect(publishStatisticsTimer, &QTimer::timeout, this, &MainWindow::refreshExportProgress);
+    connect(publishStatisticsTimer, &QTimer::timeout, this, &MainWindow::refreshTopicStatistics);
+
+    // Expired topics are removed a slice at a time so that the UI never stalls
+    expiryTimer = new QTimer(this);
+    connect(expiryTimer, &QTimer::timeout, this, &MainWindow::sweepExpiredTopics);
+
+    // Statistics columns are sorted numerically, topics are sorted by name until another column is chosen
+    ui->treeWidget->sortByColumn(TopicTreeItem::NameColumn, Qt::AscendingOrder);
+    publishStatisticsTimer->start(1000);
+
+    // Received messages are processed in batches on the GUI thread
+    auto ingestTimer = new QTimer(this);
+    connect(ingestTimer, &QTimer::timeout, this, &MainWindow::drainIngestQueue);
+    ingestTimer->start(INGEST_INTERVAL);
+
+    // Alerts of durations are raised by time passing, not only by messages
+    auto alertTimer = new QTimer(this);
+    connect(alertTimer, &QTimer::timeout, this, &MainWindow::checkAlerts);
+    alertTimer->start(ALERT_INTERVAL);
+
+    // Charts follow their series at up to 30 frames per second
+    auto chartTimer = new QTimer(this);
+    connect(chartTimer, &QTimer::timeout, this, &MainWindow::refreshCharts);
+    chartTimer->start(33);
+
+    connect(&regexSearch, &QFutureWatcher<SearchHit>::finished, this, &MainWindow::regexSearchFinished);
+    connect(&snapshotSave, &QFutureWatcher<QString>::finished, this, &MainWindow::snapshotSaveFinished);
+    connect(&historyExport, &QFutureWatcher<QString>::finished, this, &MainWindow::historyExportFinished);
+    connect(&traceSave, &QFutureWatcher<QString>::finished, this, &MainWindow::traceSaveFinished);
+
+    auto topicFinderShortcut = new QShortcut(QKeySequence("Ctrl+P"), this);
+    connect(topicFinderShortcut, &QShortcut::activated, this, [this]()
+    {
+        ui->tabWidget->setCurrentWidget(ui->explorer_tab);
+        ui->topicFinderTextField->setFocus();
+        ui->topicFinderTextField->selectAll();
+    });
 }
 
 MainWindow::~MainWindow()
 {
+    regexSearch.cancel();
+    regexSearch.waitForFinished();
+    // The export reports progress into a member of the window, it has to finish before the window is gone
+    historyExport.waitForFinished();
     if (simulator != nullptr)
         simulator->stop();
+    if (filePublisher != nullptr)
+    {
+        filePublisher->stop();
+        delete filePublisher;
+        filePublisher = nullptr;
+    }
+
+    // Client threads of the handlers call into the ingest workers, bridge and alerts, so they are stopped before those are destroyed
+    for (auto mqttHandler : mqttHandlers)
+        topicBridge.setTarget(mqttHandler->getName(), nullptr);
+    qDeleteAll(mqttHandlers);
+    mqttHandlers.clear();
+
+    // The last snapshot is written synchronously so that nothing received since the previous one is lost
+    snapshotIndexing.waitForFinished();
+    snapshotSave.waitForFinished();
+    if (!snapshotPath.isEmpty())
+        createSnapshot().save(snapshotPath);
+
     delete ui;
 }
 
 
-void MainWindow::newMessage(QString topic, std::string payload)
+void MainWindow::enableSnapshots(QString path)
 {
-    auto topicPath = topic.split(QString("/"));
-    if (topicPath.length() <= 0)
-        return;
+    snapshotPath = path;
+
+    // The restored snapshot stays mapped while new ones are saved and Windows can't replace a mapped file, so it is
+    // moved aside first. It is loaded from there again when no snapshot was saved since
+    auto restoredPath = path + ".restored";
+    if (QFile::exists(path))
+    {
+        QFile::remove(restoredPath);
+        QFile::rename(path, restoredPath);
+    }
+
+    auto loaded = new TopicSnapshot(QFile::exists(path) ? path : restoredPath);
+    if (!loaded->isValid() || !topicsTree.isEmpty())
+        delete loaded;
+    else
+    {
+        snapshot = loaded;
+
+        // Only roots are created now, other topics are created from the mapped file once they are expanded or receive a message
+        for (int i = 0; i < snapshot->getRootCount(); i++)
+        {
+            auto root = new Topic(snapshot, i);
+            topicsTree.append(root);
+
+            treeViewAddRootItem(root);
+        }
+
+        dashboardFromJson(snapshot->getDashboard());
+
+        // Topic finder gets the restored topics in the background, full paths are built from parents as nodes are stored breadth first
+        auto restored = snapshot;
+        snapshotIndexing = QtConcurrent::run([this, restored]()
+        {
+            auto count = restored->getNodeCount();
+            QVector<QString> paths(count);
+            QVector<QString> connections(count);
+            QList<QPair<QString, QString>> topics;
+
+            for (int i = 0; i < count; i++)
+            {
+                auto &node = restored->getNode(i);
+                if (i < restored->getRootCount())
+                {
+                    connections[i] = restored->getName(i);
+                    continue;
+                }
+
+                auto parent = static_cast<int>(node.parent);
+                auto name = restored->getName(i);
+                connections[i] = connections.at(parent);
+                paths[i] = paths.at(parent).isEmpty() ? name : QString(paths.at(parent)).append("/").append(name);
+
+                if (node.messageCount > 0)
+                    topics.append(qMakePair(connections.at(i), paths.at(i)));
+            }
+
+            topicFinder.addTopics(topics);
+        });
+    }
+
+    auto snapshotTimer = new QTimer(this);
+    connect(snapshotTimer, &QTimer::timeout, this, &MainWindow::saveSnapshot);
+    snapshotTimer->start(SNAPSHOT_INTERVAL);
+}
+
+
+SnapshotBuilder MainWindow::createSnapshot()
+{
+    SnapshotBuilder builder;
+    Topic::writeSnapshot(topicsTree, builder);
+    builder.setDashboard(dashboardToJson());
+
+    return builder;
+}
+
+
+void MainWindow::saveSnapshot()
+{
+    // Writes don't pile up when the disk is slow
+    if (snapshotPath.isEmpty() || snapshotSave.isRunning())
+        return;
+
+    // Only the tree structure is collected here, payloads are read and written in the background
+    auto builder = createSnapshot();
+    auto path = snapshotPath;
+    snapshotSave.setFuture(QtConcurrent::run([builder, path]() { return builder.save(path); }));
+}
+
+
+void MainWindow::snapshotSaveFinished()
+{
+    auto error = snapshotSave.result();
+    if (error.isEmpty())
+    {
+        snapshotFailed = false;
+        return;
+    }
+
+    // Every failure is shown in the status bar, a dialog tells about the first one so it isn't missed
+    ui->statusbar->showMessage(QString("Snapshot not saved: %1").arg(error), 10000);
+    if (!snapshotFailed)
+    {
+        snapshotFailed = true;
+        presentDialog("Snapshot not saved", QString("Snapshot could not be saved to %1: %2").arg(snapshotPath, error));
+    }
+}
+
+
+void MainWindow::newMessage(QString connection, QString topic, Message *message)
+{
+    QueuedMessage queued;
+    queued.connection = connection;
+    queued.topic = topic;
+    queued.message = message;
+    queued.arrived = Trace::now();
+
+    ingestWorkers.submit(queued);
+}
+
+
+int MainWindow::getQueuedMessageCount() { return ingestWorkers.size() + ingestQueue.size(); }
+
+
+void MainWindow::setIngestPolicies(QList<QPair<TopicFilter, IngestPolicy>> rules) { ingestQueue.setRules(rules); }
+
+
+QList<IngestStatistics> MainWindow::getIngestStatistics() { return ingestQueue.getStatistics(); }
+
+
+void MainWindow::setIngestThreadCount(int threadCount) { ingestWorkers.setThreadCount(threadCount); }
+
+
+int MainWindow::getIngestThreadCount() { return ingestWorkers.getThreadCount(); }
+
+
+void MainWindow::setInsertLatencies(QVector<qint64> *latencies) { insertLatencies = latencies; }
+
+
+void MainWindow::drainIngestQueue()
+{
+    TRACE_SCOPE("ingest drain");
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    auto selectedPath = treeViewGetPathToCurrentItem();
+    auto selectedTopic = selectedPath.isEmpty() ? nullptr : treeViewFindTopic(selectedPath);
+    bool selectedChanged = false;
+
+    while (elapsed.elapsed() < INGEST_BATCH_TIME)
+    {
+        auto batch = ingestQueue.take(INGEST_BATCH_MESSAGES);
+        if (batch.isEmpty())
+            break;
+
+        for (auto &queued : batch)
+        {
+            if (processMessage(queued) == selectedTopic)
+                selectedChanged = true;
+        }
+    }
+
+    // Value history is refreshed once per batch instead of once per message
+    if (selectedChanged && selectedTopic != nullptr)
+        refreshValuesList();
+}
+
+
+void MainWindow::prepareMessage(QueuedMessage &queued)
+{
+    TRACE_SCOPE("message prepare");
+
+    auto payload = queued.message->getSharedPayload();
+
+    // Classified once here so that previews, exports and the inspector don't have to guess
+    queued.message->setPayloadClass(PayloadClassifier::classify(*payload));
+
+    queued.topicPath = queued.topic.split(QString("/"));
+    numericExtractor.extract(queued.topicPath, *payload, queued.samples);
+
+    // Alerts see every message, including ones that ingest policies drop later
+    alertEngine.evaluate(queued.connection, queued.topic, queued.topicPath, *payload, queued.message->getTimestamp());
+    topicBridge.forward(queued.connection, queued.topicPath, payload);
+
+    // Hits of messages that are dropped by a policy or not in the tree yet are skipped by the search
+    searchIndex.addMessage(queued.message->getId(), QStringList(queued.connection) + queued.topicPath, queued.message->getPayloadHandle());
+}
+
+
+Topic *MainWindow::processMessage(const QueuedMessage &queued)
+{
+    TRACE_SCOPE("tree insert");
+
+    auto connection = queued.connection;
+    auto message = queued.message;
+
+    // Every connection has its own root in the tree
+    auto topicPath = queued.topicPath;
+    topicPath.prepend(connection);
 
     int topicsRowIndex = -1;
     for (int i = 0; i < topicsTree.length(); i++)
@@ -197,10 +981,21 @@ void MainWindow::newMessage(QString topic, std::string payload)
     if (topicObject == nullptr)
     {
         // Add topic to backend model
-        topicObject = row->addTopic(new Topic(topic));
+        topicObject = row->addTopic(topicPath);
     }
 
-    topicObject->addMessage(payload, numberOfMessagesInHistory);
+    // Topics created only as parents of other topics become known once a message is published to them
+    if (topicObject->getMessageCount() == 0)
+        topicFinder.addTopic(connection, queued.topic);
+
+    // Numeric values are kept as series independently of the message history
+    for (auto &sample : queued.samples)
+        topicObject->addSample(sample.first, message->getTimestamp(), sample.second);
+
+    topicObject->addMessage(message, numberOfMessagesInHistory);
+
+    if (insertLatencies != nullptr)
+        insertLatencies->append(Trace::now() - queued.arrived);
 
 
 
@@ -213,7 +1008,7 @@ void MainWindow::newMessage(QString topic, std::string payload)
 
         QTreeWidgetItem *currentItem = nullptr;
         if (foundItems.empty())
-            currentItem = treeViewAddRootItem(topicPath[0]);
+            currentItem = treeViewAddRootItem(row);
         else
             currentItem = foundItems.first();
 
@@ -233,38 +1028,104 @@ void MainWindow::newMessage(QString topic, std::string payload)
 
             if (!found)
             {
-                currentItem = treeViewAddItem(currentItem, topicPath[i]);
+                auto itemTopic = static_cast<TopicTreeItem *>(currentItem)->getTopic()->findTopic(QStringList(currentItem->text(0)) << topicPath[i]);
+                currentItem = treeViewAddItem(currentItem, itemTopic);
             }
         }
-
-        refreshValuesList();
     }
+
+    return topicObject;
 }
 
 // -------- //
 // Tree tab //
 // -------- //
 
-QTreeWidgetItem * MainWindow::treeViewAddRootItem(QString title)
+QTreeWidgetItem * MainWindow::treeViewAddRootItem(Topic *topic)
 {
-    auto rootItem = new QTreeWidgetItem(ui->treeWidget);
-    rootItem->setText(0, title);
+    auto rootItem = new TopicTreeItem(ui->treeWidget, topic);
     //ui->treeWidget->addTopLevelItem(rootItem);
 
     return rootItem;
 }
 
 
-QTreeWidgetItem * MainWindow::treeViewAddItem(QTreeWidgetItem *parent, QString title)
+QTreeWidgetItem * MainWindow::treeViewAddItem(QTreeWidgetItem *parent, Topic *topic)
 {
-    auto childItem = new QTreeWidgetItem(parent);
-    childItem->setText(0, title);
+    auto childItem = new TopicTreeItem(parent, topic);
     //parent->addChild(childItem);
 
     return childItem;
 }
 
 
+void MainWindow::refreshTopicStatistics()
+{
+    auto now = QDateTime::currentMSecsSinceEpoch();
+
+    // Only items that can be seen are refreshed, children of collapsed items are refreshed when expanded
+    QList<QTreeWidgetItem *> items;
+    for (int i = 0; i < ui->treeWidget->topLevelItemCount(); i++)
+        items.append(ui->treeWidget->topLevelItem(i));
+
+    while (!items.isEmpty())
+    {
+        auto item = items.takeLast();
+        static_cast<TopicTreeItem *>(item)->refresh(now);
+
+        if (!item->isExpanded())
+            continue;
+
+        for (int i = 0; i < item->childCount(); i++)
+            items.append(item->child(i));
+    }
+}
+
+
+void MainWindow::sweepExpiredTopics()
+{
+    if (topicExpiry <= 0)
+        return;
+
+    // Connections are never removed, a new round starts from them once the previous round is done
+    if (expirySweep.isEmpty())
+        expirySweep = topicsTree;
+
+    auto cutoff = QDateTime::currentMSecsSinceEpoch() - topicExpiry;
+
+    QList<Topic *> stale;
+    for (int i = 0; i < EXPIRY_SWEEP_TOPICS && !expirySweep.isEmpty(); i++)
+    {
+        QList<Topic *> live;
+        expirySweep.takeLast()->sweepChildren(cutoff, stale, live);
+        expirySweep.append(live);
+    }
+
+    if (stale.isEmpty())
+        return;
+
+    // Charts point to series of their topics, the removed topics are no longer in the tree so the charts let go of them
+    refreshCharts();
+
+    QList<QPair<QString, QString>> removed;
+    for (auto topic : stale)
+    {
+        auto path = topic->getPath();
+        auto connection = path.takeFirst();
+        removed.append(qMakePair(connection, path.join("/")));
+
+        // Items point to their topics, so they go first
+        delete topic->getTreeItem();
+        delete topic;
+    }
+
+    // Components keeping state per topic forget the removed subtrees
+    topicFinder.removeSubtrees(removed);
+    alertEngine.removeSubtrees(removed);
+    ingestQueue.removeSubtrees(removed);
+}
+
+
 QStringList MainWindow::treeViewGetPathToCurrentItem()
 {
     // Get path from tree
@@ -305,8 +1166,64 @@ Topic *MainWindow::treeViewFindTopic(QStringList path)
 }
 
 
+void MainWindow::treeViewSelectPath(QStringList path)
+{
+    auto foundItems = ui->treeWidget->findItems(path.value(0), Qt::MatchExactly);
+    if (foundItems.empty())
+        return;
+
+    auto currentItem = foundItems.first();
+    for (int i = 1; i < path.length(); i++)
+    {
+        QTreeWidgetItem *child = nullptr;
+        for (int j = 0; j < currentItem->childCount(); j++)
+        {
+            if (currentItem->child(j)->text(0) == path[i])
+            {
+                child = currentItem->child(j);
+                break;
+            }
+        }
+
+        if (child == nullptr)
+            return;
+        currentItem = child;
+    }
+
+    ui->treeWidget->setCurrentItem(currentItem);
+    ui->treeWidget->scrollToItem(currentItem);
+}
+
+
+void MainWindow::showSearchHits(QList<SearchHit> hits)
+{
+    ui->searchResultsList->clear();
+
+    for (int i = 0; i < hits.length(); i++)
+    {
+        auto &hit = hits.at(i);
+
+        // The index may still know messages that were removed from history in the meantime
+        auto topic = treeViewFindTopic(hit.topicPath);
+        if (topic == nullptr || !topic->hasMessage(hit.messageId))
+            continue;
+
+        auto payload = hit.payload->get();
+        auto preview = QString::fromUtf8(payload->data(), static_cast<int>(std::min<size_t>(payload->length(), 80)));
+        auto item = new QListWidgetItem(QString("%1: %2").arg(hit.topicPath.join("/"), preview.simplified()), ui->searchResultsList);
+        item->setData(Qt::UserRole, hit.topicPath);
+        item->setToolTip(hit.topicPath.join("/"));
+    }
+
+    if (ui->searchResultsList->count() == 0)
+        new QListWidgetItem("No results", ui->searchResultsList);
+}
+
+
 void MainWindow::refreshValuesList()
 {
+    TRACE_SCOPE("history refresh");
+
     ui->valueHistoryList->clear();
     ui->valueTextField->clear();
 
@@ -319,15 +1236,17 @@ void MainWindow::refreshValuesList()
         return;
 
     auto messages = topic->getMessages(numberOfMessagesInHistory);
-    QStringList values;
     for (int i = 0; i < messages.length(); i++)
     {
-        values.append(QString::fromStdString(messages.at(i)->data()));
+        auto message = messages.at(i);
+        // Full payloads are only decoded by the inspector
+        auto item = new QListWidgetItem(message->getPreview(), ui->valueHistoryList);
+
+        // Metadata (arrival, MQTT v5 expiry and user properties) is shown on hover, expired messages are greyed out
+        item->setToolTip(message->describe());
+        if (message->isExpired())
+            item->setForeground(Qt::gray);
     }
-
-    ui->valueHistoryList->addItems(values);
-
-    QThread::msleep(20);
 }
 
 
@@ -337,6 +1256,32 @@ void MainWindow::on_treeWidget_itemSelectionChanged()
 }
 
 
+void MainWindow::on_treeWidget_itemExpanded(QTreeWidgetItem *item)
+{
+    auto topic = static_cast<TopicTreeItem *>(item)->getTopic();
+
+    // Items of topics that received a message are there already
+    QSet<QString> present;
+    for (int i = 0; i < item->childCount(); i++)
+        present.insert(item->child(i)->text(0));
+
+    auto &children = topic->getChildren();
+    for (int i = 0; i < children.length(); i++)
+    {
+        auto child = children.at(i);
+        if (present.contains(child->getTopic()))
+            continue;
+
+        treeViewAddItem(item, child);
+    }
+
+    // Items that were collapsed were not refreshed
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < item->childCount(); i++)
+        static_cast<TopicTreeItem *>(item->child(i))->refresh(now);
+}
+
+
 void MainWindow::on_subscribeButton_clicked()
 {
     auto topic = ui->subscribeTopicTextField->text();
@@ -357,6 +1302,93 @@ void MainWindow::on_subscribeResetButton_clicked()
 }
 
 
+void MainWindow::on_topicFinderTextField_textChanged(const QString &text)
+{
+    ui->topicFinderList->clear();
+
+    auto matches = topicFinder.find(text, 20);
+    for (int i = 0; i < matches.length(); i++)
+    {
+        auto &match = matches.at(i);
+
+        auto item = new QListWidgetItem(QString("%1  (%2)").arg(match.topic, match.connection), ui->topicFinderList);
+        item->setData(Qt::UserRole, QStringList(match.connection) + match.topic.split("/"));
+    }
+
+    ui->topicFinderList->setVisible(!matches.isEmpty());
+}
+
+
+void MainWindow::on_topicFinderTextField_returnPressed()
+{
+    if (ui->topicFinderList->count() > 0)
+        on_topicFinderList_itemActivated(ui->topicFinderList->item(0));
+}
+
+
+void MainWindow::on_topicFinderList_itemActivated(QListWidgetItem *item)
+{
+    treeViewSelectPath(item->data(Qt::UserRole).toStringList());
+    ui->treeWidget->setFocus();
+}
+
+
+void MainWindow::on_searchButton_clicked()
+{
+    auto query = ui->searchTextField->text();
+    if (query.trimmed().isEmpty())
+    {
+        presentDialog("Nothing to search", "Please provide words or a regular expression to search for.");
+        return;
+    }
+
+    regexSearch.cancel();
+
+    if (ui->searchModeBox->currentText() == "Words")
+    {
+        showSearchHits(searchIndex.findWords(query, 1000));
+        return;
+    }
+
+    QRegularExpression expression(query, QRegularExpression::CaseInsensitiveOption);
+    if (!expression.isValid())
+    {
+        presentDialog("Invalid regular expression", expression.errorString());
+        return;
+    }
+
+    ui->searchResultsList->clear();
+    new QListWidgetItem("Searching...", ui->searchResultsList);
+    regexSearch.setFuture(searchIndex.findRegex(expression));
+}
+
+
+void MainWindow::on_searchTextField_returnPressed()
+{
+    on_searchButton_clicked();
+}
+
+
+void MainWindow::regexSearchFinished()
+{
+    if (regexSearch.isCanceled())
+        return;
+
+    // Newest first like word search, only the first thousand are shown
+    auto hits = regexSearch.future().results();
+    std::sort(hits.begin(), hits.end(), [](const SearchHit &a, const SearchHit &b) { return a.messageId > b.messageId; });
+    showSearchHits(hits.mid(0, 1000));
+}
+
+
+void MainWindow::on_searchResultsList_itemDoubleClicked(QListWidgetItem *item)
+{
+    auto path = item->data(Qt::UserRole).toStringList();
+    if (!path.isEmpty())
+        treeViewSelectPath(path);
+}
+
+
 void MainWindow::on_valueInspectButton_clicked()
 {
     auto selectedIndex = ui->valueHistoryList->currentIndex();
@@ -380,190 +1412,650 @@ void MainWindow::on_valueInspectButton_clicked()
     if (selectedIndex.row() >= messages.length())
         return;
 
-    auto message = messages.at(selectedIndex.row());
+    auto message = messages.at(selectedIndex.row());
+
+    // Decoder rules match topics without the connection root
+    itemPath.removeFirst();
+
+    ValueInspectDialog dialog(&decoderRegistry, this);
+    dialog.setMessage(message->getId(), itemPath.join("/"), message->getSharedPayload(), message->getPayloadClass().kind);
+    dialog.exec();
+}
+
+
+void MainWindow::on_valueHistoryList_itemDoubleClicked(QListWidgetItem *item)
+{
+    on_valueInspectButton_clicked();
+}
+
+
+void MainWindow::on_valueHistoryList_itemSelectionChanged()
+{
+    auto item = ui->valueHistoryList->currentItem();
+    ui->valueTextField->setText(item->text());
+}
+
+
+void MainWindow::on_publishTextButton_clicked()
+{
+    auto topic = ui->publishTopicTextField->text();
+    auto message = ui->publishTextMessageTextField->text();
+
+    if (topic.isEmpty())
+    {
+        presentDialog("No topic provided", "Please provide a topic for sending the message.");
+        return;
+    }
+    if (message.isEmpty())
+    {
+        presentDialog("No message provided", "Please provide a message to send.");
+        return;
+    }
+
+    auto mqttHandler = activeConnection();
+    if (mqttHandler == nullptr)
+        return;
+
+    mqttHandler->publishMessage(topic, message.toStdString(), ui->publishQosBox->currentIndex(), ui->publishRetainCheckBox->isChecked());
+}
+
+
+void MainWindow::on_publishFileButton_clicked()
+{
+    if (filePublisher != nullptr && filePublisher->isRunning())
+    {
+        filePublisher->stop();
+        return;
+    }
+
+    auto topic = ui->publishTopicTextField->text();
+    auto filePath = ui->publishFilePathTextField->text().trimmed();
+
+    if (topic.isEmpty())
+    {
+        presentDialog("No topic provided", "Please provide a topic for sending the message.");
+        return;
+    }
+    if (filePath.isEmpty())
+    {
+        presentDialog("No file path provided", "Please provide a path to file.");
+        return;
+    }
+
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile() && !fileInfo.isDir())
+    {
+        auto text = QString("File '").append(filePath).append("' either does not exist or is not a file or directory. Please check if you've provided the correct path.");
+        presentDialog("Invalid file name", text);
+        return;
+    }
+
+    auto mqttHandler = activeConnection();
+    if (mqttHandler == nullptr)
+        return;
+
+    if (filePublisher != nullptr && filePublisher->getMqttHandler() != mqttHandler)
+    {
+        delete filePublisher;
+        filePublisher = nullptr;
+    }
+
+    if (filePublisher == nullptr)
+    {
+        filePublisher = new FilePublisher(mqttHandler, this);
+        connect(filePublisher, &FilePublisher::progress, this, &MainWindow::filePublishProgress);
+        connect(filePublisher, &FilePublisher::finished, this, &MainWindow::filePublishFinished);
+    }
+
+    qint64 chunkSize = 0;
+    if (ui->publishFileChunkCheckBox->isChecked())
+        chunkSize = static_cast<qint64>(ui->publishFileChunkSizeSpinBox->value()) * 1024;
+
+    ui->publishFileProgressBar->setValue(0);
+    ui->publishFileProgressBar->setVisible(true);
+    ui->publishFileButton->setText("Cancel");
+
+    filePublisher->run(topic, filePath, ui->publishQosBox->currentIndex(), ui->publishRetainCheckBox->isChecked(), chunkSize);
+}
+
+
+void MainWindow::filePublishProgress(qint64 bytesPublished, qint64 bytesTotal)
+{
+    // Progress bar works with int, show per mille
+    ui->publishFileProgressBar->setMaximum(1000);
+    ui->publishFileProgressBar->setValue(bytesTotal > 0 ? static_cast<int>(bytesPublished * 1000 / bytesTotal) : 1000);
+}
+
+
+void MainWindow::filePublishFinished(QString error)
+{
+    ui->publishFileProgressBar->setVisible(false);
+    ui->publishFileButton->setText("Publish file");
+
+    if (!error.isEmpty())
+        presentDialog("File not published", error);
+}
+
+// ------------ //
+// Settings tab //
+// ------------ //
+
+void MainWindow::on_connectToServerButton_clicked()
+{
+    auto address = ui->AddressTextField->text();
+    auto port = ui->PortTextField->text();
+    auto clientId = ui->clientIdTextField->text().trimmed();
+
+    if (address.isEmpty())
+    {
+        presentDialog("No address provided", "Please enter an address of server.");
+        return;
+    }
+    if (port.isEmpty())
+    {
+        presentDialog("No port provided", "Please enter a port of server.");
+        return;
+    }
+
+    QUrl url = QUrl::fromUserInput(QString(address).append(":").append(port));
+    if (!url.isValid())
+    {
+        auto text = QString("'").append(url.url()).append("' is not a valid address.");
+        presentDialog("Invalid address", text);
+        return;
+    }
+
+    // Every server has its own root in the topics tree, so it can be connected only once
+    auto name = QString(address).append(":").append(port);
+    if (findConnection(name) != nullptr)
+    {
+        auto text = QString("Already connected to '").append(name).append("'.");
+        presentDialog("Already connected", text);
+        return;
+    }
+
+    // Clients with the same ID kick each other off the broker
+    if (clientId.isEmpty())
+        clientId = QString("ICP_explorer_%1").arg(QRandomGenerator::global()->generate(), 8, 16, QChar('0'));
+
+    ConnectionSettings settings;
+    settings.persistentSession = ui->persistentSessionCheckBox->isChecked();
+    settings.offlineQueueLimit = ui->offlineQueueSpinBox->value();
+    settings.mqttV5 = ui->protocolBox->currentIndex() == 1;
+    settings.receiveMaximum = ui->receiveMaximumSpinBox->value();
+    settings.topicAliasMaximum = ui->topicAliasSpinBox->value();
+    settings.sharedGroup = ui->sharedGroupTextField->text().trimmed();
+
+    if (settings.sharedGroup.contains(QRegularExpression("[/+#]")))
+    {
+        presentDialog("Invalid shared group", "Shared group name can't contain '/', '+' or '#'.");
+        return;
+    }
+
+    auto mqttHandler = new MqttHandler(address, port, clientId, this, settings);
+
+    mqttHandler->setInFlightWindow(ui->inFlightWindowSpinBox->value());
+    mqttHandler->setPublishTimeout(ui->publishTimeoutSpinBox->value() * 1000);
+    mqttHandlers.append(mqttHandler);
+    topicBridge.setTarget(name, mqttHandler);
+
+    ui->connectionsBox->addItem(name);
+    ui->connectionsBox->setCurrentIndex(ui->connectionsBox->count() - 1);
+
+    ui->disconnectButton->setEnabled(true);
+    ui->publishTextButton->setEnabled(true);
+    ui->publishFileButton->setEnabled(true);
+    ui->simulatorButton->setEnabled(true);
+}
+
+
+void MainWindow::on_disconnectButton_clicked()
+{
+    auto mqttHandler = activeConnection();
+    if (mqttHandler == nullptr)
+        return;
+
+    // File publisher uses the handler from its worker thread
+    if (filePublisher != nullptr && filePublisher->getMqttHandler() == mqttHandler)
+    {
+        delete filePublisher;
+        filePublisher = nullptr;
+
+        ui->publishFileButton->setText("Publish file");
+        ui->publishFileProgressBar->setVisible(false);
+    }
+
+    mqttHandlers.removeOne(mqttHandler);
+    topicBridge.setTarget(mqttHandler->getName(), nullptr);
+    ui->connectionsBox->removeItem(ui->connectionsBox->currentIndex());
+    delete mqttHandler;
+
+    ui->statusbar->clearMessage();
+
+    if (!mqttHandlers.isEmpty())
+        return;
+
+    if (simulator != nullptr)
+        simulator->stop();
+    ui->simulatorButton->setChecked(false);
+    ui->simulatorButton->setText("Run");
+    ui->disconnectButton->setEnabled(false);
+    ui->publishTextButton->setEnabled(false);
+    ui->publishFileButton->setEnabled(false);
+    ui->simulatorButton->setEnabled(false);
+}
+
+
+void MainWindow::on_connectionsBox_currentTextChanged(const QString &text)
+{
+    QMutexLocker locker(&dashboardTopicsMutex);
+    dashboardConnection = text;
+}
+
+
+MqttHandler *MainWindow::activeConnection()
+{
+    return findConnection(ui->connectionsBox->currentText());
+}
+
+
+MqttHandler *MainWindow::findConnection(QString name)
+{
+    for (int i = 0; i < mqttHandlers.length(); i++)
+    {
+        if (mqttHandlers.at(i)->getName() == name)
+            return mqttHandlers.at(i);
+    }
+
+    return nullptr;
+}
+
+
+void MainWindow::on_numberOfMessagesSetButton_clicked()
+{
+    auto numberString = ui->numberOfMessagesTextField->text();
+    if (numberString.isEmpty())
+    {
+        presentDialog("No input provided", "Please enter a number for how many messages should be stored.");
+        return;
+    }
+
+    numberOfMessagesInHistory = numberString.toInt();
+
+    // Set to infinity when set to 0 (or lower)
+    if (numberOfMessagesInHistory <= 0)
+        numberOfMessagesInHistory = INT_MAX;
+
+    refreshValuesList();
+}
+
+
+void MainWindow::on_inFlightWindowSpinBox_valueChanged(int value)
+{
+    for (int i = 0; i < mqttHandlers.length(); i++)
+        mqttHandlers.at(i)->setInFlightWindow(value);
+}
+
+
+void MainWindow::on_publishTimeoutSpinBox_valueChanged(int value)
+{
+    for (int i = 0; i < mqttHandlers.length(); i++)
+        mqttHandlers.at(i)->setPublishTimeout(value * 1000);
+}
+
+
+void MainWindow::on_decoderRulesApplyButton_clicked()
+{
+    QList<QPair<TopicFilter, QString>> rules;
+
+    auto error = decoderRegistry.parseRules(ui->decoderRulesTextField->text(), rules);
+    if (!error.isEmpty())
+    {
+        presentDialog("Invalid decoder rules", error);
+        return;
+    }
+
+    decoderRegistry.setRules(rules);
+}
+
+
+void MainWindow::on_decoderPluginsLoadButton_clicked()
+{
+    auto directory = ui->decoderPluginsTextField->text();
+    if (directory.isEmpty())
+    {
+        presentDialog("No directory provided", "Please provide a directory with decoder plugins.");
+        return;
+    }
+
+    QStringList errors;
+    auto loaded = decoderRegistry.loadPlugins(directory, errors);
+
+    if (!errors.isEmpty())
+        presentDialog("Some plugins were not loaded", errors.join("\n"));
+    else
+        presentDialog("Plugins loaded", QString("Loaded %1 decoders.").arg(loaded));
+}
+
+
+void MainWindow::on_numericFieldsApplyButton_clicked()
+{
+    QList<QPair<TopicFilter, QStringList>> rules;
+
+    auto error = NumericExtractor::parseRules(ui->numericFieldsTextField->text(), rules);
+    if (!error.isEmpty())
+    {
+        presentDialog("Invalid numeric fields", error);
+        return;
+    }
+
+    numericExtractor.setRules(rules);
+}
+
+
+void MainWindow::on_topicExpirySpinBox_valueChanged(int value)
+{
+    topicExpiry = static_cast<qint64>(value) * 1000;
+    expirySweep.clear();
+
+    if (topicExpiry > 0)
+        expiryTimer->start(EXPIRY_SWEEP_INTERVAL);
+    else
+        expiryTimer->stop();
+}
+
+
+void MainWindow::on_ingestPoliciesApplyButton_clicked()
+{
+    QList<QPair<TopicFilter, IngestPolicy>> rules;
+
+    auto error = IngestQueue::parseRules(ui->ingestPoliciesTextField->text(), rules);
+    if (!error.isEmpty())
+    {
+        presentDialog("Invalid ingest policies", error);
+        return;
+    }
+
+    setIngestPolicies(rules);
+    refreshIngestStatistics();
+}
+
+
+void MainWindow::on_alertRulesApplyButton_clicked()
+{
+    QList<AlertRule> rules;
+
+    auto error = AlertEngine::parseRules(ui->alertRulesTextField->text(), rules);
+    if (!error.isEmpty())
+    {
+        presentDialog("Invalid alert rules", error);
+        return;
+    }
+
+    alertEngine.setRules(rules, QDateTime::currentMSecsSinceEpoch());
+    ui->statusbar->showMessage(QString("%1 alert rules applied").arg(rules.length()), 5000);
+}
+
+
+void MainWindow::checkAlerts()
+{
+    alertEngine.tick(QDateTime::currentMSecsSinceEpoch());
+
+    for (auto &alert : alertEngine.takeAlerts())
+    {
+        auto time = QDateTime::fromMSecsSinceEpoch(alert.timestamp).toString("HH:mm:ss");
+        auto text = QString("%1 %2 %3: %4").arg(time, alert.raised ? "RAISED" : "cleared", alert.topic, alert.rule);
+
+        ui->alertsList->insertItem(0, text);
+        if (alert.raised)
+        {
+            ui->alertsList->item(0)->setForeground(Qt::red);
+            ui->statusbar->showMessage(QString("Alert: %1").arg(text), 10000);
+        }
+
+        while (ui->alertsList->count() > ALERT_LIST_ITEMS)
+            delete ui->alertsList->takeItem(ui->alertsList->count() - 1);
+
+        if (alert.publishTopic.isEmpty())
+            continue;
+
+        // Topics silent from the start have no connection, the active one is used
+        auto mqttHandler = alert.connection.isEmpty() ? activeConnection() : findConnection(alert.connection);
+        if (mqttHandler == nullptr)
+            continue;
+
+        QJsonObject payload;
+        payload["rule"] = alert.rule;
+        payload["topic"] = alert.topic;
+        payload["state"] = alert.raised ? "raised" : "cleared";
+        payload["timestamp"] = alert.timestamp;
 
-    auto dialog = new ValueInspectDialog();
-    dialog->setMessage(*message);
-    dialog->exec();
+        mqttHandler->publishMessage(alert.publishTopic, QJsonDocument(payload).toJson(QJsonDocument::Compact).toStdString(), 1);
+    }
 }
 
 
-void MainWindow::on_valueHistoryList_itemDoubleClicked(QListWidgetItem *item)
+void MainWindow::on_bridgeRulesApplyButton_clicked()
 {
-    on_valueInspectButton_clicked();
-}
+    QList<BridgeRule> rules;
 
+    auto error = TopicBridge::parseRules(ui->bridgeRulesTextField->text(), rules);
+    if (!error.isEmpty())
+    {
+        presentDialog("Invalid bridge rules", error);
+        return;
+    }
 
-void MainWindow::on_valueHistoryList_itemSelectionChanged()
-{
-    auto item = ui->valueHistoryList->currentItem();
-    ui->valueTextField->setText(item->text());
+    topicBridge.setRules(rules);
+    refreshBridgeStatistics();
 }
 
 
-void MainWindow::on_publishTextButton_clicked()
+void MainWindow::refreshBridgeStatistics()
 {
-    auto topic = ui->publishTopicTextField->text();
-    auto message = ui->publishTextMessageTextField->text();
+    QStringList lines;
 
-    if (topic.isEmpty())
-    {
-        presentDialog("No topic provided", "Please provide a topic for sending the message.");
-        return;
-    }
-    if (message.isEmpty())
+    for (auto &statistics : topicBridge.getStatistics())
     {
-        presentDialog("No message provided", "Please provide a message to send.");
-        return;
+        lines.append(QString("%1: %2 forwarded, %3 dropped, %4 buffered")
+                .arg(statistics.rule).arg(statistics.forwarded).arg(statistics.dropped).arg(statistics.buffered));
     }
 
-    mqttHandler->publishMessage(topic, message.toStdString());
+    ui->bridgeStatisticsLabel->setText(lines.isEmpty() ? QString("No bridge rules.") : lines.join("\n"));
 }
 
 
-void MainWindow::on_publishFileButton_clicked()
+void MainWindow::refreshIngestStatistics()
 {
-    auto topic = ui->publishTopicTextField->text();
-    auto filePath = ui->publishFilePathTextField->text().trimmed();
+    QStringList lines;
 
-    if (topic.isEmpty())
-    {
-        presentDialog("No topic provided", "Please provide a topic for sending the message.");
-        return;
-    }
-    if (filePath.isEmpty())
+    for (auto &statistics : getIngestStatistics())
     {
-        presentDialog("No file path provided", "Please provide a path to file.");
-        return;
-    }
+        if (statistics.received == 0)
+            continue;
 
-    QFile file(filePath);
-    QFileInfo fileInfo(filePath);
-    if (!fileInfo.isFile())
-    {
-        auto text = QString("File '").append(filePath).append("' either does not exist or is not a file. Please check if you've provided the correct path.");
-        presentDialog("Invalid file name", text);
+        auto name = statistics.filter.isEmpty() ? QString("Other topics") : statistics.filter;
+        lines.append(QString("%1 (%2): %3 received, %4 processed, %5 conflated, %6 sampled out, %7 dropped, %8 queued")
+                .arg(name, statistics.policy).arg(statistics.received).arg(statistics.processed).arg(statistics.conflated)
+                .arg(statistics.sampledOut).arg(statistics.droppedOldest).arg(statistics.pending));
     }
 
-    std::ifstream ifs(filePath.toStdString());
-    std::string content((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+    ui->ingestStatisticsLabel->setText(lines.isEmpty() ? QString("No messages received yet.") : lines.join("\n"));
+}
+
 
-    if (content.empty())
+void MainWindow::refreshPublishStatistics()
+{
+    auto mqttHandler = activeConnection();
+    if (mqttHandler == nullptr)
         return;
 
-    mqttHandler->publishMessage(topic, content);
+    auto text = mqttHandler->getName().append(": ");
+    if (!mqttHandler->isConnected())
+        text.append(QString("Disconnected, reconnect attempt %1. ").arg(mqttHandler->getReconnectAttempt()));
+
+    auto statistics = mqttHandler->getPublishStatistics();
+    text.append(QString("Published: %1 acknowledged, %2 failed, %3 timed out, %4 dropped, %5 in flight, %6 queued")
+            .arg(statistics.acknowledged).arg(statistics.failed).arg(statistics.timedOut)
+            .arg(statistics.dropped).arg(statistics.inFlight).arg(statistics.queued));
+
+    ui->statusbar->showMessage(text);
 }
 
-// ------------ //
-// Settings tab //
-// ------------ //
 
-void MainWindow::on_connectToServerButton_clicked()
+void MainWindow::on_exportButton_clicked()
 {
-    if (mqttHandler == nullptr)
+    TRACE_SCOPE("export");
+
+    auto directoryPath = ui->exportPathTextField->text().trimmed();
+
+    if (directoryPath.isEmpty())
     {
-        auto address = ui->AddressTextField->text();
-        auto port = ui->PortTextField->text();
+        presentDialog("No path provided", "Please enter path where to save captured data.");
+        return;
+    }
 
-        if (address.isEmpty())
-        {
-            presentDialog("No address provided", "Please enter an address of server.");
-            return;
-        }
-        if (port.isEmpty())
+    // CSV and columnar files are written in the background, only collecting the history runs here
+    if (ui->exportFormatBox->currentIndex() > 0)
+    {
+        if (historyExport.isRunning())
         {
-            presentDialog("No port provided", "Please enter a port of server.");
+            presentDialog("Export is running", "Please wait until the running export is finished.");
             return;
         }
 
-        QUrl url = QUrl::fromUserInput(QString(address).append(":").append(port));
-        if (!url.isValid())
-        {
-            auto text = QString("'").append(url.url()).append("' is not a valid address.");
-            presentDialog("Invalid address", text);
-            return;
-        }
+        auto content = ui->exportContentBox->currentIndex() == 0 ? ExportContent::Payloads : ExportContent::Fields;
+        auto format = ui->exportFormatBox->currentIndex() == 1 ? ExportFormat::Csv : ExportFormat::Columnar;
 
-        mqttHandler = new MqttHandler(address, port, "xurgos00_ICP_explorer", this);
+        HistoryExport history(content);
+        for (auto root : topicsTree)
+            root->exportHistory(QString(), history);
 
-        if (mqttHandler != nullptr)
+        historyExportRows = history.getRowCount();
+        historyExportWritten.store(0);
+        ui->exportButton->setEnabled(false);
+
+        auto written = &historyExportWritten;
+        historyExport.setFuture(QtConcurrent::run([history, directoryPath, format, written]()
         {
-            ui->connectToServerButton->setText("Disconnect");
+            return history.save(directoryPath, format, written);
+        }));
 
-            ui->publishTextButton->setEnabled(true);
-            ui->publishFileButton->setEnabled(true);
-            ui->simulatorButton->setEnabled(true);
-        }
+        refreshExportProgress();
+        return;
     }
-    else
-    {
-        delete mqttHandler;
-        mqttHandler = nullptr;
 
-        ui->connectToServerButton->setText("Connect");
+    auto directory = QDir(directoryPath);
+    if (!directory.isEmpty())
+    {
+        auto text = QString("Directory '").append(directory.path()).append("' is not empty. Please choose different path.");
+        presentDialog("Directory is not empty", text);
+        return;
+    }
 
-        if (simulator != nullptr)
-            simulator->stop();
-        ui->simulatorButton->setChecked(false);
-        ui->simulatorButton->setText("Run");
-        ui->publishTextButton->setEnabled(false);
-        ui->publishFileButton->setEnabled(false);
-        ui->simulatorButton->setEnabled(false);
+    for (int i = 0; i < topicsTree.length(); i++)
+    {
+        topicsTree.at(i)->exportToDisk(directory);
     }
 }
 
 
-void MainWindow::on_numberOfMessagesSetButton_clicked()
+void MainWindow::on_traceCheckBox_toggled(bool checked)
 {
-    auto numberString = ui->numberOfMessagesTextField->text();
-    if (numberString.isEmpty())
+    Trace::setEnabled(checked);
+}
+
+
+void MainWindow::on_traceSaveButton_clicked()
+{
+    auto path = ui->tracePathTextField->text().trimmed();
+    if (path.isEmpty())
     {
-        presentDialog("No input provided", "Please enter a number for how many messages should be stored.");
+        presentDialog("No path provided", "Please enter path where to save the trace.");
         return;
     }
 
-    numberOfMessagesInHistory = numberString.toInt();
-
-    // Set to infinity when set to 0 (or lower)
-    if (numberOfMessagesInHistory <= 0)
-        numberOfMessagesInHistory = INT_MAX;
+    if (traceSave.isRunning())
+        return;
 
-    refreshValuesList();
+    ui->traceSaveButton->setEnabled(false);
+    traceSave.setFuture(QtConcurrent::run([path]() { return Trace::save(path); }));
 }
 
 
-void MainWindow::on_exportButton_clicked()
+void MainWindow::traceSaveFinished()
 {
-    auto directoryPath = ui->exportPathTextField->text().trimmed();
+    ui->traceSaveButton->setEnabled(true);
 
-    if (directoryPath.isEmpty())
+    auto error = traceSave.result();
+    if (!error.isEmpty())
     {
-        presentDialog("No path provided", "Please enter path where to save captured data.");
+        presentDialog("Trace not saved", error);
         return;
     }
 
-    auto directory = QDir(directoryPath);
-    if (!directory.isEmpty())
+    ui->statusbar->showMessage("Trace saved", 10000);
+}
+
+
+void MainWindow::refreshExportProgress()
+{
+    if (!historyExport.isRunning())
+        return;
+
+    ui->statusbar->showMessage(QString("Exporting: %1 of %2 rows written").arg(historyExportWritten.load()).arg(historyExportRows));
+}
+
+
+void MainWindow::historyExportFinished()
+{
+    ui->exportButton->setEnabled(true);
+
+    auto error = historyExport.result();
+    if (!error.isEmpty())
     {
-        auto text = QString("Directory '").append(directory.path()).append("' is not empty. Please choose different path.");
-        presentDialog("Directory is not empty", text);
+        ui->statusbar->clearMessage();
+        presentDialog("Export failed", error);
         return;
     }
 
-    for (int i = 0; i < topicsTree.length(); i++)
+    ui->statusbar->showMessage(QString("Exported %1 rows").arg(historyExportWritten.load()), 10000);
+}
+
+
+void MainWindow::on_memoryReportButton_clicked()
+{
+    QList<MemoryReportEntry> entries;
+    TopicMemory total;
+    double stored = 0;
+    for (auto root : topicsTree)
     {
-        topicsTree.at(i)->exportToDisk(directory);
+        stored += root->reportMemory(QString(), entries);
+        total += root->getSubtreeMemory();
     }
+
+    auto store = PayloadStore::global().getStatistics();
+    auto summary = QString("%1 topics hold %2 messages with %3 B of payloads (%4 B stored), %5 B of series and %6 B of overhead. "
+                           "Deduplication saved %7 B, %8 cold payloads take %9 B instead of %10 B.")
+            .arg(entries.length()).arg(total.historyEntries).arg(total.payloadBytes).arg(static_cast<qint64>(stored))
+            .arg(total.seriesBytes).arg(total.overheadBytes).arg(store.deduplicatedBytes).arg(store.compressedPayloads)
+            .arg(store.compressedOutputBytes).arg(store.compressedInputBytes);
+
+    MemoryReportDialog dialog(this);
+    dialog.setEntries(entries, summary);
+    dialog.exec();
 }
 
 
 void MainWindow::on_simulatorButton_clicked()
 {
+    auto mqttHandler = activeConnection();
     if (mqttHandler == nullptr)
         return;
 
     if (simulator == nullptr)
-        simulator = new Simulator(mqttHandler->getAddress(), mqttHandler->getPort(), "xurgos00_ICP_simulator");
+        simulator = new Simulator(mqttHandler->getAddress(), mqttHandler->getPort(),
+                                  QString("ICP_simulator_%1").arg(QRandomGenerator::global()->generate(), 8, 16, QChar('0')));
 
     auto doSimulate = ui->simulatorButton->isChecked();
 
@@ -588,6 +2080,7 @@ void MainWindow::on_widgetAddButton_clicked()
     auto widgetName = ui->widgetNameText->text().trimmed();
     auto widgetType = ui->widgetAddBox->currentText().trimmed();
     auto widgetTopic = ui->widgetTopicText->text().trimmed();
+    auto widgetField = ui->widgetFieldText->text().trimmed();
 
     if(ui->widgetRemoveBox->count() == 12)
     {
@@ -624,6 +2117,7 @@ void MainWindow::on_widgetAddButton_clicked()
 
     ui->widgetNameText->clear();
     ui->widgetTopicText->clear();
+    ui->widgetFieldText->clear();
 
     if(ui->widgetRemoveBox->findText(widgetName, Qt::MatchCaseSensitive|Qt::MatchExactly) != -1)
     {
@@ -636,29 +2130,121 @@ void MainWindow::on_widgetAddButton_clicked()
         return;
     }
 
-    ui->widgetRemoveBox->addItem(widgetName);
+    addDashboardWidget(widgetType.toLower(), widgetName, widgetTopic, widgetField);
+}
+
 
-    QWidget* interface;
+void MainWindow::addDashboardWidget(QString type, QString name, QString topic, QString field)
+{
+    QWidget* interface = nullptr;
     for(int i=1; i <= 12; i++)
     {
-        interface = getWidgetPtr(i);
-        if(interface->findChild<QWidget *>(QString(), Qt::FindDirectChildrenOnly) == nullptr)
+        if(getWidgetPtr(i)->findChild<QWidget *>(QString(), Qt::FindDirectChildrenOnly) == nullptr)
         {
+            interface = getWidgetPtr(i);
             break;
         }
     }
 
-    if(widgetType == "Switch")
+    if(interface == nullptr)
+    {
+        return;
+    }
+
+    if(type == "switch")
+    {
+        createSwitch(interface, name, topic);
+    }
+    else if(type == "display")
+    {
+        createDisplay(interface, name, topic);
+    }
+    else if(type == "text")
+    {
+        createText(interface, name, topic);
+    }
+    else if(type == "chart")
+    {
+        createChart(interface, name, topic, field);
+    }
+    else
+    {
+        return;
+    }
+
+    ui->widgetRemoveBox->addItem(name);
+    refreshDashboardTopics();
+}
+
+
+void MainWindow::refreshDashboardTopics()
+{
+    QSet<QString> topics;
+
+    for(int i=1; i <= 12; i++)
     {
-        createSwitch(interface, widgetName, widgetTopic);
+        auto layout = getWidgetPtr(i)->findChild<QLayout *>(QString(), Qt::FindDirectChildrenOnly);
+        if(layout != nullptr)
+        {
+            topics.insert(layout->objectName());
+        }
     }
-    else if(widgetType == "Display")
+
+    QMutexLocker locker(&dashboardTopicsMutex);
+    dashboardTopics = topics;
+}
+
+
+QByteArray MainWindow::dashboardToJson()
+{
+    QJsonArray widgets;
+
+    for(int i=1; i <= 12; i++)
     {
-        createDisplay(interface, widgetName, widgetTopic);
+        auto interface = getWidgetPtr(i);
+        auto id = interface->findChild<QLabel *>("widgetID");
+        auto nameLabel = interface->findChild<QLabel *>("widgetNameLabel");
+        auto layout = interface->findChild<QLayout *>(QString(), Qt::FindDirectChildrenOnly);
+
+        if(id == nullptr || nameLabel == nullptr || layout == nullptr)
+        {
+            continue;
+        }
+
+        QJsonObject widget;
+        widget["type"] = id->text();
+        widget["name"] = nameLabel->text();
+        widget["topic"] = layout->objectName();
+
+        auto chart = interface->findChild<ChartWidget *>("widgetChart");
+        if(chart != nullptr)
+        {
+            widget["field"] = chart->getField();
+        }
+
+        widgets.append(widget);
     }
-    else if(widgetType == "Text")
+
+    return QJsonDocument(widgets).toJson(QJsonDocument::Compact);
+}
+
+
+void MainWindow::dashboardFromJson(QByteArray json)
+{
+    auto widgets = QJsonDocument::fromJson(json).array();
+
+    for(int i=0; i < widgets.size(); i++)
     {
-        createText(interface, widgetName, widgetTopic);
+        auto widget = widgets.at(i).toObject();
+        auto name = widget["name"].toString();
+        auto topic = widget["topic"].toString();
+
+        if(name.isEmpty() || topic.isEmpty() || ui->widgetRemoveBox->findText(name, Qt::MatchCaseSensitive|Qt::MatchExactly) != -1)
+        {
+            continue;
+        }
+
+        addDashboardWidget(widget["type"].toString(), name, topic, widget["field"].toString());
     }
 }
 
@@ -703,6 +2289,7 @@ void MainWindow::on_widgetRemoveButton_clicked()
 
 
     ui->widgetRemoveBox->removeItem(ui->widgetRemoveBox->currentIndex());
+    refreshDashboardTopics();
 }
 
 
@@ -725,8 +2312,43 @@ void MainWindow::on_widgetSwitchButton_clicked()
         newState = "OFF";
     }
 
-    stateLabel->setText(newState);
-    mqttHandler->publishMessage(topic, newState.toStdString());
+    auto mqttHandler = activeConnection();
+    if(mqttHandler == nullptr)
+    {
+        presentDialog("Not connected", "Please connect to a server before using the switch.");
+        return;
+    }
+
+    // Switch changes its state only once the broker confirms the message, the widget might be removed in the meantime
+    QPointer<QLabel> label(stateLabel);
+    QPointer<QPushButton> switchButton(button);
+    switchButton->setEnabled(false);
+
+    mqttHandler->publishMessage(topic, newState.toStdString(), 1, false, [this, label, switchButton, newState](PublishStatus status)
+    {
+        QMetaObject::invokeMethod(this, [label, switchButton, newState, status]()
+        {
+            if(switchButton != nullptr)
+            {
+                switchButton->setEnabled(true);
+            }
+
+            if(label == nullptr)
+            {
+                return;
+            }
+
+            if(status == PublishStatus::Acknowledged)
+            {
+                label->setText(newState);
+                label->setToolTip("");
+            }
+            else
+            {
+                label->setToolTip(status == PublishStatus::TimedOut ? "Last switch timed out" : "Last switch was not delivered");
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
 
@@ -750,13 +2372,42 @@ void MainWindow::on_widgetTextButton_clicked()
         return;
     }
 
+    auto mqttHandler = activeConnection();
+    if(mqttHandler == nullptr)
+    {
+        presentDialog("Not connected", "Please connect to a server before sending a message.");
+        return;
+    }
+
     lineEdit->clear();
-    mqttHandler->publishMessage(topic, text.toStdString());
+    mqttHandler->publishMessage(topic, text.toStdString(), 1);
+}
+
+
+void MainWindow::messageHandler(const QString &connection, mqtt::const_message_ptr msg)
+{
+    auto topic = QString().fromStdString(msg->get_topic());
+
+    // Widgets are updated on the GUI thread right away, dashboard topics are not subject to ingest policies
+    {
+        QMutexLocker locker(&dashboardTopicsMutex);
+        if(connection != dashboardConnection || !dashboardTopics.contains(topic))
+        {
+            return;
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, msg]()
+    {
+        dashboardMessage(msg);
+    }, Qt::QueuedConnection);
 }
 
 
-void MainWindow::messageHandler(mqtt::const_message_ptr msg)
+void MainWindow::dashboardMessage(mqtt::const_message_ptr msg)
 {
+    TRACE_SCOPE("dashboard dispatch");
+
     auto topic = QString().fromStdString(msg->get_topic());
     std::vector<QWidget *> interfaces;
     QLayout *widget;
@@ -937,6 +2588,76 @@ void MainWindow::createText(QWidget *interface, QString name, QString topic)
 }
 
 
+void MainWindow::createChart(QWidget *interface, QString name, QString topic, QString field)
+{
+    QLabel *nameLabel = new QLabel(name);
+    nameLabel->setAlignment(Qt::AlignHCenter);
+    nameLabel->setText(name);
+    nameLabel->setObjectName("widgetNameLabel");
+
+    ChartWidget *chart = new ChartWidget(field);
+    chart->setObjectName("widgetChart");
+
+    QComboBox *decimation = new QComboBox();
+    decimation->addItem("Min/max");
+    decimation->addItem("LTTB");
+    decimation->setToolTip("How samples are reduced to the width of the chart");
+    connect(decimation, QOverload<int>::of(&QComboBox::currentIndexChanged), chart, [chart](int index)
+    {
+        chart->setDecimation(index == 0 ? ChartWidget::Decimation::MinMax : ChartWidget::Decimation::Lttb);
+    });
+
+    QLabel *id = new QLabel("chart");
+    id->setVisible(false);
+    id->setObjectName("widgetID");
+
+    QVBoxLayout *layout = new QVBoxLayout(interface);
+    layout->addWidget(nameLabel);
+    layout->addWidget(chart);
+    layout->addWidget(decimation);
+    layout->setObjectName(topic);
+    layout->addWidget(id);
+}
+
+
+void MainWindow::refreshCharts()
+{
+    auto mqttHandler = activeConnection();
+
+    for(int i=1; i <= 12; i++)
+    {
+        auto interface = getWidgetPtr(i);
+        auto chart = interface->findChild<ChartWidget *>("widgetChart");
+        if(chart == nullptr)
+        {
+            continue;
+        }
+
+        // Series are looked up every time, the chart follows the connection selected in settings
+        TimeSeries *series = nullptr;
+        if(mqttHandler != nullptr)
+        {
+            auto topicPath = interface->findChild<QLayout *>(QString(), Qt::FindDirectChildrenOnly)->objectName().split("/");
+            topicPath.prepend(mqttHandler->getName());
+
+            auto topic = treeViewFindTopic(topicPath);
+            if(topic != nullptr)
+            {
+                series = topic->getSeries(chart->getField());
+
+                // Charted series keep a long history
+                if(series != nullptr && series->getCapacity() < CHART_SERIES_CAPACITY)
+                {
+                    topic->setSeriesCapacity(chart->getField(), CHART_SERIES_CAPACITY);
+                }
+            }
+        }
+
+        chart->setSeries(series);
+    }
+}
+
+
 void MainWindow::messageSwitchHandler(mqtt::const_message_ptr msg, QWidget *interface)
 {
     auto payload = msg->get_payload();
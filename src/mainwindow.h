@@ -12,10 +12,28 @@
 #include <QMainWindow>
 #include <QTreeWidgetItem>
 #include "valueinspectdialog.h"
+#include "memoryreportdialog.h"
 #include "mqtthandler.h"
 #include "simulator.h"
+#include "filepublisher.h"
+#include "message.h"
+#include "decoderregistry.h"
+#include "timeseries.h"
+#include "chartwidget.h"
+#include "searchindex.h"
+#include "topicfinder.h"
+#include "snapshot.h"
+#include "ingestqueue.h"
+#include "ingestworkers.h"
+#include "alertengine.h"
+#include "topicbridge.h"
+#include "historyexport.h"
+#include "trace.h"
+#include "topicstatistics.h"
 #include <QDir>
 #include <QListWidgetItem>
+#include <QMutex>
+#include <QSet>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -30,6 +48,18 @@ public:
      */
     Topic(QString topic);
 
+    /**
+     * @brief Create topic restored from a snapshot, its children are created from the snapshot once they are needed
+     * @param snapshot the topic is stored in, has to outlive the topic
+     * @param index of the topic in the snapshot
+     */
+    Topic(const TopicSnapshot *snapshot, int index);
+
+    /**
+     * @brief Delete messages and children of the topic
+     */
+    ~Topic();
+
     /**
      * @brief Get topic name
      * @return topic name
@@ -37,18 +67,83 @@ public:
     QString getTopic();
 
     /**
-     * @brief Add message to topic
+     * @brief Add message to topic, the topic takes ownership of the message
      * @param message to add
      * @param maxCount of messages stored
      */
-    void addMessage(std::string message, int maxCount);
+    void addMessage(Message *message, int maxCount);
 
     /**
      * @brief Get all messages
      * @param maxCount of mesages stored
      * @return list of messages
      */
-    QList<std::string *> &getMessages(int maxCount);
+    QList<Message *> &getMessages(int maxCount);
+
+    /**
+     * @brief Get number of messages received on the topic, including ones no longer in history
+     * @return number of messages
+     */
+    quint64 getMessageCount();
+
+    /**
+     * @brief Get statistics of messages received on the topic
+     * @return statistics
+     */
+    const TopicStatistics &getStatistics();
+
+    /**
+     * @brief Get statistics of messages received on the topic and all topics below it
+     * @return statistics
+     */
+    const TopicStatistics &getSubtreeStatistics();
+
+    /**
+     * @brief Get memory held by the topic itself
+     * @return memory
+     */
+    const TopicMemory &getMemory();
+
+    /**
+     * @brief Get memory held by the topic and all topics below it, updated by every change in the subtree
+     * @return memory
+     */
+    const TopicMemory &getSubtreeMemory();
+
+    /**
+     * @brief Check whether a message is still in the history
+     * @param messageId is unique identifier of the message
+     * @return true when the message is in the history
+     */
+    bool hasMessage(quint64 messageId);
+
+    /**
+     * @brief Add numeric sample to the series of a field
+     * @param field is path of the JSON field, empty for plain number payloads
+     * @param timestamp in milliseconds since epoch
+     * @param value of the sample
+     */
+    void addSample(QString field, qint64 timestamp, double value);
+
+    /**
+     * @brief Get series of a field
+     * @param field is path of the JSON field, empty for plain number payloads
+     * @return series or nullptr when no numeric value was received for the field
+     */
+    TimeSeries *getSeries(QString field);
+
+    /**
+     * @brief Set maximum number of samples of a series, memory of the topic is updated
+     * @param field is path of the JSON field, empty for plain number payloads
+     * @param capacity is maximum number of samples
+     */
+    void setSeriesCapacity(QString field, int capacity);
+
+    /**
+     * @brief Get fields that have series
+     * @return field paths
+     */
+    QStringList getSeriesFields();
 
     /**
      * @brief Find topic in the topics tree at the specified path
@@ -58,11 +153,11 @@ public:
     Topic * findTopic(QStringList path);
 
     /**
-     * @brief Add topic to tree, the location is determined by the topic attribute which is used as path in the tree
-     * @param topic to add to topic's tree structure
-     * @return the topic that was added to the tree
+     * @brief Add topic to tree at the specified path, missing topics along the path are created
+     * @param path is path to the topic in the tree, starting with this topic
+     * @return the topic at the path or nullptr if the path doesn't start with this topic
      */
-    Topic * addTopic(Topic *topic);
+    Topic * addTopic(QStringList path);
 
     /**
      * @brief Export (save) captured data to a directory on disk
@@ -70,6 +165,67 @@ public:
      */
     void exportToDisk(QDir directory);
 
+    /**
+     * @brief Add history of the topic and all topics below it to an export, children still in the snapshot are read from it
+     * @param path of the parent topic, empty for roots
+     * @param history to add to, payloads or samples of fields depending on its content
+     */
+    void exportHistory(QString path, HistoryExport &history);
+
+    /**
+     * @brief Get all children, children still in the snapshot are created
+     * @return list of children
+     */
+    QList<Topic *> &getChildren();
+
+    /**
+     * @brief Check whether the topic has children without creating them from the snapshot
+     * @return true when there are children
+     */
+    bool hasChildren();
+
+    /**
+     * @brief Get path from the root (connection) to the topic
+     * @return path
+     */
+    QStringList getPath();
+
+    /**
+     * @brief Remove children whose whole subtree received no message since the cutoff, children still in the snapshot are left alone
+     * @param cutoff in milliseconds since epoch
+     * @param stale children that were removed, the caller deletes them
+     * @param live children that were kept
+     */
+    void sweepChildren(qint64 cutoff, QList<Topic *> &stale, QList<Topic *> &live);
+
+    /**
+     * @brief Set item showing the topic in the tree view
+     * @param item or nullptr when the item was deleted
+     */
+    void setTreeItem(QTreeWidgetItem *item);
+
+    /**
+     * @brief Get item showing the topic in the tree view
+     * @return item or nullptr when the topic has no item
+     */
+    QTreeWidgetItem *getTreeItem();
+
+    /**
+     * @brief Add topics breadth first to a snapshot, only payload handles are taken and subtrees not created from
+     * the previous snapshot yet reference it, payloads are read when the file is written
+     * @param roots of the topics tree
+     * @param builder of the snapshot
+     */
+    static void writeSnapshot(QList<Topic *> roots, SnapshotBuilder &builder);
+
+    /**
+     * @brief Add memory of the topic and all created topics below it to a report
+     * @param path of the parent topic, empty for roots
+     * @param entries of the report
+     * @return bytes payloads of the subtree take after deduplication and compression
+     */
+    double reportMemory(QString path, QList<MemoryReportEntry> &entries);
+
 private:
     /**
      * @brief topic of the topic
@@ -79,13 +235,58 @@ private:
     /**
      * @brief List of messages
      */
-    QList<std::string *> messages;
+    QList<Message *> messages;
+
+    /**
+     * @brief Statistics of the topic
+     */
+    TopicStatistics statistics;
+
+    /**
+     * @brief Statistics of the topic and all topics below it, updated by every message of the subtree
+     */
+    TopicStatistics subtreeStatistics;
+
+    /**
+     * @brief Memory held by the topic
+     */
+    TopicMemory memory;
+
+    /**
+     * @brief Memory held by the topic and all topics below it
+     */
+    TopicMemory subtreeMemory;
+
+    /**
+     * @brief Parent topic, nullptr for roots
+     */
+    Topic *parent = nullptr;
+
+    /**
+     * @brief Item showing the topic in the tree view
+     */
+    QTreeWidgetItem *treeItem = nullptr;
+
+    /**
+     * @brief Numeric values parsed from payloads, by field path
+     */
+    QMap<QString, TimeSeries> series;
 
     /**
      * @brief List of children (subtopics)
      */
     QList<Topic *> children;
 
+    /**
+     * @brief Snapshot the children are still in, nullptr once they were created
+     */
+    const TopicSnapshot *snapshot = nullptr;
+
+    /**
+     * @brief Index of the topic in the snapshot
+     */
+    int snapshotIndex = -1;
+
     /**
      * @brief Add topic to children
      * @param topic to add
@@ -93,10 +294,99 @@ private:
     void addChild(Topic *topic);
 
     /**
-     * @brief Get all children
-     * @return list of children
+     * @brief Create children from the snapshot, does nothing when they were created already
      */
-    QList<Topic *> &getChildren();
+    void materialize();
+
+    /**
+     * @brief Add last payloads of a topic of the snapshot and all topics below it to an export without creating them
+     * @param snapshot the topic is in
+     * @param index of the topic
+     * @param path of the parent topic
+     * @param history to add to, holding payloads
+     */
+    static void exportSnapshot(const TopicSnapshot *snapshot, int index, QString path, HistoryExport &history);
+
+    /**
+     * @brief Add change of memory to the topic and to subtree memory of all its ancestors
+     * @param delta of memory, negative when memory was freed
+     */
+    void accountMemory(const TopicMemory &delta);
+
+    /**
+     * @brief Delete the oldest message in history
+     */
+    void deleteOldestMessage();
+};
+
+class TopicTreeItem : public QTreeWidgetItem
+{
+public:
+    /**
+     * @brief Columns of the topics tree
+     */
+    enum Column
+    {
+        NameColumn,
+        MessagesColumn,
+        RateColumn,
+        PayloadMinColumn,
+        PayloadAverageColumn,
+        PayloadMaxColumn,
+        LastSeenColumn
+    };
+
+    /**
+     * @brief Root item of the topics tree view
+     * @param view to add the item to
+     * @param topic shown by the item
+     */
+    TopicTreeItem(QTreeWidget *view, Topic *topic);
+
+    /**
+     * @brief Item of the topics tree view
+     * @param parent to add the item to
+     * @param topic shown by the item
+     */
+    TopicTreeItem(QTreeWidgetItem *parent, Topic *topic);
+
+    /**
+     * @brief Detach the item from its topic
+     */
+    ~TopicTreeItem() override;
+
+    /**
+     * @brief Get topic shown by the item
+     * @return topic
+     */
+    Topic *getTopic();
+
+    /**
+     * @brief Update statistics columns from the subtree statistics of the topic
+     * @param now in milliseconds since epoch, rates are decayed to it
+     */
+    void refresh(qint64 now);
+
+    /**
+     * @brief Compare by the sort column, statistics columns compare as numbers
+     * @param other item
+     * @return true when this item goes first in ascending order
+     */
+    bool operator<(const QTreeWidgetItem &other) const override;
+
+private:
+    /**
+     * @brief Topic shown by the item
+     */
+    Topic *topic;
+
+    /**
+     * @brief Set text and numeric sort key of a column
+     * @param column to set
+     * @param text shown
+     * @param key used for sorting
+     */
+    void setColumn(int column, QString text, double key);
 };
 
 class MainWindow : public QMainWindow
@@ -108,11 +398,48 @@ public:
     ~MainWindow();
 
     /**
-     * @brief Function that is called when new message is received in the Paho client callback, updates UI with the new message
+     * @brief Function that is called when new message is received in the Paho client callback, queues the message for a worker thread
+     * @param connection is name of the connection the message was received on, used as root of the topic in the tree
      * @param topic is the topic of the message
-     * @param message is the message's conetnt (payload)
+     * @param message is the received message, ownership is taken over
+     */
+    void newMessage(QString connection, QString topic, Message *message);
+
+    /**
+     * @brief Get number of received messages waiting to be processed
+     * @return number of messages
+     */
+    int getQueuedMessageCount();
+
+    /**
+     * @brief Set ingest policies of topics
+     * @param rules are pairs of topic filter and policy, the first matching rule applies
+     */
+    void setIngestPolicies(QList<QPair<TopicFilter, IngestPolicy>> rules);
+
+    /**
+     * @brief Get counters of ingest policies
+     * @return counters, topics no rule matches last
+     */
+    QList<IngestStatistics> getIngestStatistics();
+
+    /**
+     * @brief Set number of threads preparing received messages
+     * @param threadCount is number of threads, topics are sharded among them
+     */
+    void setIngestThreadCount(int threadCount);
+
+    /**
+     * @brief Get number of threads preparing received messages
+     * @return number of threads
      */
-    void newMessage(QString topic, std::string payload);
+    int getIngestThreadCount();
+
+    /**
+     * @brief Record time from arrival of every message until it is inserted into the topics tree, used by the benchmark
+     * @param latencies in nanoseconds are appended to on the GUI thread, nullptr stops recording
+     */
+    void setInsertLatencies(QVector<qint64> *latencies);
 
     /**
      * @brief Topics filter
@@ -120,10 +447,17 @@ public:
     QString topicsFilter = "";
 
     /**
-     * @brief Forwards msg to all dashboard widgets with the same topic
+     * @brief Forwards msg to all dashboard widgets with the same topic, called in the Paho client callback
+     * @param connection the message was received on, messages of connections other than the selected one are ignored
      * @param msg message received from MQTT broker
      */
-    void messageHandler(mqtt::const_message_ptr msg);
+    void messageHandler(const QString &connection, mqtt::const_message_ptr msg);
+
+    /**
+     * @brief Restore topics tree and dashboard from the snapshot file and save the snapshot periodically
+     * @param path of the snapshot file, the restored file is moved next to it with suffix ".restored" while it is mapped
+     */
+    void enableSnapshots(QString path);
 
 public slots:
     /**
@@ -136,6 +470,11 @@ public slots:
      */
     void on_widgetTextButton_clicked();
 
+    /**
+     * @brief Process queued messages until the queue is empty or the time for one batch runs out
+     */
+    void drainIngestQueue();
+
 private slots:
     /**
      * @brief Subscibe to a topic
@@ -147,6 +486,44 @@ private slots:
      */
     void on_subscribeResetButton_clicked();
 
+    /**
+     * @brief Show topics matching the text as it is typed
+     * @param text typed to the finder
+     */
+    void on_topicFinderTextField_textChanged(const QString &text);
+
+    /**
+     * @brief Select the best matching topic
+     */
+    void on_topicFinderTextField_returnPressed();
+
+    /**
+     * @brief Select the topic of the activated result
+     * @param item that was activated
+     */
+    void on_topicFinderList_itemActivated(QListWidgetItem *item);
+
+    /**
+     * @brief Search captured payloads by words or regular expression
+     */
+    void on_searchButton_clicked();
+
+    /**
+     * @brief Search when Enter is pressed in the search field
+     */
+    void on_searchTextField_returnPressed();
+
+    /**
+     * @brief Show results of a regular expression search
+     */
+    void regexSearchFinished();
+
+    /**
+     * @brief Select topic of the search result in the tree
+     * @param item that was double clicked
+     */
+    void on_searchResultsList_itemDoubleClicked(QListWidgetItem *item);
+
     /**
      * @brief Inspect value in a modal window
      */
@@ -173,6 +550,30 @@ private slots:
      */
     void on_publishFileButton_clicked();
 
+    /**
+     * @brief Disconnect from the server selected in connections
+     */
+    void on_disconnectButton_clicked();
+
+    /**
+     * @brief Switch dashboard widgets to the selected connection
+     * @param text is name of the connection
+     */
+    void on_connectionsBox_currentTextChanged(const QString &text);
+
+    /**
+     * @brief Show progress of file publishing
+     * @param bytesPublished so far
+     * @param bytesTotal to publish
+     */
+    void filePublishProgress(qint64 bytesPublished, qint64 bytesTotal);
+
+    /**
+     * @brief Reset file publishing controls and report errors
+     * @param error description, empty on success
+     */
+    void filePublishFinished(QString error);
+
     /**
      * @brief Connect to or disconnect from server (MQTT broker)
      */
@@ -183,16 +584,145 @@ private slots:
      */
     void on_treeWidget_itemSelectionChanged();
 
+    /**
+     * @brief Add items of topics restored from the snapshot when their parent is expanded
+     * @param item that was expanded
+     */
+    void on_treeWidget_itemExpanded(QTreeWidgetItem *item);
+
     /**
      * @brief MainWindow::on_numberOfMessagesSetButton_clicked
      */
     void on_numberOfMessagesSetButton_clicked();
 
+    /**
+     * @brief Apply maximum number of publishes in flight
+     * @param value is the size of the in-flight window
+     */
+    void on_inFlightWindowSpinBox_valueChanged(int value);
+
+    /**
+     * @brief Apply publish timeout
+     * @param value is the timeout in seconds
+     */
+    void on_publishTimeoutSpinBox_valueChanged(int value);
+
+    /**
+     * @brief Apply rules choosing payload decoder by topic
+     */
+    void on_decoderRulesApplyButton_clicked();
+
+    /**
+     * @brief Load payload decoder plugins from a directory
+     */
+    void on_decoderPluginsLoadButton_clicked();
+
+    /**
+     * @brief Apply rules choosing numeric JSON fields stored as series
+     */
+    void on_numericFieldsApplyButton_clicked();
+
+    /**
+     * @brief Apply ingest policies of topics
+     */
+    void on_ingestPoliciesApplyButton_clicked();
+
+    /**
+     * @brief Show counters of ingest policies
+     */
+    void refreshIngestStatistics();
+
+    /**
+     * @brief Update statistics columns of visible items of the tree view
+     */
+    void refreshTopicStatistics();
+
+    /**
+     * @brief Remove a slice of topics that expired, the sweep continues where it stopped next time
+     */
+    void sweepExpiredTopics();
+
+    /**
+     * @brief Apply time after which topics that receive no message are removed
+     * @param value is the time in seconds, 0 disables expiry
+     */
+    void on_topicExpirySpinBox_valueChanged(int value);
+
+    /**
+     * @brief Compile and apply alert rules
+     */
+    void on_alertRulesApplyButton_clicked();
+
+    /**
+     * @brief Raise alerts whose time came, show new alerts and publish them
+     */
+    void checkAlerts();
+
+    /**
+     * @brief Apply rules of the bridge between connections
+     */
+    void on_bridgeRulesApplyButton_clicked();
+
+    /**
+     * @brief Show counters of bridge rules
+     */
+    void refreshBridgeStatistics();
+
+    /**
+     * @brief Pass current series to chart widgets, they repaint only when the series changed
+     */
+    void refreshCharts();
+
+    /**
+     * @brief Show connection state and counters of the publish pipeline in the status bar
+     */
+    void refreshPublishStatistics();
+
+    /**
+     * @brief Write snapshot of the topics tree and dashboard in the background
+     */
+    void saveSnapshot();
+
+    /**
+     * @brief Report snapshot that could not be written
+     */
+    void snapshotSaveFinished();
+
     /**
      * @brief Export captured data to disk
      */
     void on_exportButton_clicked();
 
+    /**
+     * @brief Start or stop recording of trace spans
+     */
+    void on_traceCheckBox_toggled(bool checked);
+
+    /**
+     * @brief Write recorded trace spans in the background
+     */
+    void on_traceSaveButton_clicked();
+
+    /**
+     * @brief Report trace that was written or failed
+     */
+    void traceSaveFinished();
+
+    /**
+     * @brief Show how many rows of the running export were written
+     */
+    void refreshExportProgress();
+
+    /**
+     * @brief Report export that was written or failed
+     */
+    void historyExportFinished();
+
+    /**
+     * @brief Show memory held by subtrees of topics
+     */
+    void on_memoryReportButton_clicked();
+
     /**
      * @brief Run or stop simulator
      */
@@ -212,15 +742,145 @@ private:
     Ui::MainWindow *ui;
 
     /**
-     * @brief MQTT client handler
+     * @brief MQTT client handlers, one for every connected server
      */
-    MqttHandler *mqttHandler = nullptr;
+    QList<MqttHandler *> mqttHandlers;
+
+    /**
+     * @brief Publisher of files, runs on a worker thread
+     */
+    FilePublisher *filePublisher = nullptr;
+
+    /**
+     * @brief Messages received on the MQTT client threads waiting to be processed on the GUI thread
+     */
+    IngestQueue ingestQueue;
+
+    /**
+     * @brief Latencies of inserted messages, nullptr when they are not recorded
+     */
+    QVector<qint64> *insertLatencies = nullptr;
+
+    /**
+     * @brief Topics of dashboard widgets, read on the MQTT client threads
+     */
+    QSet<QString> dashboardTopics;
+
+    /**
+     * @brief Connection selected in settings, dashboard widgets show and publish only its topics
+     */
+    QString dashboardConnection;
+
+    /**
+     * @brief Protects dashboardTopics and dashboardConnection
+     */
+    QMutex dashboardTopicsMutex;
+
+    /**
+     * @brief Extracts numeric values from payloads into series of topics
+     */
+    NumericExtractor numericExtractor;
+
+    /**
+     * @brief Index of known topics for the topic finder
+     */
+    TopicFinder topicFinder;
+
+    /**
+     * @brief Index of retained payloads for search
+     */
+    SearchIndex searchIndex;
+
+    /**
+     * @brief Evaluates alert rules over received messages
+     */
+    AlertEngine alertEngine;
+
+    /**
+     * @brief Forwards subtrees of connections to other connections
+     */
+    TopicBridge topicBridge;
+
+    /**
+     * @brief Threads extracting numeric values and indexing messages before they are queued, destroyed before what they use
+     */
+    IngestWorkers ingestWorkers;
+
+    /**
+     * @brief Watches regular expression search in progress
+     */
+    QFutureWatcher<SearchHit> regexSearch;
+
+    /**
+     * @brief Payload decoders used by value inspect dialog
+     */
+    DecoderRegistry decoderRegistry;
 
     /**
      * @brief Tree of topics (backend model)
      */
     QList<Topic *> topicsTree;
 
+    /**
+     * @brief Snapshot the topics tree was restored from, topics read their children from it
+     */
+    TopicSnapshot *snapshot = nullptr;
+
+    /**
+     * @brief Time after which topics that receive no message are removed in milliseconds, 0 when they never expire
+     */
+    qint64 topicExpiry = 0;
+
+    /**
+     * @brief Runs sweeps of expired topics while expiry is enabled
+     */
+    QTimer *expiryTimer = nullptr;
+
+    /**
+     * @brief Topics whose children the sweep checks next
+     */
+    QList<Topic *> expirySweep;
+
+    /**
+     * @brief Path of the snapshot file, empty when snapshots are disabled
+     */
+    QString snapshotPath;
+
+    /**
+     * @brief Watches snapshot being written
+     */
+    QFutureWatcher<QString> snapshotSave;
+
+    /**
+     * @brief Set when the last snapshot was not saved, so the error dialog is not shown again until a save succeeds
+     */
+    bool snapshotFailed = false;
+
+    /**
+     * @brief Watches trace being written
+     */
+    QFutureWatcher<QString> traceSave;
+
+    /**
+     * @brief Watches history being exported to a CSV or columnar file
+     */
+    QFutureWatcher<QString> historyExport;
+
+    /**
+     * @brief Number of rows the running export wrote so far, updated by the exporting thread
+     */
+    QAtomicInteger<qint64> historyExportWritten;
+
+    /**
+     * @brief Number of rows of the running export
+     */
+    qint64 historyExportRows = 0;
+
+    /**
+     * @brief Adding topics restored from the snapshot to the topic finder
+     */
+    QFuture<void> snapshotIndexing;
+
     /**
      * @brief Number of messages stored in hisotry for each topic
      */
@@ -231,20 +891,46 @@ private:
      */
     Simulator *simulator = nullptr;
 
+    /**
+     * @brief Do work of a message that needs no GUI state, called on the worker thread of its topic
+     * @param queued message, its topic path and samples are filled in
+     */
+    void prepareMessage(QueuedMessage &queued);
+
+    /**
+     * @brief Add prepared message to the topics tree and the tree view
+     * @param queued message, ownership of the message is taken over
+     * @return topic the message was added to
+     */
+    Topic *processMessage(const QueuedMessage &queued);
+
+    /**
+     * @brief Get connection selected in the settings, used for publishing, dashboard and simulator
+     * @return MQTT handler of the connection or nullptr when not connected
+     */
+    MqttHandler *activeConnection();
+
+    /**
+     * @brief Find connection by its name
+     * @param name of the connection (address:port)
+     * @return MQTT handler of the connection or nullptr if not found
+     */
+    MqttHandler *findConnection(QString name);
+
     /**
      * @brief Add root item to tree
-     * @param title of the item
+     * @param topic shown by the item
      * @return Root item that was created and added to the QTreeWidget
      */
-    QTreeWidgetItem * treeViewAddRootItem(QString name);
+    QTreeWidgetItem * treeViewAddRootItem(Topic *topic);
 
     /**
      * @brief Add item to the parent
      * @param parent to add item to
-     * @param title of the item
+     * @param topic shown by the item
      * @return The item that was created and added to the parent
      */
-    QTreeWidgetItem * treeViewAddItem(QTreeWidgetItem *parent, QString name);
+    QTreeWidgetItem * treeViewAddItem(QTreeWidgetItem *parent, Topic *topic);
 
     /**
      * @brief Get path to currently selected item in tree view
@@ -259,11 +945,50 @@ private:
      */
     Topic *treeViewFindTopic(QStringList path);
 
+    /**
+     * @brief Select item at the path in tree view
+     * @param path is the path to the item
+     */
+    void treeViewSelectPath(QStringList path);
+
+    /**
+     * @brief Fill search results list with hits whose messages are still in history
+     * @param hits of the search
+     */
+    void showSearchHits(QList<SearchHit> hits);
+
+    /**
+     * @brief Collect topics tree and dashboard layout for a snapshot
+     * @return snapshot ready to be written
+     */
+    SnapshotBuilder createSnapshot();
+
     /**
      * @brief Fills value history list with values related to the currently selected item in tree widget
      */
     void refreshValuesList();
 
+    /**
+     * @brief Creates dashboard widget in the first free container
+     * @param type of the widget (switch, display, text or chart)
+     * @param name name of dashboard widget
+     * @param topic topic that is received by widget
+     * @param field path of the JSON field charted by chart widgets
+     */
+    void addDashboardWidget(QString type, QString name, QString topic, QString field);
+
+    /**
+     * @brief Get layout of the dashboard
+     * @return JSON array of widgets
+     */
+    QByteArray dashboardToJson();
+
+    /**
+     * @brief Create dashboard widgets from a layout
+     * @param json is array of widgets
+     */
+    void dashboardFromJson(QByteArray json);
+
     /**
      * @brief Creates dashboard widget for displaying switch state in interface
      * @param interface pointer to widget container
@@ -288,6 +1013,26 @@ private:
      */
     void createText(QWidget *interface, QString name, QString topic);
 
+    /**
+     * @brief Creates dashboard widget for charting numeric values of a topic
+     * @param interface pointer to widget container
+     * @param name name of dashboard widget
+     * @param topic topic whose series is charted
+     * @param field path of the JSON field, empty for plain number payloads
+     */
+    void createChart(QWidget *interface, QString name, QString topic, QString field);
+
+    /**
+     * @brief Forwards msg to all dashboard widgets with the same topic
+     * @param msg message received from MQTT broker
+     */
+    void dashboardMessage(mqtt::const_message_ptr msg);
+
+    /**
+     * @brief Update topics of dashboard widgets after a widget was added or removed
+     */
+    void refreshDashboardTopics();
+
     /**
      * @brief Changes state of switch depending on received msg
      * @param msg message receiver from mqtt broker
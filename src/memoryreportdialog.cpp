@@ -0,0 +1,127 @@
+/**
+ * @file memoryreportdialog.cpp
+ * @brief Implementation of dialog reporting memory held by subtrees of topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "memoryreportdialog.h"
+#include "ui_memoryreportdialog.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QSaveFile>
+#include <QTextStream>
+#include <algorithm>
+
+/**
+ * @brief Number of heaviest subtrees shown in the table, the saved report has all of them
+ */
+const int MEMORY_REPORT_ROWS = 200;
+
+/**
+ * @brief Item of the table sorted by a number instead of its text
+ */
+class MemoryReportItem : public QTableWidgetItem
+{
+public:
+    MemoryReportItem(QString text, qint64 value) : QTableWidgetItem(text) { setData(Qt::UserRole, value); }
+
+    bool operator<(const QTableWidgetItem &other) const override
+    {
+        return data(Qt::UserRole).toLongLong() < other.data(Qt::UserRole).toLongLong();
+    }
+};
+
+/**
+ * @brief Format number of bytes for people
+ * @param bytes to format
+ * @return e.g. "1.5 MiB"
+ */
+static QString formatBytes(qint64 bytes)
+{
+    if (bytes < 1024)
+        return QString("%1 B").arg(bytes);
+    if (bytes < 1024 * 1024)
+        return QString("%1 KiB").arg(bytes / 1024.0, 0, 'f', 1);
+
+    return QString("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+
+MemoryReportDialog::MemoryReportDialog(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::MemoryReportDialog)
+{
+    ui->setupUi(this);
+}
+
+
+MemoryReportDialog::~MemoryReportDialog()
+{
+    delete ui;
+}
+
+
+void MemoryReportDialog::setEntries(QList<MemoryReportEntry> entries, QString summary)
+{
+    std::sort(entries.begin(), entries.end(), [](const MemoryReportEntry &a, const MemoryReportEntry &b) {
+        return a.subtree.total() > b.subtree.total();
+    });
+
+    this->entries = entries;
+    this->summary = summary;
+
+    ui->summaryLabel->setText(summary);
+
+    auto table = ui->tableWidget;
+    table->setSortingEnabled(false);
+    table->setRowCount(std::min(entries.length(), MEMORY_REPORT_ROWS));
+
+    for (int row = 0; row < table->rowCount(); row++)
+    {
+        auto &entry = entries.at(row);
+
+        table->setItem(row, 0, new QTableWidgetItem(entry.path));
+        table->setItem(row, 1, new MemoryReportItem(formatBytes(entry.subtree.total()), entry.subtree.total()));
+        table->setItem(row, 2, new MemoryReportItem(formatBytes(entry.subtree.payloadBytes), entry.subtree.payloadBytes));
+        table->setItem(row, 3, new MemoryReportItem(formatBytes(entry.subtreeStoredPayloadBytes), entry.subtreeStoredPayloadBytes));
+        table->setItem(row, 4, new MemoryReportItem(QString::number(entry.subtree.historyEntries), entry.subtree.historyEntries));
+        table->setItem(row, 5, new MemoryReportItem(formatBytes(entry.subtree.seriesBytes), entry.subtree.seriesBytes));
+        table->setItem(row, 6, new MemoryReportItem(formatBytes(entry.subtree.overheadBytes), entry.subtree.overheadBytes));
+        table->setItem(row, 7, new MemoryReportItem(formatBytes(entry.own.total()), entry.own.total()));
+    }
+
+    table->setSortingEnabled(true);
+    table->sortByColumn(1, Qt::DescendingOrder);
+    table->resizeColumnsToContents();
+}
+
+
+void MemoryReportDialog::on_saveButton_clicked()
+{
+    auto path = QFileDialog::getSaveFileName(this, "Save memory report", QString(), "Tab separated values (*.tsv)");
+    if (path.isEmpty())
+        return;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QMessageBox::warning(this, "Save failed", file.errorString());
+        return;
+    }
+
+    QTextStream stream(&file);
+    stream << "# " << summary << "\n";
+    stream << "topic\tsubtree_bytes\tpayload_logical_bytes\tpayload_stored_bytes\thistory_entries\tseries_bytes\toverhead_bytes\town_bytes\n";
+    for (auto &entry : entries)
+    {
+        stream << entry.path << "\t" << entry.subtree.total() << "\t" << entry.subtree.payloadBytes << "\t"
+               << entry.subtreeStoredPayloadBytes << "\t" << entry.subtree.historyEntries << "\t" << entry.subtree.seriesBytes << "\t"
+               << entry.subtree.overheadBytes << "\t" << entry.own.total() << "\n";
+    }
+    stream.flush();
+
+    if (!file.commit())
+        QMessageBox::warning(this, "Save failed", file.errorString());
+}
@@ -0,0 +1,82 @@
+/**
+ * @file memoryreportdialog.h
+ * @brief Header file for dialog reporting memory held by subtrees of topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef MEMORYREPORTDIALOG_H
+#define MEMORYREPORTDIALOG_H
+
+#include "topicstatistics.h"
+
+#include <QDialog>
+#include <QList>
+#include <QString>
+
+namespace Ui {
+class MemoryReportDialog;
+}
+
+/**
+ * @brief Memory of one topic in the report
+ */
+struct MemoryReportEntry
+{
+    /**
+     * @brief Path of the topic starting with the connection
+     */
+    QString path;
+
+    /**
+     * @brief Memory held by the topic itself
+     */
+    TopicMemory own;
+
+    /**
+     * @brief Memory held by the topic and all topics below it
+     */
+    TopicMemory subtree;
+
+    /**
+     * @brief Bytes payloads of the subtree take after deduplication and compression, payloadBytes of subtree are logical bytes
+     */
+    qint64 subtreeStoredPayloadBytes = 0;
+};
+
+class MemoryReportDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryReportDialog(QWidget *parent = nullptr);
+    ~MemoryReportDialog();
+
+    /**
+     * @brief Set topics to report, the heaviest subtrees are shown
+     * @param entries of all topics
+     * @param summary shown above the table
+     */
+    void setEntries(QList<MemoryReportEntry> entries, QString summary);
+
+private slots:
+    /**
+     * @brief Write the whole report to a file chosen by the user
+     */
+    void on_saveButton_clicked();
+
+private:
+    Ui::MemoryReportDialog *ui;
+
+    /**
+     * @brief Entries of all topics, heaviest subtrees first
+     */
+    QList<MemoryReportEntry> entries;
+
+    /**
+     * @brief Summary of the whole report
+     */
+    QString summary;
+};
+
+#endif // MEMORYREPORTDIALOG_H
@@ -0,0 +1,120 @@
+/**
+ * @file message.cpp
+ * @brief Implementation of message class
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "message.h"
+#include "payloadpreview.h"
+
+#include <QDateTime>
+#include <atomic>
+
+/**
+ * @brief Identifier of the next message
+ */
+static std::atomic<quint64> nextMessageId(1);
+
+
+Message::Message(std::string payload)
+    : id(nextMessageId++), payload(std::make_shared<PayloadHandle>(PayloadStore::global().intern(std::move(payload)))), timestamp(QDateTime::currentMSecsSinceEpoch()) {}
+
+
+Message::Message(std::string payload, qint64 timestamp)
+    : id(nextMessageId++), payload(std::make_shared<PayloadHandle>(PayloadStore::global().intern(std::move(payload)))), timestamp(timestamp) {}
+
+
+Message::Message(mqtt::const_message_ptr msg)
+    : id(nextMessageId++), payload(std::make_shared<PayloadHandle>(PayloadStore::global().intern(msg->get_payload()))), timestamp(QDateTime::currentMSecsSinceEpoch())
+{
+    auto &properties = msg->get_properties();
+
+    if (properties.contains(mqtt::property::MESSAGE_EXPIRY_INTERVAL))
+        expiryInterval = static_cast<quint32>(mqtt::get<int>(properties, mqtt::property::MESSAGE_EXPIRY_INTERVAL));
+
+    for (size_t i = 0; i < properties.count(mqtt::property::USER_PROPERTY); i++)
+    {
+        auto property = mqtt::get<mqtt::string_pair>(properties, mqtt::property::USER_PROPERTY, i);
+        userProperties.append(qMakePair(QString::fromStdString(std::get<0>(property)), QString::fromStdString(std::get<1>(property))));
+    }
+}
+
+
+quint64 Message::getId() { return id; }
+
+
+std::shared_ptr<const std::string> Message::getSharedPayload() { return payload->get(); }
+
+
+std::shared_ptr<PayloadHandle> Message::getPayloadHandle() { return payload; }
+
+
+PayloadClass Message::getPayloadClass()
+{
+    if (payloadClass.kind == PayloadKind::Unknown)
+        payloadClass = PayloadClassifier::classify(*payload->get());
+
+    return payloadClass;
+}
+
+
+void Message::setPayloadClass(const PayloadClass &payloadClass) { this->payloadClass = payloadClass; }
+
+
+QString Message::getPreview()
+{
+    if (preview.isNull())
+        preview = PayloadPreview::create(*payload->get(), getPayloadClass());
+
+    return preview;
+}
+
+
+size_t Message::getPayloadLength() { return payload->length(); }
+
+
+size_t Message::getOverhead()
+{
+    auto overhead = sizeof(Message) + sizeof(PayloadHandle);
+    for (int i = 0; i < userProperties.length(); i++)
+        overhead += sizeof(QPair<QString, QString>) + (userProperties.at(i).first.size() + userProperties.at(i).second.size()) * sizeof(QChar);
+
+    return overhead;
+}
+
+
+qint64 Message::getTimestamp() { return timestamp; }
+
+
+qint64 Message::getExpiryInterval() { return expiryInterval; }
+
+
+bool Message::isExpired()
+{
+    if (expiryInterval < 0)
+        return false;
+
+    return QDateTime::currentMSecsSinceEpoch() > timestamp + expiryInterval * 1000;
+}
+
+
+QList<QPair<QString, QString>> &Message::getUserProperties() { return userProperties; }
+
+
+QString Message::describe()
+{
+    auto text = QString("Received: ").append(QDateTime::fromMSecsSinceEpoch(timestamp).toString(Qt::ISODateWithMs));
+
+    if (expiryInterval >= 0)
+    {
+        text.append(QString("\nExpiry interval: %1 s").arg(expiryInterval));
+        if (isExpired())
+            text.append(" (expired)");
+    }
+
+    for (int i = 0; i < userProperties.length(); i++)
+        text.append("\n").append(userProperties.at(i).first).append(": ").append(userProperties.at(i).second);
+
+    return text;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file message.h
+ * @brief Header file for message class
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include "payloadclassifier.h"
+#include "payloadstore.h"
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <mqtt/message.h>
+#include <memory>
+#include <string>
+
+class Message
+{
+public:
+    /**
+     * @brief Message class represents a message stored in topic's history
+     * @param payload of the message
+     */
+    Message(std::string payload);
+
+    /**
+     * @brief Create message received earlier, used for messages restored from a snapshot
+     * @param payload of the message
+     * @param timestamp is time of arrival in milliseconds since epoch
+     */
+    Message(std::string payload, qint64 timestamp);
+
+    /**
+     * @brief Create message from a received MQTT message, MQTT v5 properties are kept
+     * @param msg is the received message
+     */
+    Message(mqtt::const_message_ptr msg);
+
+    /**
+     * @brief Get unique identifier of the message
+     * @return identifier
+     */
+    quint64 getId();
+
+    /**
+     * @brief Get payload shared with the message, stays valid when the message is removed from history
+     * @return payload, decompressed when the message is in cold history
+     */
+    std::shared_ptr<const std::string> getSharedPayload();
+
+    /**
+     * @brief Get handle of the payload, used to move the payload to cold history
+     * @return handle
+     */
+    std::shared_ptr<PayloadHandle> getPayloadHandle();
+
+    /**
+     * @brief Get class of the payload, set at ingest, payloads of other messages are classified on the first call
+     * @return class of the payload
+     */
+    PayloadClass getPayloadClass();
+
+    /**
+     * @brief Set class of the payload, called by ingest workers before the message is added to history
+     * @param payloadClass of the payload
+     */
+    void setPayloadClass(const PayloadClass &payloadClass);
+
+    /**
+     * @brief Get short preview of the payload, created on the first call and kept
+     * @return text prefix or hex of the beginning of the payload
+     */
+    QString getPreview();
+
+    /**
+     * @brief Get length of the payload without decompressing it
+     * @return length in bytes
+     */
+    size_t getPayloadLength();
+
+    /**
+     * @brief Get memory held by the message besides its payload
+     * @return bytes
+     */
+    size_t getOverhead();
+
+    /**
+     * @brief Get time when the message was received
+     * @return milliseconds since epoch
+     */
+    qint64 getTimestamp();
+
+    /**
+     * @brief Get message expiry interval set by the publisher (MQTT v5)
+     * @return expiry interval in seconds or -1 when the message doesn't expire
+     */
+    qint64 getExpiryInterval();
+
+    /**
+     * @brief Check whether the message expiry interval elapsed since the message was received
+     * @return true when expired, otherwise false
+     */
+    bool isExpired();
+
+    /**
+     * @brief Get user properties set by the publisher (MQTT v5)
+     * @return list of key and value pairs
+     */
+    QList<QPair<QString, QString>> &getUserProperties();
+
+    /**
+     * @brief Get description of message metadata (time of arrival, expiry, user properties)
+     * @return human readable description
+     */
+    QString describe();
+
+private:
+    /**
+     * @brief Unique identifier of the message
+     */
+    quint64 id;
+
+    /**
+     * @brief Payload of the message, the content is shared with messages with identical payload
+     */
+    std::shared_ptr<PayloadHandle> payload;
+
+    /**
+     * @brief Time of arrival in milliseconds since epoch
+     */
+    qint64 timestamp;
+
+    /**
+     * @brief Class of the payload, kind is Unknown until it is classified
+     */
+    PayloadClass payloadClass;
+
+    /**
+     * @brief Preview of the payload, null until it is needed
+     */
+    QString preview;
+
+    /**
+     * @brief Expiry interval in seconds, -1 when the message doesn't expire
+     */
+    qint64 expiryInterval = -1;
+
+    /**
+     * @brief User properties
+     */
+    QList<QPair<QString, QString>> userProperties;
+};
+
+#endif // MESSAGE_H
@@ -7,66 +7,128 @@
  */
 
 #include "mqtthandler.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "mainwindow.h"
+#include <QRandomGenerator>
 
 // Part of the code in this file was inspired by the official Paho library example:
 // https://github.com/eclipse/paho.mqtt.cpp/blob/master/src/samples/async_subscribe.cpp
 
-const int	N_RETRY_ATTEMPTS = 5;
+/**
+ * @brief Delay before the first reconnect attempt
+ */
+const int RECONNECT_BASE_DELAY_MS = 500;
+
+/**
+ * @brief Maximum delay between reconnect attempts
+ */
+const int RECONNECT_MAX_DELAY_MS = 60000;
 
 /////////////////////////////////////////////////////////////////////////////
 
 void callback::reconnect()
 {
-    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
-    try {
-        client.connect(connectOptions, nullptr, *this);
-    }
-    catch (const mqtt::exception& exc) {
-        std::cerr << "Error: " << exc.what() << std::endl;
-        exit(1);
-    }
+    // Reconnects are scheduled by the handler, the client's thread must not be blocked
+    if (handler != nullptr)
+        handler->scheduleReconnect();
 }
 
 
 void callback::on_failure(const mqtt::token& tok)
 {
-    if (++nretry_ > N_RETRY_ATTEMPTS)
-        exit(1);
     reconnect();
 }
 
 
-void callback::on_success(const mqtt::token& tok) {}
+void callback::on_success(const mqtt::token& tok)
+{
+    if (handler == nullptr || tok.get_type() != mqtt::token::Type::CONNECT)
+        return;
+
+    // Limits announced by the broker in CONNACK (MQTT v5), MQTT 3.1.1 has none
+    auto response = tok.get_connect_response();
+    auto &properties = response.get_properties();
+
+    int receiveMaximum = 65535;
+    if (properties.contains(mqtt::property::RECEIVE_MAXIMUM))
+        receiveMaximum = mqtt::get<int>(properties, mqtt::property::RECEIVE_MAXIMUM);
+
+    int topicAliasMaximum = 0;
+    if (properties.contains(mqtt::property::TOPIC_ALIAS_MAXIMUM))
+        topicAliasMaximum = mqtt::get<int>(properties, mqtt::property::TOPIC_ALIAS_MAXIMUM);
+
+    handler->connectionAccepted(receiveMaximum, topicAliasMaximum);
+}
 
 
 void callback::connected(const std::string& cause)
-{    
+{
+    // Aliases are valid only within a single network connection
+    topicAliases.clear();
+
+    if (handler == nullptr)
+        return;
+
+    // Persistent sessions subscribe with QoS 1 so that the broker queues messages while we're away
+    int qos = handler->getSettings().persistentSession ? 1 : 0;
+
     // Subscribe to control topic
-    client.subscribe("$SYS/#", 0);
+    client.subscribe("$SYS/#", qos);
     // And all other topic (non-control topics)
-    client.subscribe("#", 0);
+    client.subscribe(handler->getSubscriptionFilter(), qos);
+
+    handler->connectionEstablished();
 }
 
 
 void callback::connection_lost(const std::string& cause)
 {
-    nretry_ = 0;
     reconnect();
 }
 
 
 void callback::message_arrived(mqtt::const_message_ptr msg)
 {
+    TRACE_SCOPE("message arrival");
+
     if (mainWindow == nullptr)
         return;
 
+    auto &properties = msg->get_properties();
+    if (properties.contains(mqtt::property::TOPIC_ALIAS))
+    {
+        // The broker sends the topic with the first use of an alias, later messages carry only the alias
+        int alias = mqtt::get<int>(properties, mqtt::property::TOPIC_ALIAS);
+        if (!msg->get_topic().empty())
+        {
+            topicAliases[alias] = msg->get_topic();
+        }
+        else
+        {
+            auto it = topicAliases.find(alias);
+            if (it == topicAliases.end())
+            {
+                std::cerr << "Error: message with unknown topic alias " << alias << " dropped" << std::endl;
+                return;
+            }
+
+            auto resolved = std::make_shared<mqtt::message>(*msg);
+            resolved->set_topic(it->second);
+            msg = resolved;
+        }
+    }
+
     // Widgets callback
-    mainWindow->messageHandler(msg);
+    mainWindow->messageHandler(connectionName, msg);
 
     if (!mainWindow->topicsFilter.isEmpty())
     {
+        TRACE_SCOPE("topic filter");
+
         // Process message only if the topic is accepted
         auto expectedTopicPath = mainWindow->topicsFilter.split("/");
         auto messageTopicPath = QString::fromStdString(msg->get_topic()).split("/");
@@ -83,52 +145,447 @@ void callback::message_arrived(mqtt::const_message_ptr msg)
     }
 
     // Explorer's callback
-    mainWindow->newMessage(QString().fromStdString(msg->get_topic()), msg->get_payload());
+    mainWindow->newMessage(connectionName, QString().fromStdString(msg->get_topic()), new Message(msg));
 }
 
 
 void callback::delivery_complete(mqtt::delivery_token_ptr token) {}
 
 
-callback::callback(mqtt::async_client& cli, mqtt::connect_options& connOpts, MainWindow *mainWindow)
-            : nretry_(0), client(cli), connectOptions(connOpts), mainWindow(mainWindow) {}
+callback::callback(mqtt::async_client& cli, mqtt::connect_options& connOpts, MainWindow *mainWindow, MqttHandler *handler)
+            : client(cli), connectOptions(connOpts), mainWindow(mainWindow), handler(handler),
+              connectionName(QString::fromStdString(cli.get_server_uri())) {}
+
+/////////////////////////////////////////////////////////////////////////////
+
+
+PublishListener::PublishListener(MqttHandler &handler) : handler(handler) {}
+
+
+void PublishListener::on_failure(const mqtt::token& tok)
+{
+    handler.completePublish(reinterpret_cast<uintptr_t>(tok.get_user_context()), PublishStatus::Failed);
+    handler.submitPending();
+}
+
+
+void PublishListener::on_success(const mqtt::token& tok)
+{
+    handler.completePublish(reinterpret_cast<uintptr_t>(tok.get_user_context()), PublishStatus::Acknowledged);
+    handler.submitPending();
+}
 
 /////////////////////////////////////////////////////////////////////////////
 
 
-MqttHandler::MqttHandler(QString address, QString port, QString clientId, MainWindow *mainWindow)
-    : client(QString(address).append(":").append(port).toStdString(), clientId.toStdString()), cb(client, connOpts, mainWindow)
+MqttHandler::MqttHandler(QString address, QString port, QString clientId, MainWindow *mainWindow, ConnectionSettings settings)
+    : settings(settings), publishListener(*this),
+      client(QString(address).append(":").append(port).toStdString(), clientId.toStdString(), mqtt::create_options(settings.mqttV5 ? MQTTVERSION_5 : MQTTVERSION_DEFAULT)),
+      cb(client, connOpts, mainWindow, this)
 {
     this->address = address;
     this->port = port;
+    this->settings.offlineQueueLimit = std::max(0, settings.offlineQueueLimit);
 
     client.set_callback(cb);
 
-    connOpts.set_clean_session(true);
+    if (settings.mqttV5)
+    {
+        // Session expiry replaces clean session in MQTT v5, persistent sessions are kept for a day
+        mqtt::properties properties {
+            { mqtt::property::RECEIVE_MAXIMUM, std::max(1, settings.receiveMaximum) },
+            { mqtt::property::TOPIC_ALIAS_MAXIMUM, std::max(0, settings.topicAliasMaximum) },
+            { mqtt::property::SESSION_EXPIRY_INTERVAL, settings.persistentSession ? 86400 : 0 }
+        };
+
+        connOpts = mqtt::connect_options_builder()
+                .mqtt_version(MQTTVERSION_5)
+                .clean_start(!settings.persistentSession)
+                .properties(properties)
+                .finalize();
+    }
+    else
+    {
+        connOpts.set_clean_session(!settings.persistentSession);
+    }
+
+    connect(&publishTimeoutTimer, &QTimer::timeout, this, &MqttHandler::expirePublishes);
+    publishTimeoutTimer.start(250);
+
+    reconnectTimer.setSingleShot(true);
+    connect(&reconnectTimer, &QTimer::timeout, this, &MqttHandler::reconnect);
+
+    reconnect();
+}
+
+
+MqttHandler::~MqttHandler()
+{
+    publishTimeoutTimer.stop();
+    reconnectTimer.stop();
 
     try {
-        client.connect(connOpts, nullptr, cb);
+        if (client.is_connected())
+            client.disconnect()->wait_for(std::chrono::milliseconds(500));
     }
     catch (const mqtt::exception& exc) {
         std::cerr << "Error: " << exc.what() << std::endl;
+    }
+
+    // Nobody is going to complete the remaining publishes anymore
+    std::vector<PendingPublish> unfinished;
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        for (auto &entry : inFlight)
+            unfinished.push_back(entry.second);
+        unfinished.insert(unfinished.end(), publishQueue.begin(), publishQueue.end());
+        inFlight.clear();
+        publishQueue.clear();
+    }
+    publishFinished.notify_all();
+
+    for (auto &pending : unfinished)
+    {
+        if (pending.onComplete)
+            pending.onComplete(PublishStatus::Failed);
+    }
+}
+
+
+quint64 MqttHandler::publishMessage(QString topic, std::string message, int qos, bool retained, PublishCallback onComplete)
+{
+    auto msg = mqtt::make_message(topic.toStdString(), mqtt::binary_ref(std::move(message)), qos, retained);
+    return enqueuePublish(msg, onComplete);
+}
+
+
+quint64 MqttHandler::publishMessage(QString topic, const char *payload, size_t length, int qos, bool retained, PublishCallback onComplete)
+{
+    auto msg = mqtt::make_message(topic.toStdString(), payload, length, qos, retained);
+    return enqueuePublish(msg, onComplete);
+}
+
+
+quint64 MqttHandler::enqueuePublish(mqtt::message_ptr message, PublishCallback onComplete)
+{
+    PendingPublish pending;
+    pending.message = message;
+    pending.onComplete = onComplete;
+
+    std::vector<PendingPublish> dropped;
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        queuePublish(pending, dropped);
+    }
+
+    for (auto &droppedPublish : dropped)
+    {
+        if (droppedPublish.onComplete)
+            droppedPublish.onComplete(PublishStatus::Dropped);
+    }
+
+    submitPending();
+    return pending.id;
+}
+
+
+void MqttHandler::publishMessages(const std::vector<mqtt::message_ptr> &messages)
+{
+    std::vector<PendingPublish> dropped;
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        for (auto &message : messages)
+        {
+            PendingPublish pending;
+            pending.message = message;
+            queuePublish(pending, dropped);
+        }
+    }
+
+    for (auto &droppedPublish : dropped)
+    {
+        if (droppedPublish.onComplete)
+            droppedPublish.onComplete(PublishStatus::Dropped);
+    }
+
+    submitPending();
+}
+
+
+void MqttHandler::queuePublish(PendingPublish &pending, std::vector<PendingPublish> &dropped)
+{
+    pending.id = nextPublishId++;
+
+    // While disconnected the queue is bounded, the oldest publishes give way to new ones
+    if (!client.is_connected())
+    {
+        while (!publishQueue.empty() && static_cast<int>(publishQueue.size()) >= settings.offlineQueueLimit)
+        {
+            dropped.push_back(publishQueue.front());
+            publishQueue.pop_front();
+            statistics.dropped++;
+        }
+    }
+
+    if (client.is_connected() || settings.offlineQueueLimit > 0)
+    {
+        publishQueue.push_back(pending);
+    }
+    else
+    {
+        dropped.push_back(pending);
+        statistics.dropped++;
+    }
+}
+
+
+bool MqttHandler::waitForPendingBelow(int count, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(publishMutex);
+    return publishFinished.wait_for(lock, timeout, [this, count]()
+    {
+        return static_cast<int>(publishQueue.size() + inFlight.size()) < count;
+    });
+}
+
+
+void MqttHandler::submitPending()
+{
+    // Only one thread submits at a time so that messages reach the client in queue order, which
+    // topic aliases depend on, the submitting thread picks up whatever others queued meanwhile
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        if (submitting)
+            return;
+        submitting = true;
+    }
+
+    while (true)
+    {
+        // Take as many queued publishes as the window allows and submit them outside of the lock,
+        // the client may call the listener from its own thread while we're submitting
+        std::vector<PendingPublish> batch;
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+
+            // Publishes made while disconnected wait in the queue until the connection is back
+            int window = std::min(inFlightWindow, serverReceiveMaximum);
+            while (client.is_connected() && !publishQueue.empty() && static_cast<int>(inFlight.size()) < window)
+            {
+                auto pending = publishQueue.front();
+                publishQueue.pop_front();
+
+                applyTopicAlias(pending.message);
+
+                pending.submitted = std::chrono::steady_clock::now();
+                inFlight[pending.id] = pending;
+                batch.push_back(pending);
+            }
+
+            if (batch.empty())
+            {
+                submitting = false;
+                return;
+            }
+        }
+
+        for (auto &pending : batch)
+        {
+            try {
+                client.publish(pending.message, reinterpret_cast<void *>(static_cast<uintptr_t>(pending.id)), publishListener);
+            }
+            catch (const mqtt::exception& exc) {
+                std::cerr << "Error: " << exc.what() << std::endl;
+                completePublish(pending.id, PublishStatus::Failed);
+            }
+        }
+    }
+}
+
+
+void MqttHandler::applyTopicAlias(mqtt::message_ptr message)
+{
+    if (serverTopicAliasMaximum <= 0)
+        return;
+
+    // The first message on a topic sets up the alias, following ones are sent without the topic. QoS 1 and 2
+    // messages keep it, the client resends them after a reconnect when the aliases of the old connection are gone
+    auto topic = message->get_topic();
+    auto it = topicAliases.find(topic);
+    if (it != topicAliases.end())
+    {
+        if (message->get_qos() == 0)
+            message->set_topic("");
+        message->set_properties(mqtt::properties { { mqtt::property::TOPIC_ALIAS, it->second } });
+    }
+    else if (static_cast<int>(topicAliases.size()) < serverTopicAliasMaximum)
+    {
+        int alias = static_cast<int>(topicAliases.size()) + 1;
+        topicAliases[topic] = alias;
+        message->set_properties(mqtt::properties { { mqtt::property::TOPIC_ALIAS, alias } });
+    }
+}
+
+
+void MqttHandler::completePublish(quint64 id, PublishStatus status)
+{
+    PublishCallback onComplete;
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+
+        // Already expired
+        auto it = inFlight.find(id);
+        if (it == inFlight.end())
+            return;
+
+        onComplete = it->second.onComplete;
+        inFlight.erase(it);
+
+        if (status == PublishStatus::Acknowledged)
+            statistics.acknowledged++;
+        else if (status == PublishStatus::Failed)
+            statistics.failed++;
+        else
+            statistics.timedOut++;
+    }
+
+    publishFinished.notify_all();
+
+    if (onComplete)
+        onComplete(status);
+}
+
+
+void MqttHandler::expirePublishes()
+{
+    std::vector<quint64> expired;
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto &entry : inFlight)
+        {
+            if (now - entry.second.submitted > publishTimeout)
+                expired.push_back(entry.first);
+        }
+    }
+
+    if (expired.empty())
         return;
+
+    for (auto id : expired)
+        completePublish(id, PublishStatus::TimedOut);
+
+    submitPending();
+}
+
+
+void MqttHandler::setInFlightWindow(int size)
+{
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        inFlightWindow = std::max(1, size);
     }
+
+    submitPending();
+}
+
+
+void MqttHandler::setPublishTimeout(int milliseconds)
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+    publishTimeout = std::chrono::milliseconds(std::max(1, milliseconds));
 }
 
 
-void MqttHandler::publishMessage(QString topic, std::string message)
+PublishStatistics MqttHandler::getPublishStatistics()
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+
+    auto result = statistics;
+    result.queued = publishQueue.size();
+    result.inFlight = inFlight.size();
+    return result;
+}
+
+
+void MqttHandler::scheduleReconnect()
+{
+    int attempt = reconnectAttempt++;
+
+    // Exponential backoff with jitter, the delay is drawn from the upper half of the backoff window
+    // so that clients disconnected by the same failover don't come back at the same moment
+    int backoff = std::min(RECONNECT_MAX_DELAY_MS, RECONNECT_BASE_DELAY_MS << std::min(attempt, 10));
+    int delay = backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1);
+
+    // Called from the client's thread, the timer belongs to the handler's thread
+    QMetaObject::invokeMethod(this, [this, delay]() { reconnectTimer.start(delay); }, Qt::QueuedConnection);
+}
+
+
+void MqttHandler::connectionEstablished()
+{
+    reconnectAttempt = 0;
+
+    {
+        // Aliases are valid only within a single network connection
+        std::lock_guard<std::mutex> lock(publishMutex);
+        topicAliases.clear();
+    }
+
+    // Flush publishes queued while offline
+    submitPending();
+}
+
+
+void MqttHandler::connectionAccepted(int receiveMaximum, int topicAliasMaximum)
+{
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        serverReceiveMaximum = std::max(1, receiveMaximum);
+        serverTopicAliasMaximum = settings.mqttV5 ? topicAliasMaximum : 0;
+        topicAliases.clear();
+    }
+
+    submitPending();
+}
+
+
+const ConnectionSettings &MqttHandler::getSettings() { return settings; }
+
+
+std::string MqttHandler::getSubscriptionFilter()
+{
+    if (settings.sharedGroup.isEmpty())
+        return "#";
+
+    // Subscribers in the same group split the messages among themselves
+    return QString("$share/").append(settings.sharedGroup).append("/#").toStdString();
+}
+
+
+void MqttHandler::reconnect()
 {
     try {
-        client.publish(topic.toStdString(), message.data(), message.length(), 0, false);
+        client.connect(connOpts, nullptr, cb);
     }
     catch (const mqtt::exception& exc) {
         std::cerr << "Error: " << exc.what() << std::endl;
+        scheduleReconnect();
     }
 }
 
 
+bool MqttHandler::isConnected() { return client.is_connected(); }
+
+
+int MqttHandler::getReconnectAttempt() { return reconnectAttempt; }
+
+
+QString MqttHandler::getName() { return QString(address).append(":").append(port); }
+
+
 QString MqttHandler::getAddress() { return this->address; }
 
 
 QString MqttHandler::getPort() { return this->port; }
-
@@ -9,9 +9,20 @@
 #define MQTTHANDLER_H
 
 #include <qstring.h>
+#include <QObject>
+#include <QTimer>
 #include <mqtt/async_client.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
 
 class MainWindow;
+class MqttHandler;
 
 
 // Part of the code in this file was inspired by the official Paho library example:
@@ -19,11 +30,6 @@ class MainWindow;
 
 class callback : public virtual mqtt::callback, public virtual mqtt::iaction_listener
 {
-    /**
-     * @brief Number of reconnect retries
-     */
-    int nretry_;
-
     /**
      * @brief Paho MQTT async client
      */
@@ -39,6 +45,21 @@ class callback : public virtual mqtt::callback, public virtual mqtt::iaction_lis
      */
     MainWindow *mainWindow;
 
+    /**
+     * @brief Handler which schedules reconnects and is told about established connections, may be nullptr
+     */
+    MqttHandler *handler;
+
+    /**
+     * @brief Name of the connection (server URI), root of received topics in the explorer
+     */
+    QString connectionName;
+
+    /**
+     * @brief Topic aliases set up by the broker for this connection (MQTT v5)
+     */
+    std::map<int, std::string> topicAliases;
+
     /**
      * @brief Callback for when reconnect is needed
      */
@@ -86,28 +107,243 @@ public:
      * @param cli is client instance
      * @param connOpts are client connection options
      * @param mainWindow is a pointer to MainWindow object on which a callback function is called when new message is received
+     * @param handler is a pointer to MqttHandler owning the client, reconnects are scheduled through it
+     */
+    callback(mqtt::async_client& cli, mqtt::connect_options& connOpts, MainWindow *mainWindow, MqttHandler *handler = nullptr);
+};
+
+/**
+ * @brief Options of a connection to a broker
+ */
+struct ConnectionSettings
+{
+    /**
+     * @brief Broker keeps the session and queues messages while the client is disconnected
+     */
+    bool persistentSession = false;
+
+    /**
+     * @brief Maximum number of publishes queued while disconnected
+     */
+    int offlineQueueLimit = 1000;
+
+    /**
+     * @brief Connect with MQTT v5 instead of 3.1.1
+     */
+    bool mqttV5 = false;
+
+    /**
+     * @brief Number of unacknowledged QoS 1 and 2 messages the broker may send at once (MQTT v5)
+     */
+    int receiveMaximum = 100;
+
+    /**
+     * @brief Number of topic aliases the broker may use when sending messages (MQTT v5)
+     */
+    int topicAliasMaximum = 100;
+
+    /**
+     * @brief Group of the shared subscription, empty for an ordinary subscription
+     */
+    QString sharedGroup;
+};
+
+/**
+ * @brief Final state of a published message
+ */
+enum class PublishStatus
+{
+    Acknowledged,
+    Failed,
+    TimedOut,
+    Dropped
+};
+
+/**
+ * @brief Counters of the publish pipeline
+ */
+struct PublishStatistics
+{
+    /**
+     * @brief Messages waiting for a free slot in the in-flight window
+     */
+    quint64 queued = 0;
+
+    /**
+     * @brief Messages submitted to the client and waiting for completion
+     */
+    quint64 inFlight = 0;
+
+    /**
+     * @brief Messages confirmed by the broker (or sent, for QoS 0)
+     */
+    quint64 acknowledged = 0;
+
+    /**
+     * @brief Messages the client failed to deliver
+     */
+    quint64 failed = 0;
+
+    /**
+     * @brief Messages that did not complete within the publish timeout
      */
-    callback(mqtt::async_client& cli, mqtt::connect_options& connOpts, MainWindow *mainWindow);
+    quint64 timedOut = 0;
+
+    /**
+     * @brief Messages dropped from the full offline queue
+     */
+    quint64 dropped = 0;
 };
 
-class MqttHandler
+class PublishListener : public virtual mqtt::iaction_listener
 {
+    /**
+     * @brief Handler whose publishes are tracked
+     */
+    MqttHandler &handler;
+
+    /**
+     * @brief Callback for when a publish fails
+     * @param tok is the publish token
+     */
+    void on_failure(const mqtt::token& tok) override;
+
+    /**
+     * @brief Callback for when a publish completes
+     * @param tok is the publish token
+     */
+    void on_success(const mqtt::token& tok) override;
+
 public:
+    /**
+     * @brief Listener reporting completion of publishes to the handler
+     * @param handler whose publishes are tracked
+     */
+    PublishListener(MqttHandler &handler);
+};
+
+class MqttHandler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Function called when a publish completes, fails or times out, called from the client's thread
+     */
+    typedef std::function<void(PublishStatus)> PublishCallback;
+
     /**
      * @brief Handler for MQTT interaction
      * @param address of the MQTT broker
      * @param port of the MQTT broker
      * @param clientId for the MQTT client
      * @param mainWindow is pointer to Main Window in which a callback function is called when message is received
+     * @param settings are options of the connection
      */
-    MqttHandler(QString address, QString port, QString clientId, MainWindow *mainWindow);
+    MqttHandler(QString address, QString port, QString clientId, MainWindow *mainWindow, ConnectionSettings settings = ConnectionSettings());
+    ~MqttHandler();
 
     /**
-     * @brief Publish message to a topic
+     * @brief Publish message to a topic, the message is queued and submitted once the in-flight window allows it
      * @param topic to publish to
      * @param message to publish
+     * @param qos is quality of service of the message (0, 1 or 2)
+     * @param retained is true when the broker should retain the message
+     * @param onComplete is called when the publish completes, fails or times out
+     * @return identifier of the publish
      */
-    void publishMessage(QString topic, std::string message);
+    quint64 publishMessage(QString topic, std::string message, int qos = 0, bool retained = false, PublishCallback onComplete = nullptr);
+
+    /**
+     * @brief Publish message from a memory buffer (e.g. a mapped file), the buffer is copied only into the client's message
+     * @param topic to publish to
+     * @param payload is pointer to the message data
+     * @param length of the message data
+     * @param qos is quality of service of the message (0, 1 or 2)
+     * @param retained is true when the broker should retain the message
+     * @param onComplete is called when the publish completes, fails or times out
+     * @return identifier of the publish
+     */
+    quint64 publishMessage(QString topic, const char *payload, size_t length, int qos = 0, bool retained = false, PublishCallback onComplete = nullptr);
+
+    /**
+     * @brief Publish messages in one go, they are queued under one lock and submitted together
+     * @param messages to publish in order
+     */
+    void publishMessages(const std::vector<mqtt::message_ptr> &messages);
+
+    /**
+     * @brief Wait until fewer than count publishes are queued or in flight, used to bound memory of bulk publishing
+     * @param count of publishes
+     * @param timeout of the wait
+     * @return true when fewer publishes are pending, false on timeout
+     */
+    bool waitForPendingBelow(int count, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Set maximum number of publishes waiting for completion at once
+     * @param size of the in-flight window
+     */
+    void setInFlightWindow(int size);
+
+    /**
+     * @brief Set time after which a publish without completion is counted as timed out
+     * @param milliseconds of the timeout
+     */
+    void setPublishTimeout(int milliseconds);
+
+    /**
+     * @brief Get counters of the publish pipeline
+     * @return publish statistics
+     */
+    PublishStatistics getPublishStatistics();
+
+    /**
+     * @brief Schedule a reconnect with exponential backoff and jitter, safe to call from any thread
+     */
+    void scheduleReconnect();
+
+    /**
+     * @brief Called by the client's callback when connection is established
+     */
+    void connectionEstablished();
+
+    /**
+     * @brief Called by the client's callback with limits the broker announced when accepting the connection
+     * @param receiveMaximum is number of unacknowledged publishes the broker accepts at once
+     * @param topicAliasMaximum is number of topic aliases the broker accepts from the client
+     */
+    void connectionAccepted(int receiveMaximum, int topicAliasMaximum);
+
+    /**
+     * @brief Get options of the connection
+     * @return connection settings
+     */
+    const ConnectionSettings &getSettings();
+
+    /**
+     * @brief Get topic filter the client subscribes to, a shared subscription when a group is set
+     * @return topic filter
+     */
+    std::string getSubscriptionFilter();
+
+    /**
+     * @brief Get connection status
+     * @return true when the client is connected, otherwise false
+     */
+    bool isConnected();
+
+    /**
+     * @brief Get number of failed reconnect attempts since the connection was lost
+     * @return number of attempts
+     */
+    int getReconnectAttempt();
+
+    /**
+     * @brief Get name of the connection
+     * @return address and port of the server (address:port)
+     */
+    QString getName();
 
     /**
      * @brief Get address of server that the client is connected to
@@ -122,6 +358,104 @@ public:
     QString getPort();
 
 private:
+    friend class PublishListener;
+
+    /**
+     * @brief Publish waiting in the queue or for completion
+     */
+    struct PendingPublish
+    {
+        quint64 id;
+        mqtt::message_ptr message;
+        PublishCallback onComplete;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    /**
+     * @brief Guards the publish queue, in-flight publishes and statistics
+     */
+    std::mutex publishMutex;
+
+    /**
+     * @brief Signalled whenever a publish finishes
+     */
+    std::condition_variable publishFinished;
+
+    /**
+     * @brief Publishes waiting for a free slot in the in-flight window
+     */
+    std::deque<PendingPublish> publishQueue;
+
+    /**
+     * @brief Publishes submitted to the client, by identifier
+     */
+    std::map<quint64, PendingPublish> inFlight;
+
+    /**
+     * @brief Publish statistics (queued and in-flight counts are filled on request)
+     */
+    PublishStatistics statistics;
+
+    /**
+     * @brief Identifier of the next publish
+     */
+    quint64 nextPublishId = 1;
+
+    /**
+     * @brief Maximum number of publishes in flight
+     */
+    int inFlightWindow = 64;
+
+    /**
+     * @brief Publish timeout
+     */
+    std::chrono::milliseconds publishTimeout = std::chrono::milliseconds(10000);
+
+    /**
+     * @brief Options of the connection
+     */
+    ConnectionSettings settings;
+
+    /**
+     * @brief Number of unacknowledged publishes the broker accepts, caps the in-flight window
+     */
+    int serverReceiveMaximum = 65535;
+
+    /**
+     * @brief Number of topic aliases the broker accepts, 0 disables aliasing
+     */
+    int serverTopicAliasMaximum = 0;
+
+    /**
+     * @brief Topic aliases used for publishing on the current connection
+     */
+    std::map<std::string, int> topicAliases;
+
+    /**
+     * @brief True while a thread is submitting publishes, keeps them in queue order
+     */
+    bool submitting = false;
+
+    /**
+     * @brief Number of failed reconnect attempts since the connection was lost
+     */
+    std::atomic<int> reconnectAttempt{0};
+
+    /**
+     * @brief Timer of the next reconnect attempt
+     */
+    QTimer reconnectTimer;
+
+    /**
+     * @brief Listener of publish completions
+     */
+    PublishListener publishListener;
+
+    /**
+     * @brief Timer periodically expiring publishes that did not complete in time
+     */
+    QTimer publishTimeoutTimer;
+
     /**
      * @brief Paho MQTT async client
      */
@@ -146,6 +480,50 @@ private:
      * @brief Server port
      */
     QString port;
+
+    /**
+     * @brief Queue publish of a message
+     * @param message to publish
+     * @param onComplete is called when the publish completes, fails or times out
+     * @return identifier of the publish
+     */
+    quint64 enqueuePublish(mqtt::message_ptr message, PublishCallback onComplete);
+
+    /**
+     * @brief Add publish to the queue or drop it while disconnected, call with publish mutex held
+     * @param pending publish, its identifier is assigned
+     * @param dropped publishes whose callbacks have to be called once the mutex is released
+     */
+    void queuePublish(PendingPublish &pending, std::vector<PendingPublish> &dropped);
+
+    /**
+     * @brief Replace topic of a message about to be submitted by an alias when possible (MQTT v5), only QoS 0
+     * messages are sent without the topic, call with publish mutex held
+     * @param message to submit
+     */
+    void applyTopicAlias(mqtt::message_ptr message);
+
+    /**
+     * @brief Submit queued publishes in batches while the in-flight window has room
+     */
+    void submitPending();
+
+    /**
+     * @brief Finish an in-flight publish, update statistics and notify its callback
+     * @param id of the publish
+     * @param status of the publish
+     */
+    void completePublish(quint64 id, PublishStatus status);
+
+    /**
+     * @brief Count in-flight publishes older than the publish timeout as timed out
+     */
+    void expirePublishes();
+
+    /**
+     * @brief Start connecting to the broker without waiting for the result
+     */
+    void reconnect();
 };
 
 #endif // MQTTHANDLER_H
@@ -0,0 +1,260 @@
+/**
+ * @file payloadclassifier.cpp
+ * @brief Implementation of classification of payloads deciding how they are shown, exported and decoded
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "payloadclassifier.h"
+#include "timeseries.h"
+
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PAYLOAD_CLASSIFIER_SSE2
+#endif
+
+/**
+ * @brief Maximum fraction of control characters of text payloads
+ */
+const float TEXT_MAX_CONTROL = 0.05f;
+
+/**
+ * @brief Maximum length of payloads checked for being a plain number
+ */
+const size_t NUMBER_MAX_LENGTH = 64;
+
+
+/**
+ * @brief Check whether an ASCII byte is a control character other than tab and line breaks
+ * @param c is the byte
+ * @return true when control character
+ */
+static inline bool isControl(unsigned char c)
+{
+    return (c < 0x20 && c != '\t' && c != '\n' && c != '\r') || c == 0x7f;
+}
+
+
+/**
+ * @brief Validate one character starting with a byte above 0x7f
+ * @param data of the payload
+ * @param length of the payload
+ * @param i is position of the character, moved past it
+ * @return false when the character isn't valid UTF-8
+ */
+static inline bool skipMultibyte(const unsigned char *data, size_t length, size_t &i)
+{
+    auto c = data[i];
+    size_t continuation;
+
+    if ((c & 0xe0) == 0xc0 && c >= 0xc2)
+        continuation = 1;
+    else if ((c & 0xf0) == 0xe0)
+        continuation = 2;
+    else if ((c & 0xf8) == 0xf0 && c <= 0xf4)
+        continuation = 3;
+    else
+        return false;
+
+    if (i + continuation >= length)
+        return false;
+
+    // Overlong forms, surrogates and code points above U+10FFFF are rejected by the range of the second byte
+    auto second = data[i + 1];
+    if ((c == 0xe0 && second < 0xa0) || (c == 0xed && second > 0x9f) || (c == 0xf0 && second < 0x90) || (c == 0xf4 && second > 0x8f))
+        return false;
+
+    for (size_t j = 1; j <= continuation; j++)
+    {
+        if ((data[i + j] & 0xc0) != 0x80)
+            return false;
+    }
+
+    i += continuation + 1;
+    return true;
+}
+
+
+/**
+ * @brief Check that the payload is UTF-8 without NUL characters and count its characters and control characters
+ * @param data of the payload
+ * @param length of the payload
+ * @param characters is number of characters
+ * @param controls is number of control characters
+ * @return false when not valid, counting stops there
+ */
+static bool scanText(const unsigned char *data, size_t length, size_t &characters, size_t &controls)
+{
+    size_t i = 0;
+    characters = 0;
+    controls = 0;
+
+#ifdef PAYLOAD_CLASSIFIER_SSE2
+    const auto space = _mm_set1_epi8(0x20);
+    const auto del = _mm_set1_epi8(0x7f);
+    const auto tab = _mm_set1_epi8('\t');
+    const auto lineFeed = _mm_set1_epi8('\n');
+    const auto carriageReturn = _mm_set1_epi8('\r');
+    const auto zero = _mm_setzero_si128();
+
+    while (i + 16 <= length)
+    {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+
+        // Bytes above 0x7f are negative, so the signed comparison marks them as well and they are masked out below
+        auto high = static_cast<unsigned>(_mm_movemask_epi8(bytes));
+        auto whitespace = _mm_or_si128(_mm_cmpeq_epi8(bytes, tab), _mm_or_si128(_mm_cmpeq_epi8(bytes, lineFeed), _mm_cmpeq_epi8(bytes, carriageReturn)));
+        auto control = _mm_andnot_si128(whitespace, _mm_or_si128(_mm_cmplt_epi8(bytes, space), _mm_cmpeq_epi8(bytes, del)));
+        auto controlMask = static_cast<unsigned>(_mm_movemask_epi8(control)) & ~high;
+        auto nulMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)));
+
+        // ASCII bytes before the first byte of a multibyte character are counted at once
+        auto ascii = high == 0 ? 16u : static_cast<unsigned>(qCountTrailingZeroBits(high));
+        auto asciiMask = ascii == 16 ? 0xffffu : (1u << ascii) - 1;
+
+        if ((nulMask & asciiMask) != 0)
+            return false;
+
+        controls += qPopulationCount(controlMask & asciiMask);
+        characters += ascii;
+        i += ascii;
+
+        if (ascii < 16)
+        {
+            if (!skipMultibyte(data, length, i))
+                return false;
+            characters++;
+        }
+    }
+#endif
+
+    while (i < length)
+    {
+        auto c = data[i];
+        if (c == 0)
+            return false;
+
+        if (c < 0x80)
+        {
+            if (isControl(c))
+                controls++;
+            i++;
+        }
+        else if (!skipMultibyte(data, length, i))
+            return false;
+
+        characters++;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Read little-endian 32 bit number
+ * @param data to read from
+ * @return the number
+ */
+static inline quint32 readLittleEndian32(const char *data)
+{
+    auto bytes = reinterpret_cast<const unsigned char *>(data);
+    return static_cast<quint32>(bytes[0]) | static_cast<quint32>(bytes[1]) << 8 | static_cast<quint32>(bytes[2]) << 16 | static_cast<quint32>(bytes[3]) << 24;
+}
+
+
+/**
+ * @brief Check that a payload starting with "BM" has a bitmap file header, text often starts with the same letters
+ * @param payload at least 27 bytes long
+ * @return true when the file size fits the payload and the DIB header has one of the known sizes
+ */
+static bool isBitmapHeader(const std::string &payload)
+{
+    auto fileSize = readLittleEndian32(payload.data() + 2);
+    if (fileSize > payload.length())
+        return false;
+
+    auto dibSize = readLittleEndian32(payload.data() + 14);
+    return dibSize == 12 || dibSize == 40 || dibSize == 52 || dibSize == 56 || dibSize == 108 || dibSize == 124;
+}
+
+
+bool PayloadClass::isText() const
+{
+    return kind == PayloadKind::Empty || kind == PayloadKind::Number || kind == PayloadKind::Json || kind == PayloadKind::Text;
+}
+
+
+PayloadClass PayloadClassifier::classify(const std::string &payload)
+{
+    PayloadClass result;
+
+    if (payload.empty())
+    {
+        result.kind = PayloadKind::Empty;
+        result.printable = 1;
+        return result;
+    }
+
+    // Magic bytes decide images without looking at the rest
+    result.imageFormat = imageFormat(payload);
+    if (result.imageFormat != nullptr)
+    {
+        result.kind = PayloadKind::Image;
+        return result;
+    }
+
+    size_t characters;
+    size_t controls;
+    if (!scanText(reinterpret_cast<const unsigned char *>(payload.data()), payload.length(), characters, controls)
+            || controls > characters * TEXT_MAX_CONTROL)
+    {
+        result.kind = PayloadKind::Binary;
+        return result;
+    }
+
+    result.printable = 1 - static_cast<float>(controls) / characters;
+
+    double value;
+    if (payload.length() <= NUMBER_MAX_LENGTH && NumericExtractor::parseNumber(payload, value))
+    {
+        result.kind = PayloadKind::Number;
+        return result;
+    }
+
+    // Whitespace around the document is allowed
+    size_t first = 0;
+    size_t last = payload.length() - 1;
+    while (first < last && (payload[first] == ' ' || payload[first] == '\t' || payload[first] == '\r' || payload[first] == '\n'))
+        first++;
+    while (last > first && (payload[last] == ' ' || payload[last] == '\t' || payload[last] == '\r' || payload[last] == '\n'))
+        last--;
+
+    if ((payload[first] == '{' && payload[last] == '}') || (payload[first] == '[' && payload[last] == ']'))
+        result.kind = PayloadKind::Json;
+    else
+        result.kind = PayloadKind::Text;
+
+    return result;
+}
+
+
+const char *PayloadClassifier::imageFormat(const std::string &payload)
+{
+    static const char png[] = "\x89PNG\r\n\x1a\n";
+    static const char jpeg[] = "\xff\xd8\xff";
+
+    if (payload.compare(0, 8, png, 8) == 0)
+        return "PNG";
+    if (payload.compare(0, 3, jpeg, 3) == 0)
+        return "JPG";
+    if (payload.compare(0, 6, "GIF87a") == 0 || payload.compare(0, 6, "GIF89a") == 0)
+        return "GIF";
+    if (payload.compare(0, 2, "BM") == 0 && payload.length() > 26 && isBitmapHeader(payload))
+        return "BMP";
+    if (payload.length() > 12 && payload.compare(0, 4, "RIFF") == 0 && payload.compare(8, 4, "WEBP") == 0)
+        return "WEBP";
+
+    return nullptr;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file payloadclassifier.h
+ * @brief Header file for classification of payloads deciding how they are shown, exported and decoded
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef PAYLOADCLASSIFIER_H
+#define PAYLOADCLASSIFIER_H
+
+#include <QtGlobal>
+#include <string>
+
+/**
+ * @brief Kind of a payload
+ */
+enum class PayloadKind : quint8
+{
+    Unknown,    ///< Not classified yet
+    Empty,
+    Number,     ///< Plain number
+    Json,       ///< Text enclosed in braces or brackets, not validated
+    Text,       ///< UTF-8 text with few control characters
+    Image,      ///< Starts with magic bytes of an image format
+    Binary      ///< Anything else
+};
+
+/**
+ * @brief Result of classifying a payload
+ */
+struct PayloadClass
+{
+    PayloadKind kind = PayloadKind::Unknown;
+
+    /**
+     * @brief Format of images as used by QImageReader ("PNG", "JPG", "GIF", "BMP", "WEBP"), nullptr otherwise
+     */
+    const char *imageFormat = nullptr;
+
+    /**
+     * @brief Fraction of printable characters of text payloads, 0 for binary and image payloads
+     */
+    float printable = 0;
+
+    /**
+     * @brief Check whether the payload is UTF-8 text that can be shown as is
+     * @return true for empty, number, JSON and text payloads
+     */
+    bool isText() const;
+};
+
+class PayloadClassifier
+{
+public:
+    /**
+     * @brief Classify payload in one pass, UTF-8 validity and control characters are checked 16 bytes at a time
+     * with SSE2 where available, binary payloads usually stop the pass at their first bytes
+     * @param payload to classify
+     * @return class of the payload
+     */
+    static PayloadClass classify(const std::string &payload);
+
+    /**
+     * @brief Get image format from magic bytes at the beginning of a payload
+     * @param payload to check
+     * @return format as used by QImageReader or nullptr when the payload doesn't look like an image
+     */
+    static const char *imageFormat(const std::string &payload);
+};
+
+#endif // PAYLOADCLASSIFIER_H
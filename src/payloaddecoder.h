@@ -0,0 +1,72 @@
+/**
+ * @file payloaddecoder.h
+ * @brief Interface of payload decoders, implemented by built-in decoders and decoder plugins
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef PAYLOADDECODER_H
+#define PAYLOADDECODER_H
+
+#include <QImage>
+#include <QString>
+#include <QtPlugin>
+#include <string>
+
+/**
+ * @brief Result of decoding a payload
+ */
+struct DecodedPayload
+{
+    /**
+     * @brief Name of the decoder that produced the result
+     */
+    QString decoder;
+
+    /**
+     * @brief True when the payload was decoded, otherwise text describes the error
+     */
+    bool ok = false;
+
+    /**
+     * @brief Textual representation of the payload
+     */
+    QString text;
+
+    /**
+     * @brief Image representation of the payload, null when the payload isn't an image
+     */
+    QImage image;
+};
+
+class PayloadDecoder
+{
+public:
+    virtual ~PayloadDecoder() {}
+
+    /**
+     * @brief Get name of the decoder shown to the user and used in decoder rules
+     * @return name
+     */
+    virtual QString getName() const = 0;
+
+    /**
+     * @brief Cheaply check whether the payload looks like data the decoder understands, used for sniffing
+     * @param payload to check
+     * @return true when the decoder should be used for the payload, otherwise false
+     */
+    virtual bool accepts(const std::string &payload) const = 0;
+
+    /**
+     * @brief Decode the payload, called from worker threads so it must not touch the GUI
+     * @param payload to decode
+     * @return decoded payload
+     */
+    virtual DecodedPayload decode(const std::string &payload) const = 0;
+};
+
+#define PayloadDecoder_iid "cz.vutbr.fit.ICP.PayloadDecoder/1.0"
+
+Q_DECLARE_INTERFACE(PayloadDecoder, PayloadDecoder_iid)
+
+#endif // PAYLOADDECODER_H
@@ -0,0 +1,65 @@
+/**
+ * @file payloadpreview.cpp
+ * @brief Implementation of short previews of payloads shown in lists
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "payloadpreview.h"
+
+#include <QByteArray>
+#include <algorithm>
+
+/**
+ * @brief Number of bytes read for text previews, enough for the characters even when all of them take 4 bytes
+ */
+const size_t PREVIEW_TEXT_BYTES = PREVIEW_CHARACTERS * 4;
+
+
+QString PayloadPreview::create(const std::string &payload, const PayloadClass &payloadClass)
+{
+    auto length = payload.length();
+    auto prefixLength = std::min(length, PREVIEW_TEXT_BYTES);
+
+    if (payloadClass.kind == PayloadKind::Image)
+        return QString("%1 image (%2 bytes)").arg(payloadClass.imageFormat).arg(length);
+
+    if (payloadClass.isText())
+    {
+        auto text = QString::fromUtf8(payload.data(), static_cast<int>(prefixLength));
+        bool truncated = prefixLength < length;
+
+        // A character split at the end of the prefix decodes to a replacement character
+        if (truncated && text.endsWith(QChar(QChar::ReplacementCharacter)))
+            text.chop(1);
+
+        if (text.length() > PREVIEW_CHARACTERS)
+        {
+            text.truncate(PREVIEW_CHARACTERS);
+            truncated = true;
+        }
+
+        // Items of lists have one line
+        for (auto &c : text)
+        {
+            if (c == '\n' || c == '\r' || c == '\t')
+                c = ' ';
+        }
+
+        if (truncated)
+            text.append(QString("... (%1 bytes)").arg(length));
+
+        return text;
+    }
+
+    auto hexLength = std::min(length, static_cast<size_t>(PREVIEW_HEX_BYTES));
+    auto hex = QByteArray::fromRawData(payload.data(), static_cast<int>(hexLength)).toHex(' ');
+
+    auto preview = QString::fromLatin1(hex);
+    if (hexLength < length)
+        preview.append(" ...");
+    preview.append(QString(" (%1 bytes, binary)").arg(length));
+
+    return preview;
+}
+
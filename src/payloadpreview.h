@@ -0,0 +1,39 @@
+/**
+ * @file payloadpreview.h
+ * @brief Header file for short previews of payloads shown in lists
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef PAYLOADPREVIEW_H
+#define PAYLOADPREVIEW_H
+
+#include "payloadclassifier.h"
+
+#include <QString>
+#include <string>
+
+/**
+ * @brief Maximum number of characters of a preview before the note about its length
+ */
+const int PREVIEW_CHARACTERS = 200;
+
+/**
+ * @brief Number of bytes of binary payloads shown in hex
+ */
+const int PREVIEW_HEX_BYTES = 32;
+
+class PayloadPreview
+{
+public:
+    /**
+     * @brief Create preview of a payload, only its beginning is read, text is shown on one line, images by their format
+     * and binary data in hex
+     * @param payload to preview
+     * @param payloadClass decides how the payload is shown
+     * @return preview of bounded length
+     */
+    static QString create(const std::string &payload, const PayloadClass &payloadClass);
+};
+
+#endif // PAYLOADPREVIEW_H
@@ -0,0 +1,263 @@
+/**
+ * @file payloadstore.cpp
+ * @brief Implementation of store of payloads deduplicating identical payloads and compressing cold history
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "payloadstore.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief Maximum size of cached decompressed blocks in bytes
+ */
+const int DECOMPRESSED_CACHE_SIZE = 8 * 1024 * 1024;
+
+/**
+ * @brief Maximum size of payloads of a block before compression, blocks have to fit in the cache many times
+ */
+const int COLD_BLOCK_MAX_SIZE = 1024 * 1024;
+
+/**
+ * @brief Payloads larger than this stay hot, compressing them alone saves little and costs a lot on every access
+ */
+const size_t COLD_PAYLOAD_MAX_SIZE = 64 * 1024;
+
+/**
+ * @brief Minimum number of payloads interned between sweeps of expired payloads
+ */
+const int PAYLOAD_SWEEP_INTERVAL = 4096;
+
+
+PayloadHandle::PayloadHandle(std::shared_ptr<const std::string> payload) : hot(payload), size(payload->length()) {}
+
+
+std::shared_ptr<const std::string> PayloadHandle::get() const
+{
+    // The block is set before the hot payload is released, so one of them is always there
+    auto payload = std::atomic_load(&hot);
+    if (payload != nullptr)
+        return payload;
+
+    auto cold = std::atomic_load(&block);
+    auto data = PayloadStore::global().decompress(*cold);
+
+    return std::make_shared<const std::string>(data.constData() + offset, size);
+}
+
+
+size_t PayloadHandle::length() const { return size; }
+
+
+bool PayloadHandle::isCold() const { return std::atomic_load(&block) != nullptr; }
+
+
+bool PayloadHandle::isSettled() const { return settled; }
+
+
+double PayloadHandle::storedBytes() const
+{
+    auto cold = std::atomic_load(&block);
+    if (cold != nullptr)
+        return cold->handleBytes > 0 ? static_cast<double>(cold->data.size()) * size / cold->handleBytes : 0;
+
+    // The local copy is one of the owners, the others are handles sharing the payload
+    auto payload = std::atomic_load(&hot);
+    auto owners = payload.use_count() - 1;
+
+    return owners > 0 ? static_cast<double>(size) / owners : static_cast<double>(size);
+}
+
+
+PayloadStore::PayloadStore()
+{
+    decompressed.setMaxCost(DECOMPRESSED_CACHE_SIZE);
+
+    // One thread keeps compression off the GUI thread without taking more than a core
+    pool.setMaxThreadCount(1);
+}
+
+
+PayloadStore &PayloadStore::global()
+{
+    static PayloadStore store;
+    return store;
+}
+
+
+std::shared_ptr<const std::string> PayloadStore::intern(std::string payload)
+{
+    auto hash = std::hash<std::string>()(payload);
+
+    QMutexLocker locker(&mutex);
+
+    for (auto found = payloads.find(hash); found != payloads.end() && found.key() == hash; ++found)
+    {
+        auto stored = found.value().lock();
+        if (stored != nullptr && *stored == payload)
+        {
+            statistics.deduplicated++;
+            statistics.deduplicatedBytes += payload.length();
+            return stored;
+        }
+    }
+
+    auto stored = std::make_shared<const std::string>(std::move(payload));
+    payloads.insert(hash, stored);
+
+    // Sweeping visits every payload, so it is done less often as the store grows
+    if (++internedSinceSweep >= std::max(PAYLOAD_SWEEP_INTERVAL, payloads.size()))
+        sweep();
+
+    return stored;
+}
+
+
+void PayloadStore::compressLater(const QList<std::shared_ptr<PayloadHandle>> &handles)
+{
+    QList<std::shared_ptr<PayloadHandle>> compressible;
+    for (auto &handle : handles)
+    {
+        handle->settled = true;
+        if (handle->length() <= COLD_PAYLOAD_MAX_SIZE)
+            compressible.append(handle);
+    }
+
+    if (compressible.isEmpty())
+        return;
+
+    QtConcurrent::run(&pool, [this, compressible]() { compress(compressible); });
+}
+
+
+void PayloadStore::keepHot(const std::shared_ptr<PayloadHandle> &handle) { handle->settled = true; }
+
+
+void PayloadStore::compress(const QList<std::shared_ptr<PayloadHandle>> &handles)
+{
+    // Deduplicated payloads are stored once, every handle sharing them points to the same offset
+    QList<std::shared_ptr<const std::string>> unique;
+    QHash<const std::string *, QList<std::shared_ptr<PayloadHandle>>> users;
+
+    for (auto &handle : handles)
+    {
+        auto payload = std::atomic_load(&handle->hot);
+        if (payload == nullptr)
+            continue;
+
+        auto &payloadUsers = users[payload.get()];
+        if (payloadUsers.isEmpty())
+            unique.append(payload);
+        payloadUsers.append(handle);
+    }
+
+    QList<std::shared_ptr<PayloadHandle>> moved;
+    QList<int> offsets;
+    QByteArray raw;
+
+    for (auto &payload : unique)
+    {
+        auto &payloadUsers = users[payload.get()];
+
+        // Payload still used by messages outside of the block would be kept twice, hot and in the block,
+        // it is referenced once by unique and once by every handle of the block otherwise
+        if (payload.use_count() > payloadUsers.length() + 1)
+            continue;
+
+        if (!raw.isEmpty() && raw.size() + payload->length() > static_cast<size_t>(COLD_BLOCK_MAX_SIZE))
+        {
+            storeBlock(raw, moved, offsets);
+            moved.clear();
+            offsets.clear();
+            raw.clear();
+        }
+
+        for (auto &handle : payloadUsers)
+        {
+            moved.append(handle);
+            offsets.append(raw.size());
+        }
+        raw.append(payload->data(), static_cast<int>(payload->length()));
+    }
+
+    if (!moved.isEmpty())
+        storeBlock(raw, moved, offsets);
+}
+
+
+void PayloadStore::storeBlock(const QByteArray &raw, const QList<std::shared_ptr<PayloadHandle>> &moved, const QList<int> &offsets)
+{
+    // Payloads of one topic tend to be alike, so compressing them together works much better than one by one
+    auto block = std::make_shared<ColdBlock>();
+    auto compressed = qCompress(raw);
+    block->compressed = compressed.size() < raw.size();
+    block->data = block->compressed ? compressed : raw;
+    for (auto &handle : moved)
+        block->handleBytes += static_cast<qint64>(handle->size);
+
+    {
+        QMutexLocker locker(&mutex);
+        block->id = nextBlockId++;
+        statistics.compressedPayloads += moved.length();
+        statistics.compressedInputBytes += raw.size();
+        statistics.compressedOutputBytes += block->data.size();
+    }
+
+    std::shared_ptr<const ColdBlock> shared = block;
+    for (int i = 0; i < moved.length(); i++)
+    {
+        moved.at(i)->offset = offsets.at(i);
+        std::atomic_store(&moved.at(i)->block, shared);
+        std::atomic_store(&moved.at(i)->hot, std::shared_ptr<const std::string>());
+    }
+}
+
+
+QByteArray PayloadStore::decompress(const ColdBlock &block)
+{
+    if (!block.compressed)
+        return block.data;
+
+    {
+        QMutexLocker locker(&mutex);
+        auto cached = decompressed.object(block.id);
+        if (cached != nullptr)
+            return *cached;
+    }
+
+    // Decompression runs outside of the lock, two threads may decompress the same block at worst
+    auto data = qUncompress(block.data);
+
+    QMutexLocker locker(&mutex);
+    decompressed.insert(block.id, new QByteArray(data), data.size());
+
+    return data;
+}
+
+
+PayloadStoreStatistics PayloadStore::getStatistics()
+{
+    QMutexLocker locker(&mutex);
+
+    auto result = statistics;
+    result.uniquePayloads = payloads.size();
+
+    return result;
+}
+
+
+void PayloadStore::sweep()
+{
+    internedSinceSweep = 0;
+
+    for (auto payload = payloads.begin(); payload != payloads.end();)
+    {
+        if (payload.value().expired())
+            payload = payloads.erase(payload);
+        else
+            ++payload;
+    }
+}
@@ -0,0 +1,250 @@
+/**
+ * @file payloadstore.h
+ * @brief Header file for store of payloads deduplicating identical payloads and compressing cold history
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef PAYLOADSTORE_H
+#define PAYLOADSTORE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Payloads of several messages compressed together
+ */
+struct ColdBlock
+{
+    /**
+     * @brief Unique identifier of the block, used as key of the cache of decompressed blocks
+     */
+    quint64 id = 0;
+
+    /**
+     * @brief Concatenated payloads, compressed when it made them smaller
+     */
+    QByteArray data;
+
+    /**
+     * @brief True when data is compressed
+     */
+    bool compressed = false;
+
+    /**
+     * @brief Sum of lengths of payloads of all handles pointing into the block, shared payloads counted for every handle
+     */
+    qint64 handleBytes = 0;
+};
+
+class PayloadHandle
+{
+public:
+    /**
+     * @brief Payload of one message, either held as is (hot) or as a part of a compressed block (cold)
+     * @param payload shared with other messages with the same content
+     */
+    explicit PayloadHandle(std::shared_ptr<const std::string> payload);
+
+    /**
+     * @brief Get the payload, cold payloads are decompressed
+     * @return payload
+     */
+    std::shared_ptr<const std::string> get() const;
+
+    /**
+     * @brief Get length of the payload without decompressing it
+     * @return length in bytes
+     */
+    size_t length() const;
+
+    /**
+     * @brief Check whether the payload was moved to a compressed block
+     * @return true when cold
+     */
+    bool isCold() const;
+
+    /**
+     * @brief Check whether the payload was handed to the store, it is then either compressed or kept hot for good
+     * @return true when handed to the store
+     */
+    bool isSettled() const;
+
+    /**
+     * @brief Get share of the memory the payload takes, deduplicated payloads and cold blocks are split among their handles
+     * @return estimate in bytes, shares of all handles add up to the memory of the store
+     */
+    double storedBytes() const;
+
+private:
+    friend class PayloadStore;
+
+    /**
+     * @brief Payload while hot, released once the block is set
+     */
+    std::shared_ptr<const std::string> hot;
+
+    /**
+     * @brief Block the payload is stored in while cold
+     */
+    std::shared_ptr<const ColdBlock> block;
+
+    /**
+     * @brief Offset of the payload in the decompressed block
+     */
+    int offset = 0;
+
+    /**
+     * @brief Length of the payload
+     */
+    size_t size;
+
+    /**
+     * @brief Set once the payload was handed to the store, read and written on the GUI thread only
+     */
+    bool settled = false;
+};
+
+/**
+ * @brief Memory statistics of the payload store
+ */
+struct PayloadStoreStatistics
+{
+    /**
+     * @brief Number of distinct hot payloads
+     */
+    int uniquePayloads = 0;
+
+    /**
+     * @brief Number of payloads that were found in the store instead of being stored again
+     */
+    quint64 deduplicated = 0;
+
+    /**
+     * @brief Bytes saved by deduplication
+     */
+    quint64 deduplicatedBytes = 0;
+
+    /**
+     * @brief Number of payloads moved to compressed blocks
+     */
+    quint64 compressedPayloads = 0;
+
+    /**
+     * @brief Bytes of payloads before they were moved to blocks
+     */
+    quint64 compressedInputBytes = 0;
+
+    /**
+     * @brief Bytes of the blocks
+     */
+    quint64 compressedOutputBytes = 0;
+};
+
+class PayloadStore
+{
+public:
+    /**
+     * @brief Get the store shared by all connections
+     * @return store
+     */
+    static PayloadStore &global();
+
+    /**
+     * @brief Get payload with the content, stored payload is reused when there is one
+     * @param payload to store
+     * @return payload shared with other messages with the same content
+     */
+    std::shared_ptr<const std::string> intern(std::string payload);
+
+    /**
+     * @brief Move hot payloads to compressed blocks on a thread of the store, called on the GUI thread
+     * @param handles of payloads to move, large payloads and payloads shared with messages outside of them stay hot
+     */
+    void compressLater(const QList<std::shared_ptr<PayloadHandle>> &handles);
+
+    /**
+     * @brief Keep payload hot for good, used for payloads that don't compress (images and other binary data)
+     * @param handle of the payload
+     */
+    void keepHot(const std::shared_ptr<PayloadHandle> &handle);
+
+    /**
+     * @brief Get decompressed content of a block, recently used blocks are cached
+     * @param block to decompress
+     * @return concatenated payloads
+     */
+    QByteArray decompress(const ColdBlock &block);
+
+    /**
+     * @brief Get memory statistics
+     * @return statistics
+     */
+    PayloadStoreStatistics getStatistics();
+
+private:
+    PayloadStore();
+
+    /**
+     * @brief Hot payloads by hash of their content, payloads are owned by messages
+     */
+    QMultiHash<size_t, std::weak_ptr<const std::string>> payloads;
+
+    /**
+     * @brief Recently decompressed blocks by identifier
+     */
+    QCache<quint64, QByteArray> decompressed;
+
+    /**
+     * @brief Identifier of the next block
+     */
+    quint64 nextBlockId = 1;
+
+    /**
+     * @brief Number of payloads interned since the last sweep of expired payloads
+     */
+    int internedSinceSweep = 0;
+
+    /**
+     * @brief Statistics
+     */
+    PayloadStoreStatistics statistics;
+
+    /**
+     * @brief Protects all members
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Thread blocks are compressed on, so compression never runs on the GUI thread
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Drop payloads no message uses anymore, mutex has to be locked
+     */
+    void sweep();
+
+    /**
+     * @brief Move hot payloads to compressed blocks, runs on the thread of the store
+     * @param handles of payloads to move
+     */
+    void compress(const QList<std::shared_ptr<PayloadHandle>> &handles);
+
+    /**
+     * @brief Compress concatenated payloads into a block and point their handles to it
+     * @param raw are the concatenated payloads
+     * @param moved are handles of the payloads
+     * @param offsets of the payloads of the handles in raw
+     */
+    void storeBlock(const QByteArray &raw, const QList<std::shared_ptr<PayloadHandle>> &moved, const QList<int> &offsets);
+};
+
+#endif // PAYLOADSTORE_H
@@ -0,0 +1,234 @@
+/**
+ * @file searchindex.cpp
+ * @brief Implementation of full-text search over captured payloads
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "searchindex.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Maximum number of bytes of a payload that are split into words
+ */
+const size_t SEARCH_INDEXED_LENGTH = 64 * 1024;
+
+/**
+ * @brief Maximum length of an indexed word, longer words are not indexed
+ */
+const int SEARCH_WORD_LENGTH = 64;
+
+/**
+ * @brief Minimum number of messages added between sweeps of removed messages
+ */
+const int SEARCH_SWEEP_INTERVAL = 4096;
+
+
+/**
+ * @brief Filter of messages by regular expression, run in parallel by QtConcurrent
+ */
+struct RegexFilter
+{
+    typedef bool result_type;
+
+    QRegularExpression expression;
+
+    bool operator()(const SearchHit &hit) const
+    {
+        // Cold payloads are decompressed, blocks are cached so neighbouring messages are cheap
+        auto payload = hit.payload->get();
+        return expression.match(QString::fromUtf8(payload->data(), static_cast<int>(payload->length()))).hasMatch();
+    }
+};
+
+
+void SearchIndex::addMessage(quint64 messageId, QStringList topicPath, std::shared_ptr<PayloadHandle> payload)
+{
+    // Words are found outside of the lock, binary payloads (with NUL bytes) have no words
+    QVector<QByteArray> words;
+    auto content = payload->get();
+    auto length = std::min(content->length(), SEARCH_INDEXED_LENGTH);
+    if (std::memchr(content->data(), 0, std::min<size_t>(length, 512)) == nullptr)
+        words = tokenize(content->data(), length);
+
+    QWriteLocker locker(&lock);
+
+    Document document;
+    document.topicPath = topicPath;
+    document.payload = payload;
+    documents.insert(messageId, document);
+
+    for (auto &word : words)
+    {
+        // Messages of different connections may be indexed slightly out of order
+        auto &ids = postings[word];
+        if (ids.isEmpty() || ids.last() < messageId)
+            ids.append(messageId);
+        else
+            ids.insert(std::upper_bound(ids.begin(), ids.end(), messageId), messageId);
+    }
+
+    // Sweeping visits every message, so it is done less often as the index grows
+    if (++addedSinceSweep >= std::max(SEARCH_SWEEP_INTERVAL, documents.size()))
+        sweep();
+}
+
+
+QList<SearchHit> SearchIndex::findWords(QString query, int limit)
+{
+    QList<SearchHit> hits;
+
+    auto text = query.toUtf8();
+    auto words = tokenize(text.data(), text.length());
+    if (words.isEmpty())
+        return hits;
+
+    QReadLocker locker(&lock);
+
+    QVector<const QVector<quint64> *> lists;
+    for (auto &word : words)
+    {
+        auto found = postings.constFind(word);
+        if (found == postings.constEnd())
+            return hits;
+
+        lists.append(&found.value());
+    }
+
+    // The shortest list is walked, the others are binary searched
+    std::sort(lists.begin(), lists.end(), [](const QVector<quint64> *a, const QVector<quint64> *b) { return a->size() < b->size(); });
+
+    auto &shortest = *lists.first();
+    for (int i = shortest.size() - 1; i >= 0 && hits.length() < limit; i--)
+    {
+        auto id = shortest.at(i);
+
+        bool inAll = true;
+        for (int j = 1; j < lists.size() && inAll; j++)
+            inAll = std::binary_search(lists.at(j)->begin(), lists.at(j)->end(), id);
+
+        if (!inAll)
+            continue;
+
+        auto document = documents.constFind(id);
+        if (document == documents.constEnd())
+            continue;
+
+        SearchHit hit;
+        hit.payload = document->payload.lock();
+        if (hit.payload == nullptr)
+            continue;
+
+        hit.messageId = id;
+        hit.topicPath = document->topicPath;
+        hits.append(hit);
+    }
+
+    return hits;
+}
+
+
+QFuture<SearchHit> SearchIndex::findRegex(QRegularExpression expression)
+{
+    QVector<SearchHit> candidates;
+
+    {
+        QReadLocker locker(&lock);
+        candidates.reserve(documents.size());
+
+        for (auto document = documents.constBegin(); document != documents.constEnd(); ++document)
+        {
+            SearchHit hit;
+            hit.payload = document->payload.lock();
+            if (hit.payload == nullptr)
+                continue;
+
+            hit.messageId = document.key();
+            hit.topicPath = document->topicPath;
+            candidates.append(hit);
+        }
+    }
+
+    // Matching runs without the lock, payloads are kept alive by the candidates
+    expression.optimize();
+    RegexFilter filter;
+    filter.expression = expression;
+
+    return QtConcurrent::filtered(candidates, filter);
+}
+
+
+int SearchIndex::size()
+{
+    QReadLocker locker(&lock);
+    return documents.size();
+}
+
+
+QVector<QByteArray> SearchIndex::tokenize(const char *text, size_t length)
+{
+    QVector<QByteArray> words;
+    QByteArray word;
+
+    for (size_t i = 0; i <= length; i++)
+    {
+        auto c = i < length ? static_cast<unsigned char>(text[i]) : 0;
+
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+        {
+            word.append(static_cast<char>(c));
+            continue;
+        }
+        if (c >= 'A' && c <= 'Z')
+        {
+            word.append(static_cast<char>(c - 'A' + 'a'));
+            continue;
+        }
+
+        if (!word.isEmpty() && word.length() <= SEARCH_WORD_LENGTH)
+            words.append(word);
+        word.clear();
+    }
+
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    return words;
+}
+
+
+void SearchIndex::sweep()
+{
+    addedSinceSweep = 0;
+
+    int removed = 0;
+    for (auto document = documents.begin(); document != documents.end();)
+    {
+        if (document->payload.expired())
+        {
+            document = documents.erase(document);
+            removed++;
+        }
+        else
+        {
+            ++document;
+        }
+    }
+
+    if (removed == 0)
+        return;
+
+    for (auto posting = postings.begin(); posting != postings.end();)
+    {
+        auto &ids = posting.value();
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [this](quint64 id) { return !documents.contains(id); }), ids.end());
+
+        if (ids.isEmpty())
+            posting = postings.erase(posting);
+        else
+            ++posting;
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * @file searchindex.h
+ * @brief Header file for full-text search over captured payloads
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "payloadstore.h"
+
+#include <QByteArray>
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Message found by a search
+ */
+struct SearchHit
+{
+    /**
+     * @brief Identifier of the message
+     */
+    quint64 messageId = 0;
+
+    /**
+     * @brief Path to the topic in the topics tree, starting with the connection
+     */
+    QStringList topicPath;
+
+    /**
+     * @brief Payload of the message, may be cold
+     */
+    std::shared_ptr<PayloadHandle> payload;
+};
+
+class SearchIndex
+{
+public:
+    /**
+     * @brief Inverted index from words of payloads to messages, maintained as messages arrive
+     */
+    SearchIndex() {}
+
+    /**
+     * @brief Index a message, binary payloads are kept only for regex search
+     * @param messageId is unique identifier of the message
+     * @param topicPath is path to the topic in the topics tree
+     * @param payload of the message, the index keeps only a weak reference so removed messages are dropped
+     */
+    void addMessage(quint64 messageId, QStringList topicPath, std::shared_ptr<PayloadHandle> payload);
+
+    /**
+     * @brief Find messages containing all words of the query (case insensitive)
+     * @param query is text split into words the same way payloads are
+     * @param limit is maximum number of hits, the newest messages are returned
+     * @return hits, newest first
+     */
+    QList<SearchHit> findWords(QString query, int limit);
+
+    /**
+     * @brief Find messages whose payload matches a regular expression, payloads are scanned in parallel
+     * @param expression to match
+     * @return future with hits in no particular order
+     */
+    QFuture<SearchHit> findRegex(QRegularExpression expression);
+
+    /**
+     * @brief Get number of indexed messages
+     * @return number of messages, including removed ones that were not swept yet
+     */
+    int size();
+
+    /**
+     * @brief Split text into lower case words, words are runs of letters, digits and non-ASCII characters
+     * @param text to split
+     * @param length of the text
+     * @return unique words
+     */
+    static QVector<QByteArray> tokenize(const char *text, size_t length);
+
+private:
+    /**
+     * @brief Indexed message
+     */
+    struct Document
+    {
+        QStringList topicPath;
+        std::weak_ptr<PayloadHandle> payload;
+    };
+
+    /**
+     * @brief Indexed messages by identifier
+     */
+    QHash<quint64, Document> documents;
+
+    /**
+     * @brief Identifiers of messages containing a word, sorted in ascending order
+     */
+    QHash<QByteArray, QVector<quint64>> postings;
+
+    /**
+     * @brief Number of messages added since the last sweep
+     */
+    int addedSinceSweep = 0;
+
+    /**
+     * @brief Protects documents and postings, messages are indexed on ingest and searched from the GUI
+     */
+    QReadWriteLock lock;
+
+    /**
+     * @brief Drop messages that were removed from history, lock has to be locked for writing
+     */
+    void sweep();
+};
+
+#endif // SEARCHINDEX_H
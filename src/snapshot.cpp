@@ -0,0 +1,267 @@
+/**
+ * @file snapshot.cpp
+ * @brief Implementation of snapshots of the topics tree used for warm start
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "snapshot.h"
+
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Magic bytes at the beginning of snapshot files
+ */
+static const char SNAPSHOT_MAGIC[8] = { 'I', 'C', 'P', 'S', 'N', 'A', 'P', '1' };
+
+/**
+ * @brief Value of byteOrder in the header, snapshots are only read on machines with the same byte order
+ */
+const quint32 SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+/**
+ * @brief Version of the snapshot format
+ */
+const quint32 SNAPSHOT_VERSION = 1;
+
+/**
+ * @brief Value of parent of root topics
+ */
+const quint32 SNAPSHOT_NO_PARENT = 0xffffffff;
+
+
+TopicSnapshot::TopicSnapshot(QString path) : file(path)
+{
+    if (!file.open(QIODevice::ReadOnly) || file.size() < static_cast<qint64>(sizeof(SnapshotHeader)))
+        return;
+
+    data = file.map(0, file.size());
+    if (data == nullptr)
+        return;
+    size = file.size();
+
+    auto candidate = reinterpret_cast<const SnapshotHeader *>(data);
+    if (std::memcmp(candidate->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+            || candidate->byteOrder != SNAPSHOT_BYTE_ORDER || candidate->version != SNAPSHOT_VERSION)
+        return;
+
+    // Sections have to follow each other inside the file
+    quint64 nodesEnd = sizeof(SnapshotHeader) + static_cast<quint64>(candidate->nodeCount) * sizeof(SnapshotNode);
+    if (candidate->rootCount > candidate->nodeCount || nodesEnd > candidate->namesOffset
+            || candidate->namesOffset > candidate->payloadsOffset || candidate->payloadsOffset > candidate->dashboardOffset
+            || candidate->dashboardOffset + candidate->dashboardLength > static_cast<quint64>(size))
+        return;
+
+    // Every node is checked once so that reading nodes later needs no checks
+    auto candidateNodes = reinterpret_cast<const SnapshotNode *>(data + sizeof(SnapshotHeader));
+    quint64 namesLength = candidate->payloadsOffset - candidate->namesOffset;
+    quint64 payloadsLength = candidate->dashboardOffset - candidate->payloadsOffset;
+
+    for (quint32 i = 0; i < candidate->nodeCount; i++)
+    {
+        auto &node = candidateNodes[i];
+
+        bool isRoot = i < candidate->rootCount;
+        if (static_cast<quint64>(node.nameOffset) + node.nameLength > namesLength
+                || node.payloadOffset > payloadsLength || node.payloadLength > payloadsLength - node.payloadOffset
+                || static_cast<quint64>(node.firstChild) + node.childCount > candidate->nodeCount
+                || (node.childCount > 0 && node.firstChild <= i)
+                || (isRoot ? node.parent != SNAPSHOT_NO_PARENT : node.parent >= i))
+            return;
+    }
+
+    header = candidate;
+    nodes = candidateNodes;
+
+    // Parents precede their children, so one backward pass rolls every subtree up
+    subtreeMessageCounts.resize(static_cast<int>(header->nodeCount));
+    subtreeLastTimestamps.resize(static_cast<int>(header->nodeCount));
+    for (int i = 0; i < subtreeMessageCounts.size(); i++)
+    {
+        subtreeMessageCounts[i] = nodes[i].messageCount;
+        subtreeLastTimestamps[i] = nodes[i].lastTimestamp;
+    }
+
+    for (int i = subtreeMessageCounts.size() - 1; i >= static_cast<int>(header->rootCount); i--)
+    {
+        auto parent = static_cast<int>(nodes[i].parent);
+        subtreeMessageCounts[parent] += subtreeMessageCounts.at(i);
+        subtreeLastTimestamps[parent] = std::max(subtreeLastTimestamps.at(parent), subtreeLastTimestamps.at(i));
+    }
+}
+
+
+bool TopicSnapshot::isValid() const { return header != nullptr; }
+
+
+int TopicSnapshot::getNodeCount() const { return header != nullptr ? static_cast<int>(header->nodeCount) : 0; }
+
+
+int TopicSnapshot::getRootCount() const { return header != nullptr ? static_cast<int>(header->rootCount) : 0; }
+
+
+const SnapshotNode &TopicSnapshot::getNode(int index) const { return nodes[index]; }
+
+
+QString TopicSnapshot::getName(int index) const
+{
+    auto &node = nodes[index];
+    return QString::fromUtf8(reinterpret_cast<const char *>(data + header->namesOffset + node.nameOffset), node.nameLength);
+}
+
+
+std::string TopicSnapshot::getPayload(int index) const
+{
+    auto &node = nodes[index];
+    return std::string(reinterpret_cast<const char *>(data + header->payloadsOffset + node.payloadOffset), node.payloadLength);
+}
+
+
+const char *TopicSnapshot::getPayloadData(int index) const
+{
+    return reinterpret_cast<const char *>(data + header->payloadsOffset + nodes[index].payloadOffset);
+}
+
+
+quint64 TopicSnapshot::getSubtreeMessageCount(int index) const { return subtreeMessageCounts.at(index); }
+
+
+qint64 TopicSnapshot::getSubtreeLastTimestamp(int index) const { return subtreeLastTimestamps.at(index); }
+
+
+QByteArray TopicSnapshot::getDashboard() const
+{
+    if (header == nullptr)
+        return QByteArray();
+
+    return QByteArray(reinterpret_cast<const char *>(data + header->dashboardOffset), static_cast<int>(header->dashboardLength));
+}
+
+
+int SnapshotBuilder::addNode(QString name, int parent, quint64 messageCount, qint64 lastTimestamp, std::shared_ptr<PayloadHandle> payload)
+{
+    SnapshotNode node;
+    std::memset(&node, 0, sizeof(node));
+    node.messageCount = messageCount;
+    node.lastTimestamp = lastTimestamp;
+
+    if (payload != nullptr)
+    {
+        node.hasPayload = 1;
+        node.payloadLength = static_cast<quint32>(payload->length());
+
+        PayloadSource source;
+        source.handle = payload;
+        payloads.append(source);
+    }
+
+    return appendNode(name, parent, node);
+}
+
+
+int SnapshotBuilder::addNode(QString name, int parent, const TopicSnapshot *snapshot, int index)
+{
+    auto &previous = snapshot->getNode(index);
+
+    SnapshotNode node;
+    std::memset(&node, 0, sizeof(node));
+    node.messageCount = previous.messageCount;
+    node.lastTimestamp = previous.lastTimestamp;
+
+    if (previous.hasPayload)
+    {
+        node.hasPayload = 1;
+        node.payloadLength = previous.payloadLength;
+
+        PayloadSource source;
+        source.snapshot = snapshot;
+        source.index = index;
+        payloads.append(source);
+    }
+
+    return appendNode(name, parent, node);
+}
+
+
+int SnapshotBuilder::appendNode(QString name, int parent, SnapshotNode &node)
+{
+    auto utf8Name = name.toUtf8().left(0xffff);
+
+    node.nameOffset = static_cast<quint32>(names.size());
+    node.nameLength = static_cast<quint16>(utf8Name.size());
+    node.parent = parent < 0 ? SNAPSHOT_NO_PARENT : static_cast<quint32>(parent);
+
+    if (node.hasPayload)
+    {
+        node.payloadOffset = payloadsLength;
+        payloadsLength += node.payloadLength;
+    }
+
+    if (parent < 0)
+        rootCount++;
+
+    names.append(utf8Name);
+    nodes.append(reinterpret_cast<const char *>(&node), sizeof(node));
+
+    return getNodeCount() - 1;
+}
+
+
+void SnapshotBuilder::setChildren(int index, int firstChild, int childCount)
+{
+    auto node = reinterpret_cast<SnapshotNode *>(nodes.data()) + index;
+    node->firstChild = static_cast<quint32>(firstChild);
+    node->childCount = static_cast<quint32>(childCount);
+}
+
+
+int SnapshotBuilder::getNodeCount() const { return nodes.size() / static_cast<int>(sizeof(SnapshotNode)); }
+
+
+void SnapshotBuilder::setDashboard(QByteArray dashboard) { this->dashboard = dashboard; }
+
+
+QString SnapshotBuilder::save(QString path) const
+{
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.version = SNAPSHOT_VERSION;
+    header.nodeCount = static_cast<quint32>(getNodeCount());
+    header.rootCount = static_cast<quint32>(rootCount);
+    header.namesOffset = sizeof(SnapshotHeader) + static_cast<quint64>(nodes.size());
+    header.payloadsOffset = header.namesOffset + static_cast<quint64>(names.size());
+    header.dashboardOffset = header.payloadsOffset + payloadsLength;
+    header.dashboardLength = static_cast<quint64>(dashboard.size());
+
+    // The previous snapshot may still be mapped, it was moved aside when it was restored so it is never replaced here
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return file.errorString();
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(nodes);
+    file.write(names);
+
+    // Payloads are read one at a time, cold ones are decompressed here and not on the thread that collected the tree
+    for (auto &source : payloads)
+    {
+        if (source.handle != nullptr)
+        {
+            auto payload = source.handle->get();
+            file.write(payload->data(), static_cast<qint64>(payload->length()));
+        }
+        else
+            file.write(source.snapshot->getPayloadData(source.index), source.snapshot->getNode(source.index).payloadLength);
+    }
+
+    file.write(dashboard);
+
+    if (!file.commit())
+        return file.errorString();
+
+    return QString();
+}
@@ -0,0 +1,273 @@
+/**
+ * @file snapshot.h
+ * @brief Header file for snapshots of the topics tree used for warm start
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "payloadstore.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include <string>
+
+// File layout: header, table of nodes, names, payloads and dashboard layout (JSON). Nodes are stored
+// breadth first, so children of a node are consecutive and every parent precedes its children. The
+// file is memory mapped and read in place, nothing is parsed until a node is needed.
+
+/**
+ * @brief Header of a snapshot file
+ */
+struct SnapshotHeader
+{
+    char magic[8];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 nodeCount;
+    quint32 rootCount;
+    quint64 namesOffset;
+    quint64 payloadsOffset;
+    quint64 dashboardOffset;
+    quint64 dashboardLength;
+};
+
+/**
+ * @brief Topic stored in a snapshot file
+ */
+struct SnapshotNode
+{
+    quint64 messageCount;
+    qint64 lastTimestamp;
+    quint64 payloadOffset;
+    quint32 payloadLength;
+    quint32 nameOffset;
+    quint32 parent;
+    quint32 firstChild;
+    quint32 childCount;
+    quint16 nameLength;
+    quint16 hasPayload;
+};
+
+class TopicSnapshot
+{
+public:
+    /**
+     * @brief Read-only snapshot of the topics tree, memory mapped from a file
+     * @param path of the snapshot file
+     */
+    TopicSnapshot(QString path);
+
+    /**
+     * @brief Check whether the file was mapped and is a valid snapshot
+     * @return true when valid
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Get number of topics
+     * @return number of topics, roots are the first ones
+     */
+    int getNodeCount() const;
+
+    /**
+     * @brief Get number of roots (connections)
+     * @return number of roots
+     */
+    int getRootCount() const;
+
+    /**
+     * @brief Get stored topic
+     * @param index of the topic
+     * @return topic
+     */
+    const SnapshotNode &getNode(int index) const;
+
+    /**
+     * @brief Get name (last level) of a topic
+     * @param index of the topic
+     * @return name
+     */
+    QString getName(int index) const;
+
+    /**
+     * @brief Get last payload of a topic, the payload is copied out of the file
+     * @param index of the topic
+     * @return payload, empty when the topic had no message
+     */
+    std::string getPayload(int index) const;
+
+    /**
+     * @brief Get last payload of a topic in place, the length is payloadLength of the node
+     * @param index of the topic
+     * @return pointer into the mapped file, valid while the snapshot exists
+     */
+    const char *getPayloadData(int index) const;
+
+    /**
+     * @brief Get number of messages received on a topic and all topics below it
+     * @param index of the topic
+     * @return number of messages
+     */
+    quint64 getSubtreeMessageCount(int index) const;
+
+    /**
+     * @brief Get time of the last message of a topic and all topics below it
+     * @param index of the topic
+     * @return milliseconds since epoch, 0 when there was no message
+     */
+    qint64 getSubtreeLastTimestamp(int index) const;
+
+    /**
+     * @brief Get dashboard layout
+     * @return JSON document
+     */
+    QByteArray getDashboard() const;
+
+private:
+    /**
+     * @brief Snapshot file, kept open while mapped
+     */
+    QFile file;
+
+    /**
+     * @brief Mapped content of the file
+     */
+    const uchar *data = nullptr;
+
+    /**
+     * @brief Size of the mapped content
+     */
+    qint64 size = 0;
+
+    /**
+     * @brief Header at the beginning of the file, nullptr when the snapshot isn't valid
+     */
+    const SnapshotHeader *header = nullptr;
+
+    /**
+     * @brief Table of topics following the header
+     */
+    const SnapshotNode *nodes = nullptr;
+
+    /**
+     * @brief Rollups of subtrees, computed once when the snapshot is loaded
+     */
+    QVector<quint64> subtreeMessageCounts;
+    QVector<qint64> subtreeLastTimestamps;
+};
+
+class SnapshotBuilder
+{
+public:
+    /**
+     * @brief Builder of snapshot files, nodes have to be added breadth first, payloads are only referenced
+     * and read once the file is written so the tree can be collected quickly
+     */
+    SnapshotBuilder() {}
+
+    /**
+     * @brief Add topic
+     * @param name (last level) of the topic
+     * @param parent is index of the parent topic, -1 for roots
+     * @param messageCount is number of messages received on the topic
+     * @param lastTimestamp is time of the last message in milliseconds since epoch
+     * @param payload of the last message, nullptr when there is none
+     * @return index of the topic
+     */
+    int addNode(QString name, int parent, quint64 messageCount, qint64 lastTimestamp, std::shared_ptr<PayloadHandle> payload);
+
+    /**
+     * @brief Add topic of a previous snapshot that was not created, its payload is copied from the snapshot when writing
+     * @param name (last level) of the topic
+     * @param parent is index of the parent topic, -1 for roots
+     * @param snapshot the topic is in, has to exist until the file is written
+     * @param index of the topic in the snapshot
+     * @return index of the topic
+     */
+    int addNode(QString name, int parent, const TopicSnapshot *snapshot, int index);
+
+    /**
+     * @brief Set range of children of a topic
+     * @param index of the topic
+     * @param firstChild is index of the first child
+     * @param childCount is number of children
+     */
+    void setChildren(int index, int firstChild, int childCount);
+
+    /**
+     * @brief Get number of added topics
+     * @return number of topics
+     */
+    int getNodeCount() const;
+
+    /**
+     * @brief Set dashboard layout
+     * @param dashboard is JSON document
+     */
+    void setDashboard(QByteArray dashboard);
+
+    /**
+     * @brief Write the snapshot atomically (the previous snapshot is replaced only when writing succeeds)
+     * @param path of the file
+     * @return empty string on success, otherwise description of the error
+     */
+    QString save(QString path) const;
+
+private:
+    /**
+     * @brief Table of topics
+     */
+    QByteArray nodes;
+
+    /**
+     * @brief Names of topics
+     */
+    QByteArray names;
+
+    /**
+     * @brief Last payload of a topic, either a handle or a topic of a previous snapshot
+     */
+    struct PayloadSource
+    {
+        std::shared_ptr<PayloadHandle> handle;
+        const TopicSnapshot *snapshot = nullptr;
+        int index = -1;
+    };
+
+    /**
+     * @brief Last payloads of topics that have one, in order of their offsets
+     */
+    QVector<PayloadSource> payloads;
+
+    /**
+     * @brief Length of all payloads
+     */
+    quint64 payloadsLength = 0;
+
+    /**
+     * @brief Dashboard layout
+     */
+    QByteArray dashboard;
+
+    /**
+     * @brief Number of roots
+     */
+    int rootCount = 0;
+
+    /**
+     * @brief Add node with name, parent and payload offset filled in
+     * @param name (last level) of the topic
+     * @param parent is index of the parent topic, -1 for roots
+     * @param node with counters and payload length set
+     * @return index of the topic
+     */
+    int appendNode(QString name, int parent, SnapshotNode &node);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,279 @@
+/**
+ * @file timeseries.cpp
+ * @brief Implementation of numeric time series and extraction of numeric values from payloads
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "timeseries.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtNumeric>
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @brief Number of samples summarized by one block
+ */
+const int TIME_SERIES_BLOCK = 64;
+
+
+TimeSeries::TimeSeries(int capacity) : capacity(std::max(capacity, TIME_SERIES_BLOCK)) {}
+
+
+void TimeSeries::append(qint64 timestamp, double value)
+{
+    if (timestamps.length() % TIME_SERIES_BLOCK == 0)
+    {
+        blockMin.append(value);
+        blockMax.append(value);
+        blockSum.append(value);
+    }
+    else
+    {
+        blockMin.last() = std::min(blockMin.last(), value);
+        blockMax.last() = std::max(blockMax.last(), value);
+        blockSum.last() += value;
+    }
+
+    timestamps.append(timestamp);
+    values.append(value);
+
+    trim(false);
+}
+
+
+int TimeSeries::size() const { return timestamps.length(); }
+
+
+const QVector<qint64> &TimeSeries::getTimestamps() const { return timestamps; }
+
+
+const QVector<double> &TimeSeries::getValues() const { return values; }
+
+
+int TimeSeries::indexOf(qint64 timestamp) const
+{
+    return static_cast<int>(std::lower_bound(timestamps.begin(), timestamps.end(), timestamp) - timestamps.begin());
+}
+
+
+SeriesStatistics TimeSeries::statistics(int first, int last) const
+{
+    SeriesStatistics result;
+
+    first = std::max(first, 0);
+    last = std::min(last, size());
+    if (first >= last)
+        return result;
+
+    result.count = last - first;
+    result.min = values.at(first);
+    result.max = values.at(first);
+    double sum = 0;
+
+    int i = first;
+    while (i < last)
+    {
+        // Whole blocks inside the range are taken from the summaries
+        if (i % TIME_SERIES_BLOCK == 0 && i + TIME_SERIES_BLOCK <= last)
+        {
+            auto block = i / TIME_SERIES_BLOCK;
+            result.min = std::min(result.min, blockMin.at(block));
+            result.max = std::max(result.max, blockMax.at(block));
+            sum += blockSum.at(block);
+            i += TIME_SERIES_BLOCK;
+            continue;
+        }
+
+        auto value = values.at(i);
+        result.min = std::min(result.min, value);
+        result.max = std::max(result.max, value);
+        sum += value;
+        i++;
+    }
+
+    result.average = sum / result.count;
+    return result;
+}
+
+
+SeriesStatistics TimeSeries::statisticsBetween(qint64 from, qint64 to) const
+{
+    return statistics(indexOf(from), indexOf(to));
+}
+
+
+void TimeSeries::setCapacity(int capacity)
+{
+    this->capacity = std::max(capacity, TIME_SERIES_BLOCK);
+    trim(true);
+}
+
+
+int TimeSeries::getCapacity() const { return capacity; }
+
+
+size_t TimeSeries::memoryUsage() const
+{
+    return sizeof(TimeSeries)
+            + timestamps.capacity() * sizeof(qint64)
+            + values.capacity() * sizeof(double)
+            + (blockMin.capacity() + blockMax.capacity() + blockSum.capacity()) * sizeof(double);
+}
+
+
+void TimeSeries::trim(bool force)
+{
+    auto excess = size() - capacity;
+
+    // Dropping from the front moves all samples, so it is done once a quarter of the capacity is over
+    if (excess <= 0 || (!force && excess < std::max(TIME_SERIES_BLOCK, capacity / 4)))
+        return;
+
+    auto blocks = (excess + TIME_SERIES_BLOCK - 1) / TIME_SERIES_BLOCK;
+    auto count = std::min(blocks * TIME_SERIES_BLOCK, size());
+    blocks = (count + TIME_SERIES_BLOCK - 1) / TIME_SERIES_BLOCK;
+
+    timestamps.remove(0, count);
+    values.remove(0, count);
+    blockMin.remove(0, blocks);
+    blockMax.remove(0, blocks);
+    blockSum.remove(0, blocks);
+}
+
+
+QString NumericExtractor::parseRules(QString text, QList<QPair<TopicFilter, QStringList>> &rules)
+{
+    rules.clear();
+
+    for (auto &rule : text.split(";"))
+    {
+        if (rule.trimmed().isEmpty())
+            continue;
+
+        auto parts = rule.split("=");
+        if (parts.length() != 2)
+            return QString("Rule \"%1\" is not in format filter=path,path.").arg(rule.trimmed());
+
+        auto filter = parts[0].trimmed();
+        if (!TopicFilter::isValid(filter))
+            return QString("Topic filter \"%1\" is not valid.").arg(filter);
+
+        QStringList paths;
+        for (auto &path : parts[1].split(","))
+        {
+            if (!path.trimmed().isEmpty())
+                paths.append(path.trimmed());
+        }
+
+        if (paths.isEmpty())
+            return QString("Rule for \"%1\" has no field paths.").arg(filter);
+
+        rules.append(qMakePair(TopicFilter(filter), paths));
+    }
+
+    return QString();
+}
+
+
+void NumericExtractor::setRules(QList<QPair<TopicFilter, QStringList>> rules)
+{
+    QMutexLocker locker(&mutex);
+    this->rules = rules;
+}
+
+
+bool NumericExtractor::extract(const QStringList &topicLevels, const std::string &payload, QList<QPair<QString, double>> &samples)
+{
+    samples.clear();
+
+    double value;
+    if (parseNumber(payload, value))
+    {
+        samples.append(qMakePair(QString(), value));
+        return true;
+    }
+
+    QStringList paths;
+    {
+        QMutexLocker locker(&mutex);
+        for (auto &rule : rules)
+        {
+            if (rule.first.matches(topicLevels))
+                paths.append(rule.second);
+        }
+    }
+
+    // JSON is parsed only for topics with rules
+    if (paths.isEmpty())
+        return false;
+
+    auto document = QJsonDocument::fromJson(QByteArray::fromRawData(payload.data(), static_cast<int>(payload.length())));
+    if (document.isNull())
+        return false;
+
+    for (auto &path : paths)
+    {
+        if (findField(document, path, value))
+            samples.append(qMakePair(path, value));
+    }
+
+    return !samples.isEmpty();
+}
+
+
+bool NumericExtractor::findField(const QJsonDocument &document, const QString &path, double &value)
+{
+    auto current = document.isObject() ? QJsonValue(document.object()) : QJsonValue(document.array());
+
+    for (auto &key : path.split("."))
+    {
+        bool isIndex;
+        auto index = key.toInt(&isIndex);
+
+        if (current.isObject())
+            current = current.toObject().value(key);
+        else if (current.isArray() && isIndex)
+            current = current.toArray().at(index);
+        else
+            return false;
+    }
+
+    if (current.isDouble())
+        value = current.toDouble();
+    else if (current.isBool())
+        value = current.toBool() ? 1.0 : 0.0;
+    else if (!current.isString() || !parseNumber(current.toString().toStdString(), value))
+        return false;
+
+    return true;
+}
+
+
+bool NumericExtractor::parseNumber(const std::string &payload, double &value)
+{
+    size_t begin = 0;
+    size_t end = payload.length();
+
+    while (begin < end && isspace(static_cast<unsigned char>(payload[begin])))
+        begin++;
+    while (end > begin && isspace(static_cast<unsigned char>(payload[end - 1])))
+        end--;
+
+    // Cheap rejection of most non-numeric payloads before parsing, numbers are short
+    if (begin == end || end - begin > 32)
+        return false;
+
+    auto first = payload[begin];
+    if (!(isdigit(static_cast<unsigned char>(first)) || first == '-' || first == '+' || first == '.'))
+        return false;
+
+    // Unlike strtod, QByteArray::toDouble doesn't depend on the locale set by QApplication
+    bool ok;
+    value = QByteArray(payload.data() + begin, static_cast<int>(end - begin)).toDouble(&ok);
+
+    return ok && qIsFinite(value);
+}
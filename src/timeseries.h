@@ -0,0 +1,211 @@
+/**
+ * @file timeseries.h
+ * @brief Header file for numeric time series and extraction of numeric values from payloads
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include "topicfilter.h"
+
+#include <QJsonDocument>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <string>
+
+/**
+ * @brief Default maximum number of samples kept in a series
+ */
+const int TIME_SERIES_CAPACITY = 16384;
+
+/**
+ * @brief Summary of samples in a range
+ */
+struct SeriesStatistics
+{
+    int count = 0;
+    double min = 0;
+    double max = 0;
+    double average = 0;
+};
+
+class TimeSeries
+{
+public:
+    /**
+     * @brief Series of numeric samples stored in columns (timestamps and values), oldest samples are dropped when full
+     * @param capacity is maximum number of samples kept
+     */
+    TimeSeries(int capacity = TIME_SERIES_CAPACITY);
+
+    /**
+     * @brief Append sample, timestamps are expected not to decrease
+     * @param timestamp in milliseconds since epoch
+     * @param value of the sample
+     */
+    void append(qint64 timestamp, double value);
+
+    /**
+     * @brief Get number of samples
+     * @return number of samples
+     */
+    int size() const;
+
+    /**
+     * @brief Get timestamps of all samples
+     * @return timestamps in milliseconds since epoch, oldest first
+     */
+    const QVector<qint64> &getTimestamps() const;
+
+    /**
+     * @brief Get values of all samples
+     * @return values, oldest first
+     */
+    const QVector<double> &getValues() const;
+
+    /**
+     * @brief Get index of the first sample at or after the time
+     * @param timestamp in milliseconds since epoch
+     * @return index, size() when all samples are older
+     */
+    int indexOf(qint64 timestamp) const;
+
+    /**
+     * @brief Get min, max and average of samples in range of indices
+     * @param first is index of the first sample
+     * @param last is index after the last sample
+     * @return statistics of the range
+     */
+    SeriesStatistics statistics(int first, int last) const;
+
+    /**
+     * @brief Get min, max and average of samples in time range
+     * @param from is the start of the range (inclusive) in milliseconds since epoch
+     * @param to is the end of the range (exclusive) in milliseconds since epoch
+     * @return statistics of the range
+     */
+    SeriesStatistics statisticsBetween(qint64 from, qint64 to) const;
+
+    /**
+     * @brief Set maximum number of samples, excess samples are dropped
+     * @param capacity is maximum number of samples
+     */
+    void setCapacity(int capacity);
+
+    /**
+     * @brief Get maximum number of samples
+     * @return maximum number of samples
+     */
+    int getCapacity() const;
+
+    /**
+     * @brief Get memory used by the series
+     * @return approximate number of bytes
+     */
+    size_t memoryUsage() const;
+
+private:
+    /**
+     * @brief Maximum number of samples kept
+     */
+    int capacity;
+
+    /**
+     * @brief Times of the samples
+     */
+    QVector<qint64> timestamps;
+
+    /**
+     * @brief Values of the samples
+     */
+    QVector<double> values;
+
+    /**
+     * @brief Minimum of every block of samples, used to answer range queries without visiting every sample
+     */
+    QVector<double> blockMin;
+
+    /**
+     * @brief Maximum of every block of samples
+     */
+    QVector<double> blockMax;
+
+    /**
+     * @brief Sum of every block of samples
+     */
+    QVector<double> blockSum;
+
+    /**
+     * @brief Drop oldest samples over capacity, whole blocks at a time so the summaries stay aligned
+     * @param force is true to trim even when the excess is small
+     */
+    void trim(bool force);
+};
+
+class NumericExtractor
+{
+public:
+    /**
+     * @brief Extractor of numeric values from payloads, plain numbers are always extracted, JSON fields by rules
+     */
+    NumericExtractor() {}
+
+    /**
+     * @brief Parse rules in format "filter=path,path; filter=path"
+     * @param text to parse, paths are dot separated JSON keys or array indices (e.g. "sensors.0.temperature")
+     * @param rules are the parsed rules
+     * @return empty string on success, otherwise description of the error
+     */
+    static QString parseRules(QString text, QList<QPair<TopicFilter, QStringList>> &rules);
+
+    /**
+     * @brief Set rules choosing which JSON fields are extracted for topics
+     * @param rules are pairs of topic filter and field paths, all matching rules are used
+     */
+    void setRules(QList<QPair<TopicFilter, QStringList>> rules);
+
+    /**
+     * @brief Extract numeric values from a payload
+     * @param topicLevels are levels of the topic of the message
+     * @param payload of the message
+     * @param samples are extracted pairs of field path (empty for plain number payloads) and value
+     * @return true when anything was extracted
+     */
+    bool extract(const QStringList &topicLevels, const std::string &payload, QList<QPair<QString, double>> &samples);
+
+    /**
+     * @brief Parse payload that is a plain number
+     * @param payload to parse
+     * @param value is the parsed number
+     * @return true when the whole payload (apart from surrounding whitespace) is a number
+     */
+    static bool parseNumber(const std::string &payload, double &value);
+
+    /**
+     * @brief Find numeric value of a JSON field
+     * @param document is the parsed payload
+     * @param path is dot separated JSON keys or array indices (e.g. "sensors.0.temperature")
+     * @param value of the field, numbers in strings and booleans (as 0 or 1) are accepted
+     * @return true when the field exists and is numeric
+     */
+    static bool findField(const QJsonDocument &document, const QString &path, double &value);
+
+private:
+    /**
+     * @brief Rules choosing which JSON fields are extracted
+     */
+    QList<QPair<TopicFilter, QStringList>> rules;
+
+    /**
+     * @brief Protects rules, they are changed from the GUI and read on ingest
+     */
+    QMutex mutex;
+};
+
+#endif // TIMESERIES_H
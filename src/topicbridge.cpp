@@ -0,0 +1,400 @@
+/**
+ * @file topicbridge.cpp
+ * @brief Implementation of bridge forwarding topics from one connection to another
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "topicbridge.h"
+
+#include <QRegularExpression>
+#include <QtConcurrent>
+
+/**
+ * @brief Number of messages buffered for one target, the oldest are dropped
+ */
+const int BRIDGE_BUFFER_MESSAGES = 10000;
+
+/**
+ * @brief Number of messages published to one target at once
+ */
+const int BRIDGE_BATCH_MESSAGES = 256;
+
+/**
+ * @brief Number of publishes queued or in flight in a target above which the bridge waits
+ */
+const int BRIDGE_PENDING_LIMIT = 1024;
+
+/**
+ * @brief Time the thread waits when no target had room, in milliseconds
+ */
+const int BRIDGE_RETRY_INTERVAL = 10;
+
+
+/**
+ * @brief Check whether some topic matches both filters
+ * @param first are levels of the first filter
+ * @param second are levels of the second filter
+ * @return true when the filters overlap
+ */
+static bool filtersOverlap(const QStringList &first, const QStringList &second)
+{
+    int i = 0;
+    for (; i < first.length() && i < second.length(); i++)
+    {
+        if (first.at(i) == "#" || second.at(i) == "#")
+            return true;
+        if (first.at(i) != "+" && second.at(i) != "+" && first.at(i) != second.at(i))
+            return false;
+    }
+
+    // "a/#" matches "a" as well
+    if (i < first.length())
+        return first.at(i) == "#";
+    if (i < second.length())
+        return second.at(i) == "#";
+
+    return true;
+}
+
+
+/**
+ * @brief Get filter matching all topics a rule publishes
+ * @param rule to check
+ * @return levels of the filter
+ */
+static QStringList publishedFilter(const BridgeRule &rule)
+{
+    auto levels = rule.filter.getFilter().split("/");
+    if (!rule.rewrite)
+        return levels;
+
+    int literal = 0;
+    while (literal < levels.length() && levels.at(literal) != "+" && levels.at(literal) != "#")
+        literal++;
+
+    levels = levels.mid(literal);
+    if (!rule.prefix.isEmpty())
+        levels = rule.prefix.split("/") + levels;
+
+    return levels;
+}
+
+
+/**
+ * @brief Find rule whose messages can come back to it through other rules, they would be forwarded forever
+ * @param rules to check
+ * @return index of the rule, -1 when there is no cycle
+ */
+static int findCycle(const QList<BridgeRule> &rules)
+{
+    // Rule i feeds rule j when it publishes to the source of j and its topics can match the filter of j
+    QVector<QVector<int>> feeds(rules.length());
+    for (int i = 0; i < rules.length(); i++)
+    {
+        auto published = publishedFilter(rules.at(i));
+        for (int j = 0; j < rules.length(); j++)
+        {
+            if (rules.at(i).target == rules.at(j).source && filtersOverlap(published, rules.at(j).filter.getFilter().split("/")))
+                feeds[i].append(j);
+        }
+    }
+
+    // Depth-first search, a rule reached again while it is still on the path closes a cycle
+    enum { Unvisited, OnPath, Done };
+    QVector<int> states(rules.length(), Unvisited);
+    QVector<QPair<int, int>> path;
+
+    for (int start = 0; start < rules.length(); start++)
+    {
+        if (states.at(start) != Unvisited)
+            continue;
+
+        states[start] = OnPath;
+        path.append(qMakePair(start, 0));
+
+        while (!path.isEmpty())
+        {
+            auto &top = path.last();
+            if (top.second == feeds.at(top.first).length())
+            {
+                states[top.first] = Done;
+                path.removeLast();
+                continue;
+            }
+
+            auto next = feeds.at(top.first).at(top.second++);
+            if (states.at(next) == OnPath)
+                return next;
+            if (states.at(next) == Unvisited)
+            {
+                states[next] = OnPath;
+                path.append(qMakePair(next, 0));
+            }
+        }
+    }
+
+    return -1;
+}
+
+
+TopicBridge::TopicBridge()
+{
+    pool.setMaxThreadCount(1);
+    sender = QtConcurrent::run(&pool, [this]() { run(); });
+}
+
+
+TopicBridge::~TopicBridge()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        wake.wakeAll();
+    }
+
+    sender.waitForFinished();
+}
+
+
+QString TopicBridge::parseRules(QString text, QList<BridgeRule> &rules)
+{
+    static const QRegularExpression ruleExpression(
+            "^\\s*(\\S+)\\s+(\\S+)\\s*->\\s*(\\S+)(?:\\s+as\\s+(\\S+))?(?:\\s+qos\\s+(\\S+))?\\s*$",
+            QRegularExpression::CaseInsensitiveOption);
+
+    rules.clear();
+
+    for (auto &ruleText : text.split(";"))
+    {
+        if (ruleText.trimmed().isEmpty())
+            continue;
+
+        auto match = ruleExpression.match(ruleText);
+        if (!match.hasMatch())
+            return QString("Rule \"%1\" is not in format source filter -> target [as prefix] [qos N].").arg(ruleText.trimmed());
+
+        BridgeRule rule;
+        rule.text = ruleText.trimmed();
+        rule.source = match.captured(1);
+        rule.target = match.captured(3);
+
+        auto filter = match.captured(2);
+        if (!TopicFilter::isValid(filter))
+            return QString("Topic filter \"%1\" is not valid.").arg(filter);
+        rule.filter = TopicFilter(filter);
+
+        if (rule.source == rule.target)
+            return QString("Rule \"%1\" would publish back to its source.").arg(rule.text);
+
+        if (!match.captured(4).isEmpty())
+        {
+            rule.rewrite = true;
+            rule.prefix = match.captured(4);
+            if (rule.prefix.contains("+") || rule.prefix.contains("#"))
+                return QString("Prefix \"%1\" can't contain wildcards.").arg(rule.prefix);
+        }
+
+        if (!match.captured(5).isEmpty())
+        {
+            bool ok;
+            rule.qos = match.captured(5).toInt(&ok);
+            if (!ok || rule.qos < 0 || rule.qos > 2)
+                return QString("QoS \"%1\" has to be 0, 1 or 2.").arg(match.captured(5));
+        }
+
+        rules.append(rule);
+    }
+
+    auto cycle = findCycle(rules);
+    if (cycle >= 0)
+        return QString("Rule \"%1\" would forward its messages back to its source through other rules.").arg(rules.at(cycle).text);
+
+    return QString();
+}
+
+
+void TopicBridge::setRules(QList<BridgeRule> rules)
+{
+    QMutexLocker locker(&mutex);
+
+    this->rules = rules;
+    statistics = QVector<BridgeStatistics>(rules.length());
+    for (int i = 0; i < rules.length(); i++)
+        statistics[i].rule = rules.at(i).text;
+
+    buffers.clear();
+    bufferedCount = 0;
+    ruleCount.store(rules.length());
+}
+
+
+void TopicBridge::setTarget(QString name, MqttHandler *handler)
+{
+    // The thread may be publishing to the previous handler
+    QMutexLocker sendLocker(&sendMutex);
+    QMutexLocker locker(&mutex);
+
+    if (handler != nullptr)
+        targets.insert(name, handler);
+    else
+    {
+        targets.remove(name);
+        dropBuffer(name);
+    }
+}
+
+
+void TopicBridge::forward(const QString &connection, const QStringList &topicLevels, std::shared_ptr<const std::string> payload)
+{
+    if (ruleCount.load() == 0)
+        return;
+
+    QMutexLocker locker(&mutex);
+
+    for (int i = 0; i < rules.length(); i++)
+    {
+        auto &rule = rules.at(i);
+        if (rule.source != connection || !rule.filter.matches(topicLevels))
+            continue;
+
+        if (!targets.contains(rule.target))
+        {
+            statistics[i].dropped++;
+            continue;
+        }
+
+        Forward forward;
+        forward.rule = i;
+        forward.payload = payload;
+
+        if (rule.rewrite)
+        {
+            // Levels matched literally by the filter are replaced by the prefix
+            auto filterLevels = rule.filter.getFilter().split("/");
+            int literal = 0;
+            while (literal < filterLevels.length() && filterLevels.at(literal) != "+" && filterLevels.at(literal) != "#")
+                literal++;
+
+            auto levels = topicLevels.mid(literal);
+            if (!rule.prefix.isEmpty())
+                levels.prepend(rule.prefix);
+            forward.topic = levels.join("/").toStdString();
+        }
+        else
+            forward.topic = topicLevels.join("/").toStdString();
+
+        auto &buffer = buffers[rule.target];
+        if (buffer.size() >= BRIDGE_BUFFER_MESSAGES)
+        {
+            statistics[buffer.dequeue().rule].dropped++;
+            bufferedCount--;
+        }
+
+        buffer.enqueue(forward);
+        bufferedCount++;
+
+        if (bufferedCount == 1)
+            wake.wakeOne();
+    }
+}
+
+
+QList<BridgeStatistics> TopicBridge::getStatistics()
+{
+    QMutexLocker locker(&mutex);
+
+    for (auto &counters : statistics)
+        counters.buffered = 0;
+    for (auto &buffer : buffers)
+    {
+        for (auto &forward : buffer)
+            statistics[forward.rule].buffered++;
+    }
+
+    return statistics.toList();
+}
+
+
+void TopicBridge::run()
+{
+    bool waiting = false;
+
+    forever
+    {
+        {
+            QMutexLocker locker(&mutex);
+
+            // Targets without room are retried after a while, otherwise the thread sleeps until something is buffered
+            if (waiting && !stopping)
+                wake.wait(&mutex, BRIDGE_RETRY_INTERVAL);
+            while (bufferedCount == 0 && !stopping)
+                wake.wait(&mutex);
+
+            if (stopping)
+                return;
+        }
+
+        waiting = !send();
+    }
+}
+
+
+bool TopicBridge::send()
+{
+    QMutexLocker sendLocker(&sendMutex);
+
+    QList<QPair<QString, MqttHandler *>> candidates;
+    {
+        QMutexLocker locker(&mutex);
+        for (auto it = buffers.constBegin(); it != buffers.constEnd(); ++it)
+        {
+            if (!it.value().isEmpty() && targets.contains(it.key()))
+                candidates.append(qMakePair(it.key(), targets.value(it.key())));
+        }
+    }
+
+    bool sent = false;
+    for (auto &candidate : candidates)
+    {
+        // Publishes of the target are pipelined by its in-flight window, the bridge only keeps its queue short
+        if (!candidate.second->waitForPendingBelow(BRIDGE_PENDING_LIMIT, std::chrono::milliseconds(0)))
+            continue;
+
+        std::vector<mqtt::message_ptr> batch;
+        {
+            QMutexLocker locker(&mutex);
+            auto &buffer = buffers[candidate.first];
+            while (!buffer.isEmpty() && static_cast<int>(batch.size()) < BRIDGE_BATCH_MESSAGES)
+            {
+                auto forward = buffer.dequeue();
+                bufferedCount--;
+
+                batch.push_back(mqtt::make_message(forward.topic, forward.payload->data(), forward.payload->length(), rules.at(forward.rule).qos, false));
+                statistics[forward.rule].forwarded++;
+            }
+        }
+
+        if (batch.empty())
+            continue;
+
+        candidate.second->publishMessages(batch);
+        sent = true;
+    }
+
+    return sent;
+}
+
+
+void TopicBridge::dropBuffer(const QString &name)
+{
+    auto found = buffers.find(name);
+    if (found == buffers.end())
+        return;
+
+    for (auto &forward : found.value())
+        statistics[forward.rule].dropped++;
+
+    bufferedCount -= found.value().size();
+    buffers.erase(found);
+}
@@ -0,0 +1,218 @@
+/**
+ * @file topicbridge.h
+ * @brief Header file for bridge forwarding topics from one connection to another
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TOPICBRIDGE_H
+#define TOPICBRIDGE_H
+
+#include "mqtthandler.h"
+#include "topicfilter.h"
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Rule forwarding a subtree of one connection to another connection
+ */
+struct BridgeRule
+{
+    /**
+     * @brief Rule as it was written
+     */
+    QString text;
+
+    /**
+     * @brief Name of the connection messages are taken from
+     */
+    QString source;
+
+    TopicFilter filter;
+
+    /**
+     * @brief Name of the connection messages are published to
+     */
+    QString target;
+
+    /**
+     * @brief Replaces the levels of the filter before its first wildcard, used when rewrite is true
+     */
+    QString prefix;
+
+    bool rewrite = false;
+
+    int qos = 0;
+};
+
+/**
+ * @brief Counters of one bridge rule
+ */
+struct BridgeStatistics
+{
+    /**
+     * @brief Rule as it was written
+     */
+    QString rule;
+
+    /**
+     * @brief Messages handed to the target connection
+     */
+    quint64 forwarded = 0;
+
+    /**
+     * @brief Messages dropped because the buffer was full or the target was not connected
+     */
+    quint64 dropped = 0;
+
+    /**
+     * @brief Messages waiting in the buffer
+     */
+    int buffered = 0;
+};
+
+class TopicBridge
+{
+public:
+    /**
+     * @brief Bridge between connections, matching messages are buffered per target and published in batches
+     * on a thread of the bridge while the target's in-flight window has room
+     */
+    TopicBridge();
+
+    /**
+     * @brief Stop the thread of the bridge, buffered messages are dropped
+     */
+    ~TopicBridge();
+
+    /**
+     * @brief Parse rules in format "source filter -> target [as prefix] [qos N]" separated by semicolons,
+     * rules forwarding messages back to their source through other rules are rejected
+     * @param text of the rules
+     * @param rules parsed rules
+     * @return empty string on success, otherwise description of the error
+     */
+    static QString parseRules(QString text, QList<BridgeRule> &rules);
+
+    /**
+     * @brief Replace rules, buffered messages and counters of the previous rules are dropped
+     * @param rules to apply
+     */
+    void setRules(QList<BridgeRule> rules);
+
+    /**
+     * @brief Set handler of a connection messages can be published to
+     * @param name of the connection
+     * @param handler of the connection, nullptr when it was disconnected, the call returns once the bridge stopped using the previous handler
+     */
+    void setTarget(QString name, MqttHandler *handler);
+
+    /**
+     * @brief Buffer message for every rule it matches, called on ingest worker threads
+     * @param connection the message was received on
+     * @param topicLevels are levels of the topic
+     * @param payload of the message, shared instead of copied
+     */
+    void forward(const QString &connection, const QStringList &topicLevels, std::shared_ptr<const std::string> payload);
+
+    /**
+     * @brief Get counters of all rules
+     * @return counters in order of the rules
+     */
+    QList<BridgeStatistics> getStatistics();
+
+private:
+    /**
+     * @brief Message waiting to be published
+     */
+    struct Forward
+    {
+        int rule = 0;
+        std::string topic;
+        std::shared_ptr<const std::string> payload;
+    };
+
+    QList<BridgeRule> rules;
+    QVector<BridgeStatistics> statistics;
+
+    /**
+     * @brief Number of rules, read without the mutex so messages are not slowed down while the bridge is unused
+     */
+    QAtomicInt ruleCount;
+
+    /**
+     * @brief Handlers of connections by name
+     */
+    QHash<QString, MqttHandler *> targets;
+
+    /**
+     * @brief Messages waiting to be published by target
+     */
+    QHash<QString, QQueue<Forward>> buffers;
+
+    /**
+     * @brief Number of messages in all buffers
+     */
+    int bufferedCount = 0;
+
+    /**
+     * @brief Set when the thread should stop
+     */
+    bool stopping = false;
+
+    /**
+     * @brief Protects all members
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Signalled when a message is buffered
+     */
+    QWaitCondition wake;
+
+    /**
+     * @brief Held while handlers are used outside of mutex, so they are not deleted meanwhile
+     */
+    QMutex sendMutex;
+
+    /**
+     * @brief Thread of the sender, it runs for the whole life of the bridge so it must not hold a thread of the global pool
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Thread publishing buffered messages
+     */
+    QFuture<void> sender;
+
+    /**
+     * @brief Publish buffered messages until the bridge is destroyed
+     */
+    void run();
+
+    /**
+     * @brief Publish one batch to every target with room in its in-flight window
+     * @return true when anything was published
+     */
+    bool send();
+
+    /**
+     * @brief Drop buffered messages of a target, mutex has to be locked
+     * @param name of the target
+     */
+    void dropBuffer(const QString &name);
+};
+
+#endif // TOPICBRIDGE_H
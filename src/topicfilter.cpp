@@ -0,0 +1,83 @@
+/**
+ * @file topicfilter.cpp
+ * @brief Implementation of topic filter class
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "topicfilter.h"
+
+
+TopicFilter::TopicFilter(QString filter) : filter(filter), levels(filter.split("/")) {}
+
+
+QString TopicFilter::getFilter() const { return filter; }
+
+
+bool TopicFilter::matches(QString topic) const
+{
+    return matches(topic.split("/"));
+}
+
+
+bool TopicFilter::matches(const QStringList &topicLevels) const
+{
+    if (filter.isEmpty())
+        return false;
+
+    // Wildcards don't match topics starting with '$' (e.g. $SYS) on the first level
+    if (!topicLevels.isEmpty() && topicLevels.first().startsWith("$") && (levels.first() == "+" || levels.first() == "#"))
+        return false;
+
+    for (int i = 0; i < levels.length(); i++)
+    {
+        if (levels.at(i) == "#")
+            return true;
+
+        if (i >= topicLevels.length())
+            return false;
+
+        if (levels.at(i) != "+" && levels.at(i) != topicLevels.at(i))
+            return false;
+    }
+
+    return levels.length() == topicLevels.length();
+}
+
+
+bool TopicFilter::isValid(QString filter)
+{
+    if (filter.isEmpty())
+        return false;
+
+    auto levels = filter.split("/");
+    for (int i = 0; i < levels.length(); i++)
+    {
+        auto level = levels.at(i);
+
+        if (level == "#" && i != levels.length() - 1)
+            return false;
+
+        if (level != "#" && level != "+" && (level.contains("#") || level.contains("+")))
+            return false;
+    }
+
+    return true;
+}
+
+
+bool TopicFilter::isInSubtree(const QString &topic, const QSet<QString> &subtrees)
+{
+    if (subtrees.isEmpty())
+        return false;
+
+    // The topic itself and every parent of it is looked up
+    for (int end = topic.length(); end > 0; end = topic.lastIndexOf('/', end - 1))
+    {
+        if (subtrees.contains(topic.left(end)))
+            return true;
+    }
+
+    // Topics starting with '/' have an empty first level, the walk above stops before it
+    return (topic.isEmpty() || topic.startsWith('/')) && subtrees.contains(QString());
+}
@@ -0,0 +1,71 @@
+/**
+ * @file topicfilter.h
+ * @brief Header file for topic filter class
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TOPICFILTER_H
+#define TOPICFILTER_H
+
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class TopicFilter
+{
+public:
+    /**
+     * @brief Topic filter with MQTT wildcards ('+' matches one level, trailing '#' matches any number of levels)
+     * @param filter is the filter, e.g. "sensors/+/temperature" or "cameras/#"
+     */
+    TopicFilter(QString filter = QString());
+
+    /**
+     * @brief Get the filter
+     * @return filter as it was given
+     */
+    QString getFilter() const;
+
+    /**
+     * @brief Check whether a topic matches the filter
+     * @param topic to check
+     * @return true when the topic matches, otherwise false
+     */
+    bool matches(QString topic) const;
+
+    /**
+     * @brief Check whether a topic split into levels matches the filter
+     * @param topicLevels are levels of the topic
+     * @return true when the topic matches, otherwise false
+     */
+    bool matches(const QStringList &topicLevels) const;
+
+    /**
+     * @brief Check whether a filter is valid ('#' only as the last level, wildcards occupy whole levels)
+     * @param filter to check
+     * @return true when valid, otherwise false
+     */
+    static bool isValid(QString filter);
+
+    /**
+     * @brief Check whether a topic is one of the subtrees or below one of them
+     * @param topic to check
+     * @param subtrees are topics whose whole subtrees are looked for
+     * @return true when the topic or any of its parents is in subtrees
+     */
+    static bool isInSubtree(const QString &topic, const QSet<QString> &subtrees);
+
+private:
+    /**
+     * @brief Filter as it was given
+     */
+    QString filter;
+
+    /**
+     * @brief Levels of the filter
+     */
+    QStringList levels;
+};
+
+#endif // TOPICFILTER_H
@@ -0,0 +1,215 @@
+/**
+ * @file topicfinder.cpp
+ * @brief Implementation of fuzzy finder of known topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "topicfinder.h"
+#include "topicfilter.h"
+
+#include <QHash>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+
+void TopicFinder::addTopic(QString connection, QString topic)
+{
+    Entry entry;
+    entry.connection = connection;
+    entry.topic = topic;
+    entry.key = topic.toLower().toUtf8();
+    entry.characters = characterMask(entry.key);
+
+    QMutexLocker locker(&mutex);
+    entries.append(entry);
+}
+
+
+void TopicFinder::addTopics(const QList<QPair<QString, QString>> &topics)
+{
+    // Keys are prepared before locking, so searching is not blocked for long
+    QVector<Entry> added;
+    added.reserve(topics.size());
+
+    for (auto &topic : topics)
+    {
+        Entry entry;
+        entry.connection = topic.first;
+        entry.topic = topic.second;
+        entry.key = topic.second.toLower().toUtf8();
+        entry.characters = characterMask(entry.key);
+        added.append(entry);
+    }
+
+    QMutexLocker locker(&mutex);
+    entries += added;
+}
+
+
+void TopicFinder::removeSubtrees(const QList<QPair<QString, QString>> &subtrees)
+{
+    QHash<QString, QSet<QString>> removed;
+    for (auto &subtree : subtrees)
+        removed[subtree.first].insert(subtree.second);
+
+    QMutexLocker locker(&mutex);
+
+    QVector<Entry> kept;
+    kept.reserve(entries.size());
+
+    for (auto &entry : entries)
+    {
+        if (!TopicFilter::isInSubtree(entry.topic, removed.value(entry.connection)))
+            kept.append(entry);
+    }
+
+    entries = kept;
+
+    // Indices remembered for narrowing no longer hold
+    previousQuery.clear();
+    previousMatches.clear();
+    previousSize = 0;
+}
+
+
+QList<TopicMatch> TopicFinder::find(QString query, int count)
+{
+    QList<TopicMatch> results;
+
+    auto key = query.trimmed().toLower().toUtf8();
+    if (key.isEmpty() || count <= 0)
+        return results;
+
+    auto mask = characterMask(key);
+
+    QMutexLocker locker(&mutex);
+
+    // Typing narrows the query, so only topics matched by the previous query and newer topics can match
+    bool narrowing = !previousQuery.isEmpty() && key.startsWith(previousQuery);
+
+    QVector<int> matches;
+    std::vector<std::pair<int, int>> best;
+    best.reserve(count + 1);
+
+    auto consider = [&](int index)
+    {
+        auto &entry = entries.at(index);
+        if ((entry.characters & mask) != mask)
+            return;
+
+        auto entryScore = score(entry.key, key);
+        if (entryScore < 0)
+            return;
+
+        matches.append(index);
+
+        // Min-heap of the best results, the worst of them on top
+        best.emplace_back(entryScore, -index);
+        std::push_heap(best.begin(), best.end(), std::greater<std::pair<int, int>>());
+        if (static_cast<int>(best.size()) > count)
+        {
+            std::pop_heap(best.begin(), best.end(), std::greater<std::pair<int, int>>());
+            best.pop_back();
+        }
+    };
+
+    if (narrowing)
+    {
+        for (auto index : previousMatches)
+            consider(index);
+        for (int i = previousSize; i < entries.size(); i++)
+            consider(i);
+    }
+    else
+    {
+        for (int i = 0; i < entries.size(); i++)
+            consider(i);
+    }
+
+    previousQuery = key;
+    previousMatches = matches;
+    previousSize = entries.size();
+
+    std::sort(best.begin(), best.end(), std::greater<std::pair<int, int>>());
+    for (auto &result : best)
+    {
+        auto &entry = entries.at(-result.second);
+
+        TopicMatch match;
+        match.connection = entry.connection;
+        match.topic = entry.topic;
+        match.score = result.first;
+        results.append(match);
+    }
+
+    return results;
+}
+
+
+int TopicFinder::size()
+{
+    QMutexLocker locker(&mutex);
+    return entries.size();
+}
+
+
+quint64 TopicFinder::characterMask(const QByteArray &text)
+{
+    quint64 mask = 0;
+
+    for (auto c : text)
+    {
+        auto byte = static_cast<unsigned char>(c);
+
+        if (byte >= 'a' && byte <= 'z')
+            mask |= 1ull << (byte - 'a');
+        else if (byte >= '0' && byte <= '9')
+            mask |= 1ull << (26 + byte - '0');
+        else
+            mask |= 1ull << (36 + byte % 28);
+    }
+
+    return mask;
+}
+
+
+int TopicFinder::score(const QByteArray &key, const QByteArray &query)
+{
+    int result = 0;
+    int queryIndex = 0;
+    int lastMatch = -1;
+
+    for (int i = 0; i < key.length() && queryIndex < query.length(); i++)
+    {
+        if (key.at(i) != query.at(queryIndex))
+            continue;
+
+        result += 16;
+
+        // Matches at the start of a level or word and runs of consecutive matches are preferred
+        auto previous = i > 0 ? key.at(i - 1) : '/';
+        if (previous == '/' || previous == '_' || previous == '-' || previous == '.' || previous == ' ')
+            result += 24;
+        if (lastMatch == i - 1)
+            result += 16;
+        else if (lastMatch >= 0)
+            result -= std::min(i - lastMatch - 1, 16);
+
+        lastMatch = i;
+        queryIndex++;
+    }
+
+    if (queryIndex < query.length())
+        return -1;
+
+    // Query typed verbatim, especially in the last level, is the best match
+    auto substring = key.lastIndexOf(query);
+    if (substring >= 0)
+        result += substring >= key.lastIndexOf('/') ? 64 : 32;
+
+    // Shorter topics win ties
+    return result - key.length() / 8;
+}
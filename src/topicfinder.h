@@ -0,0 +1,143 @@
+/**
+ * @file topicfinder.h
+ * @brief Header file for fuzzy finder of known topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TOPICFINDER_H
+#define TOPICFINDER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Topic found by the finder
+ */
+struct TopicMatch
+{
+    /**
+     * @brief Connection the topic was received on
+     */
+    QString connection;
+
+    /**
+     * @brief The topic
+     */
+    QString topic;
+
+    /**
+     * @brief Score of the match, higher is better
+     */
+    int score = 0;
+};
+
+class TopicFinder
+{
+public:
+    /**
+     * @brief Index of known topics searched by fuzzy matching, the query characters have to appear in the topic in order
+     */
+    TopicFinder() {}
+
+    /**
+     * @brief Add newly discovered topic
+     * @param connection the topic was received on
+     * @param topic to add
+     */
+    void addTopic(QString connection, QString topic);
+
+    /**
+     * @brief Add many topics at once, used for topics restored from a snapshot
+     * @param topics are pairs of connection and topic
+     */
+    void addTopics(const QList<QPair<QString, QString>> &topics);
+
+    /**
+     * @brief Remove topics together with all topics below them
+     * @param subtrees are pairs of connection and topic
+     */
+    void removeSubtrees(const QList<QPair<QString, QString>> &subtrees);
+
+    /**
+     * @brief Find best matching topics, queries extending the previous query only search topics the previous query matched
+     * @param query typed by the user
+     * @param count is maximum number of results
+     * @return matches, best first
+     */
+    QList<TopicMatch> find(QString query, int count);
+
+    /**
+     * @brief Get number of known topics
+     * @return number of topics
+     */
+    int size();
+
+private:
+    /**
+     * @brief Known topic
+     */
+    struct Entry
+    {
+        QString connection;
+        QString topic;
+
+        /**
+         * @brief Lower case UTF-8 of the topic, the matching runs on it
+         */
+        QByteArray key;
+
+        /**
+         * @brief Bit for every letter, digit and other character class present in the key, for quick rejection
+         */
+        quint64 characters;
+    };
+
+    /**
+     * @brief Known topics in order of discovery
+     */
+    QVector<Entry> entries;
+
+    /**
+     * @brief Previous query
+     */
+    QByteArray previousQuery;
+
+    /**
+     * @brief Indices of entries the previous query matched
+     */
+    QVector<int> previousMatches;
+
+    /**
+     * @brief Number of entries when the previous query was run, entries added later are searched too
+     */
+    int previousSize = 0;
+
+    /**
+     * @brief Protects all members, topics are added on ingest and searched from the GUI
+     */
+    QMutex mutex;
+
+    /**
+     * @brief Get bit mask of characters present in text
+     * @param text to look at
+     * @return mask
+     */
+    static quint64 characterMask(const QByteArray &text);
+
+    /**
+     * @brief Score a topic for a query
+     * @param key is lower case topic
+     * @param query is lower case query
+     * @return score, negative when the query does not match
+     */
+    static int score(const QByteArray &key, const QByteArray &query);
+};
+
+#endif // TOPICFINDER_H
@@ -0,0 +1,82 @@
+/**
+ * @file topicstatistics.cpp
+ * @brief Implementation of statistics and memory accounting of topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "topicstatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Time constant of the rate in seconds, roughly the window the rate is averaged over
+ */
+const double RATE_TIME_CONSTANT = 10.0;
+
+
+void TopicStatistics::add(qint64 timestamp, size_t payloadSize)
+{
+    // Every message adds 1/tau to the rate decayed since the previous one, so steady traffic converges to messages per second
+    rate = getRate(timestamp) + 1.0 / RATE_TIME_CONSTANT;
+
+    if (firstSeen == 0)
+        firstSeen = timestamp;
+    lastSeen = std::max(lastSeen, timestamp);
+    messageCount++;
+
+    auto size = static_cast<quint64>(payloadSize);
+    payloadMin = payloadCount == 0 ? size : std::min(payloadMin, size);
+    payloadMax = std::max(payloadMax, size);
+    payloadTotal += size;
+    payloadCount++;
+}
+
+
+void TopicStatistics::remove(const TopicStatistics &removed)
+{
+    messageCount -= std::min(messageCount, removed.messageCount);
+    payloadCount -= std::min(payloadCount, removed.payloadCount);
+    payloadTotal -= std::min(payloadTotal, removed.payloadTotal);
+}
+
+
+double TopicStatistics::getRate(qint64 now) const
+{
+    if (rate == 0 || now <= lastSeen)
+        return rate;
+
+    return rate * std::exp(-(now - lastSeen) / 1000.0 / RATE_TIME_CONSTANT);
+}
+
+
+double TopicStatistics::getPayloadAverage() const
+{
+    return payloadCount > 0 ? static_cast<double>(payloadTotal) / payloadCount : 0;
+}
+
+
+qint64 TopicMemory::total() const { return payloadBytes + seriesBytes + overheadBytes; }
+
+
+TopicMemory &TopicMemory::operator+=(const TopicMemory &other)
+{
+    payloadBytes += other.payloadBytes;
+    historyEntries += other.historyEntries;
+    seriesBytes += other.seriesBytes;
+    overheadBytes += other.overheadBytes;
+
+    return *this;
+}
+
+
+TopicMemory &TopicMemory::operator-=(const TopicMemory &other)
+{
+    payloadBytes -= other.payloadBytes;
+    historyEntries -= other.historyEntries;
+    seriesBytes -= other.seriesBytes;
+    overheadBytes -= other.overheadBytes;
+
+    return *this;
+}
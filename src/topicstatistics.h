@@ -0,0 +1,109 @@
+/**
+ * @file topicstatistics.h
+ * @brief Header file for statistics and memory accounting of topics
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TOPICSTATISTICS_H
+#define TOPICSTATISTICS_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+/**
+ * @brief Statistics of messages of a topic or a subtree, every message updates them in constant time
+ */
+struct TopicStatistics
+{
+    /**
+     * @brief Number of received messages
+     */
+    quint64 messageCount = 0;
+
+    /**
+     * @brief Time of the first and the last message in milliseconds since epoch, 0 when unknown
+     */
+    qint64 firstSeen = 0;
+    qint64 lastSeen = 0;
+
+    /**
+     * @brief Exponentially weighted rate in messages per second at the time of the last message
+     */
+    double rate = 0;
+
+    /**
+     * @brief Number of messages whose payload size is known, messages restored from a snapshot have none
+     */
+    quint64 payloadCount = 0;
+
+    /**
+     * @brief Sizes of payloads in bytes
+     */
+    quint64 payloadMin = 0;
+    quint64 payloadMax = 0;
+    quint64 payloadTotal = 0;
+
+    /**
+     * @brief Account a received message
+     * @param timestamp is time of arrival in milliseconds since epoch
+     * @param payloadSize is size of the payload in bytes
+     */
+    void add(qint64 timestamp, size_t payloadSize);
+
+    /**
+     * @brief Take out counts of a subtree that was removed, minimum, maximum, times and rate keep including it
+     * @param removed are statistics of the removed subtree
+     */
+    void remove(const TopicStatistics &removed);
+
+    /**
+     * @brief Get rate decayed to the time, so topics that went quiet fall towards zero
+     * @param now in milliseconds since epoch
+     * @return messages per second
+     */
+    double getRate(qint64 now) const;
+
+    /**
+     * @brief Get average payload size
+     * @return size in bytes, 0 when no payload size is known
+     */
+    double getPayloadAverage() const;
+};
+
+/**
+ * @brief Memory held by a topic or a subtree
+ */
+struct TopicMemory
+{
+    /**
+     * @brief Bytes of payloads in history, before deduplication and compression
+     */
+    qint64 payloadBytes = 0;
+
+    /**
+     * @brief Number of messages in history
+     */
+    qint64 historyEntries = 0;
+
+    /**
+     * @brief Bytes of numeric series
+     */
+    qint64 seriesBytes = 0;
+
+    /**
+     * @brief Bytes of topics, messages and their metadata
+     */
+    qint64 overheadBytes = 0;
+
+    /**
+     * @brief Get all bytes
+     * @return sum of payload, series and overhead bytes
+     */
+    qint64 total() const;
+
+    TopicMemory &operator+=(const TopicMemory &other);
+    TopicMemory &operator-=(const TopicMemory &other);
+};
+
+#endif // TOPICSTATISTICS_H
@@ -0,0 +1,195 @@
+/**
+ * @file trace.cpp
+ * @brief Implementation of tracing spans of the message path, saved in Chrome trace-event format
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief Number of spans kept per thread, the oldest are overwritten
+ */
+const quint64 TRACE_BUFFER_EVENTS = 65536;
+
+/**
+ * @brief Ring of spans written by one thread and read by save
+ */
+struct TraceBuffer
+{
+    int threadId = 0;
+    QString threadName;
+    std::vector<TraceEvent> events;
+
+    /**
+     * @brief Number of spans ever written, the owning thread stores it after the span is complete
+     */
+    std::atomic<quint64> written{0};
+};
+
+std::atomic<bool> Trace::enabled{false};
+
+/**
+ * @brief Time of the last start, spans before it are not saved
+ */
+static std::atomic<qint64> enabledSince{0};
+
+/**
+ * @brief Buffers of all threads that recorded a span, kept after their threads end so their spans can be saved
+ */
+static std::vector<TraceBuffer *> buffers;
+
+/**
+ * @brief Buffers of threads that ended, reused by new threads so pool threads being recreated don't allocate more
+ */
+static std::vector<TraceBuffer *> freeBuffers;
+static QMutex buffersMutex;
+
+/**
+ * @brief Owner of the buffer of a thread, returns it to the free buffers when the thread ends
+ */
+struct TraceBufferOwner
+{
+    TraceBuffer *buffer = nullptr;
+
+    ~TraceBufferOwner()
+    {
+        if (buffer == nullptr)
+            return;
+
+        QMutexLocker locker(&buffersMutex);
+        freeBuffers.push_back(buffer);
+    }
+};
+
+/**
+ * @brief Buffer of the calling thread, taken by its first span
+ */
+static thread_local TraceBufferOwner threadBuffer;
+
+
+void Trace::setEnabled(bool enable)
+{
+    if (enable)
+        enabledSince.store(now());
+
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+qint64 Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void Trace::record(const char *name, qint64 start, qint64 duration)
+{
+    auto buffer = threadBuffer.buffer;
+    if (buffer == nullptr)
+    {
+        auto thread = QThread::currentThread();
+        auto application = QCoreApplication::instance();
+        auto threadName = application != nullptr && thread == application->thread() ? QString("GUI") : thread->objectName();
+
+        QMutexLocker locker(&buffersMutex);
+        if (!freeBuffers.empty())
+        {
+            // Spans of the thread that ended stay in the ring and are saved under the same id, the threads didn't overlap
+            buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+        else
+        {
+            buffer = new TraceBuffer();
+            buffer->events.resize(TRACE_BUFFER_EVENTS);
+            buffer->threadId = static_cast<int>(buffers.size()) + 1;
+            buffers.push_back(buffer);
+        }
+
+        buffer->threadName = threadName.isEmpty() ? QString("Thread %1").arg(buffer->threadId) : threadName;
+        threadBuffer.buffer = buffer;
+    }
+
+    auto index = buffer->written.load(std::memory_order_relaxed);
+    auto &event = buffer->events[index % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+
+QString Trace::save(QString path)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return file.errorString();
+
+    // Names change when a buffer is reused, so they are copied under the lock
+    std::vector<TraceBuffer *> threads;
+    std::vector<QString> threadNames;
+    {
+        QMutexLocker locker(&buffersMutex);
+        threads = buffers;
+        for (auto buffer : buffers)
+            threadNames.push_back(buffer->threadName);
+    }
+
+    auto since = enabledSince.load();
+    QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        auto buffer = threads[t];
+        json.append(first ? "\n" : ",\n");
+        first = false;
+        json.append(QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,\"args\":{\"name\":\"%2\"}}")
+                .arg(buffer->threadId).arg(threadNames[t].replace("\\", "\\\\").replace("\"", "\\\"")).toUtf8());
+
+        auto written = buffer->written.load(std::memory_order_acquire);
+        auto begin = written > TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+
+        std::vector<TraceEvent> events;
+        events.reserve(written - begin);
+        for (auto i = begin; i < written; i++)
+            events.push_back(buffer->events[i % TRACE_BUFFER_EVENTS]);
+
+        // The thread kept recording while the spans were copied, the ones it may have overwritten meanwhile are skipped
+        auto after = buffer->written.load(std::memory_order_acquire);
+        auto valid = after + 1 > TRACE_BUFFER_EVENTS ? after + 1 - TRACE_BUFFER_EVENTS : 0;
+
+        for (quint64 i = 0; i < events.size(); i++)
+        {
+            auto &event = events[i];
+            if (begin + i < valid || event.start < since)
+                continue;
+
+            // Timestamps are in microseconds
+            json.append(",\n");
+            json.append(QString("{\"name\":\"%1\",\"cat\":\"icp\",\"ph\":\"X\",\"pid\":1,\"tid\":%2,\"ts\":%3,\"dur\":%4}")
+                    .arg(event.name).arg(buffer->threadId)
+                    .arg((event.start - since) / 1000.0, 0, 'f', 3).arg(event.duration / 1000.0, 0, 'f', 3).toUtf8());
+        }
+
+        file.write(json);
+        json.clear();
+    }
+
+    json.append("\n]}\n");
+    file.write(json);
+
+    if (!file.commit())
+        return file.errorString();
+
+    return QString();
+}
@@ -0,0 +1,106 @@
+/**
+ * @file trace.h
+ * @brief Header file for tracing spans of the message path, saved in Chrome trace-event format
+ * @author Peter Urgoš (xurgos00)
+ * @date 9.5.2021
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Span recorded by a thread
+ */
+struct TraceEvent
+{
+    /**
+     * @brief Name of the span, a string literal
+     */
+    const char *name = nullptr;
+
+    /**
+     * @brief Start in nanoseconds of the trace clock
+     */
+    qint64 start = 0;
+
+    /**
+     * @brief Duration in nanoseconds
+     */
+    qint64 duration = 0;
+};
+
+class Trace
+{
+public:
+    /**
+     * @brief Check whether spans are recorded, a single relaxed load so disabled spans cost next to nothing
+     * @return true when enabled
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Start or stop recording, spans recorded before the last start are not saved
+     * @param enable is true to start recording
+     */
+    static void setEnabled(bool enable);
+
+    /**
+     * @brief Get time of the trace clock
+     * @return nanoseconds of a monotonic clock
+     */
+    static qint64 now();
+
+    /**
+     * @brief Record span into the buffer of the calling thread, no lock is taken once the thread has a buffer
+     * @param name of the span, has to be a string literal
+     * @param start of the span in nanoseconds of the trace clock
+     * @param duration of the span in nanoseconds
+     */
+    static void record(const char *name, qint64 start, qint64 duration);
+
+    /**
+     * @brief Write spans recorded since the last start as a Chrome trace-event JSON file, threads keep recording meanwhile
+     * @param path of the file
+     * @return empty string on success, otherwise description of the error
+     */
+    static QString save(QString path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class TraceScope
+{
+public:
+    /**
+     * @brief Span lasting until the end of the scope, use TRACE_SCOPE instead of creating it directly
+     * @param name of the span, has to be a string literal
+     */
+    explicit TraceScope(const char *name) : name(name), start(Trace::isEnabled() ? Trace::now() : -1) {}
+
+    ~TraceScope()
+    {
+        if (start >= 0)
+            Trace::record(name, start, Trace::now() - start);
+    }
+
+private:
+    const char *name;
+    qint64 start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Spans can be compiled out completely with DEFINES += ICP_NO_TRACE
+#ifdef ICP_NO_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+#endif // TRACE_H
@@ -7,35 +7,194 @@
 
 #include "valueinspectdialog.h"
 #include "ui_valueinspectdialog.h"
+#include "builtindecoders.h"
 
+#include <QPixmap>
+#include <algorithm>
 
-ValueInspectDialog::ValueInspectDialog(QWidget *parent) :
+/**
+ * @brief Number of characters of decoded text shown at once
+ */
+const int INSPECT_PAGE_CHARACTERS = 65536;
+
+/**
+ * @brief Number of bytes of the raw payload shown at once as text
+ */
+const size_t INSPECT_TEXT_PAGE_BYTES = 65536;
+
+/**
+ * @brief Number of bytes of the raw payload shown at once in hex
+ */
+const size_t INSPECT_HEX_PAGE_BYTES = 16384;
+
+
+ValueInspectDialog::ValueInspectDialog(DecoderRegistry *registry, QWidget *parent) :
     QDialog(parent),
-    ui(new Ui::ValueInspectDialog)
+    ui(new Ui::ValueInspectDialog),
+    registry(registry)
 {
     ui->setupUi(this);
+
+    ui->decoderBox->addItem("Auto");
+    ui->decoderBox->addItems(registry->getDecoderNames());
+
+    connect(&decoding, &QFutureWatcher<DecodedPayload>::finished, this, &ValueInspectDialog::decodingFinished);
+    connect(&fullImage, &QFutureWatcher<QImage>::finished, this, &ValueInspectDialog::fullImageFinished);
 }
 
 
 ValueInspectDialog::~ValueInspectDialog()
 {
+    // Result of decoding still in progress is cached, it doesn't have to be waited for
+    decoding.disconnect(this);
+    fullImage.disconnect(this);
     delete ui;
 }
 
 
-void ValueInspectDialog::setMessage(std::string message)
+void ValueInspectDialog::setMessage(quint64 messageId, QString topic, std::shared_ptr<const std::string> payload, PayloadKind kind)
+{
+    this->messageId = messageId;
+    this->topic = topic;
+    this->payload = payload;
+    this->kind = kind;
+
+    decode(QString());
+}
+
+
+void ValueInspectDialog::on_decoderBox_activated(int index)
+{
+    decode(index == 0 ? QString() : ui->decoderBox->itemText(index));
+}
+
+
+void ValueInspectDialog::decodingFinished()
 {
-    ui->plainTextEdit->setPlainText(QString::fromStdString(message));
+    auto result = decoding.result();
+
+    ui->decoderStatusLabel->setText(result.ok ? result.decoder : QString("%1 failed").arg(result.decoder));
 
-    QPixmap pixmap;
-    QByteArray data(message.data(), message.length());
+    decoded = result;
+    page = 0;
+    showPage();
 
-    if (pixmap.loadFromData(data))
+    // Pixmaps can only be created on the GUI thread, decoders produce QImage
+    if (!result.image.isNull())
     {
-        ui->image_label->setPixmap(pixmap);
+        ui->image_label->setPixmap(QPixmap::fromImage(result.image));
+
+        // Large images are shown downscaled first, the full resolution follows
+        if (!result.image.text("OriginalSize").isEmpty())
+        {
+            ui->decoderStatusLabel->setText(QString("%1, loading full resolution...").arg(result.decoder));
+            fullImage.setFuture(registry->decodeImage(payload));
+        }
 
         // Focus second tab when data is identified as image
         ui->tabWidget->setCurrentIndex(1);
     }
+    else
+    {
+        ui->image_label->setText("Message can not be shown as an image.");
+        ui->tabWidget->setCurrentIndex(0);
+    }
+}
+
+
+void ValueInspectDialog::fullImageFinished()
+{
+    auto image = fullImage.result();
+    if (image.isNull())
+        return;
+
+    ui->image_label->setPixmap(QPixmap::fromImage(image));
+    ui->decoderStatusLabel->setText(decoded.decoder);
 }
 
+
+void ValueInspectDialog::on_pageModeBox_activated(int index)
+{
+    Q_UNUSED(index)
+
+    page = 0;
+    showPage();
+}
+
+
+void ValueInspectDialog::on_previousPageButton_clicked()
+{
+    page--;
+    showPage();
+}
+
+
+void ValueInspectDialog::on_nextPageButton_clicked()
+{
+    page++;
+    showPage();
+}
+
+
+void ValueInspectDialog::showPage()
+{
+    if (payload == nullptr)
+        return;
+
+    QString text;
+    QString range;
+    qint64 pageCount;
+
+    if (ui->pageModeBox->currentIndex() == 0)
+    {
+        auto length = decoded.text.length();
+        pageCount = std::max(1, (length + INSPECT_PAGE_CHARACTERS - 1) / INSPECT_PAGE_CHARACTERS);
+        page = std::max(0, std::min(page, static_cast<int>(pageCount) - 1));
+
+        auto start = page * INSPECT_PAGE_CHARACTERS;
+        text = decoded.text.mid(start, INSPECT_PAGE_CHARACTERS);
+        range = QString("characters %1-%2 of %3").arg(start).arg(start + text.length()).arg(length);
+    }
+    else
+    {
+        bool hex = ui->pageModeBox->currentIndex() == 2;
+        auto pageBytes = hex ? INSPECT_HEX_PAGE_BYTES : INSPECT_TEXT_PAGE_BYTES;
+        auto length = payload->length();
+        pageCount = std::max(static_cast<qint64>(1), static_cast<qint64>((length + pageBytes - 1) / pageBytes));
+        page = std::max(0, std::min(page, static_cast<int>(pageCount) - 1));
+
+        auto data = payload->data();
+        auto start = std::min(static_cast<size_t>(page) * pageBytes, length);
+        auto end = std::min(start + pageBytes, length);
+
+        if (hex)
+            text = HexDecoder::dump(data + start, end - start, start);
+        else
+        {
+            // Pages of text start and end at whole UTF-8 characters
+            while (start < end && (static_cast<unsigned char>(data[start]) & 0xc0) == 0x80)
+                start++;
+            while (end < length && (static_cast<unsigned char>(data[end]) & 0xc0) == 0x80)
+                end++;
+
+            text = QString::fromUtf8(data + start, static_cast<int>(end - start));
+        }
+
+        range = QString("bytes %1-%2 of %3").arg(start).arg(end).arg(length);
+    }
+
+    ui->plainTextEdit->setPlainText(text);
+    ui->pageLabel->setText(QString("Page %1 of %2, %3").arg(page + 1).arg(pageCount).arg(range));
+    ui->previousPageButton->setEnabled(page > 0);
+    ui->nextPageButton->setEnabled(page + 1 < pageCount);
+}
+
+
+void ValueInspectDialog::decode(QString decoderName)
+{
+    if (payload == nullptr)
+        return;
+
+    ui->decoderStatusLabel->setText("Decoding...");
+    decoding.setFuture(registry->decode(messageId, topic, payload, decoderName, kind));
+}
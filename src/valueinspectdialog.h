@@ -8,7 +8,11 @@
 #ifndef VALUEINSPECTDIALOG_H
 #define VALUEINSPECTDIALOG_H
 
+#include "decoderregistry.h"
+
 #include <QDialog>
+#include <QFutureWatcher>
+#include <memory>
 
 namespace Ui {
 class ValueInspectDialog;
@@ -19,17 +23,100 @@ class ValueInspectDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit ValueInspectDialog(QWidget *parent = nullptr);
+    explicit ValueInspectDialog(DecoderRegistry *registry, QWidget *parent = nullptr);
     ~ValueInspectDialog();
 
     /**
-     * @brief Set message to be shown in the dialog, try to parse it as an image too
-     * @param message to show
+     * @brief Set message to be shown in the dialog, it is decoded on a worker thread
+     * @param messageId is unique identifier of the message, used for caching
+     * @param topic of the message, used by decoder rules
+     * @param payload of the message
+     * @param kind of the payload, used to select the decoder without sniffing
+     */
+    void setMessage(quint64 messageId, QString topic, std::shared_ptr<const std::string> payload, PayloadKind kind = PayloadKind::Unknown);
+
+private slots:
+    /**
+     * @brief Decode the message again with the selected decoder
+     */
+    void on_decoderBox_activated(int index);
+
+    /**
+     * @brief Show result of decoding
+     */
+    void decodingFinished();
+
+    /**
+     * @brief Replace downscaled preview of an image by the full resolution
+     */
+    void fullImageFinished();
+
+    /**
+     * @brief Show the first page in the selected mode
      */
-    void setMessage(std::string message);
+    void on_pageModeBox_activated(int index);
+
+    void on_previousPageButton_clicked();
+    void on_nextPageButton_clicked();
 
 private:
     Ui::ValueInspectDialog *ui;
+
+    /**
+     * @brief Registry used for decoding, owned by the main window
+     */
+    DecoderRegistry *registry;
+
+    /**
+     * @brief Watches decoding in progress
+     */
+    QFutureWatcher<DecodedPayload> decoding;
+
+    /**
+     * @brief Watches image being decoded at full resolution
+     */
+    QFutureWatcher<QImage> fullImage;
+
+    /**
+     * @brief Result of the last decoding, its text is shown page by page
+     */
+    DecodedPayload decoded;
+
+    /**
+     * @brief Index of the shown page
+     */
+    int page = 0;
+
+    /**
+     * @brief Identifier of the shown message
+     */
+    quint64 messageId = 0;
+
+    /**
+     * @brief Topic of the shown message
+     */
+    QString topic;
+
+    /**
+     * @brief Payload of the shown message, shared with the message so it outlives history trimming
+     */
+    std::shared_ptr<const std::string> payload;
+
+    /**
+     * @brief Kind of the shown payload
+     */
+    PayloadKind kind = PayloadKind::Unknown;
+
+    /**
+     * @brief Start decoding of the message
+     * @param decoderName is the decoder to use, empty for automatic selection
+     */
+    void decode(QString decoderName);
+
+    /**
+     * @brief Show the current page of decoded text or of the raw payload, only one page is put into the text field
+     */
+    void showPage();
 };
 
 #endif // VALUEINSPECTDIALOG_H